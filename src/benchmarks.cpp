@@ -0,0 +1,1308 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+/// Встроенные тесты производительности (программа submplayer_benchmark,
+/// которая не устанавливается).
+///
+/// Использование: submplayer_benchmark <имя теста>, где имя теста - одно из:
+/// close-fds, cue-scheduler, highlight-latency, mirror, search, shm.
+
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <gdk/gdk.h>
+
+#include <glibmm/main.h>
+
+#include <gtkmm/main.h>
+
+#include <mlib/process.hpp>
+
+#include "cue_scheduler.hpp"
+#include "latency_stats.hpp"
+#include "main_window.hpp"
+#include "mirror_server.hpp"
+#include "mplayer.hpp"
+#include "search_index.hpp"
+#include "state_publisher.hpp"
+#include "submplayer_state.h"
+#include "subtitles.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Лимит на количество открытых файлов, который мы пытаемся установить,
+	/// чтобы показать разницу между алгоритмами закрытия дескрипторов.
+	const rlim_t BENCHMARK_FILES_LIMIT = 1024 * 1024;
+
+	/// Количество "лишних" открытых дескрипторов, которые необходимо
+	/// закрывать в дочернем процессе.
+	const int BENCHMARK_OPENED_FILES = 32;
+
+	/// Количество запусков дочернего процесса в каждом из тестов.
+	const int BENCHMARK_ITERATIONS = 20;
+
+	/// Параметры имитатора MPlayer'а по умолчанию для теста задержки
+	/// выделения субтитров.
+	const char* const HIGHLIGHT_BENCHMARK_MOCK_OPTIONS =
+		"rate=200,duration=30,seek_every=2,seek_step=45,"
+		"pause_every=7,pause_for=0.5,burst_every=3,burst_size=200";
+
+	/// Количество дорожек субтитров в тесте задержки выделения субтитров.
+	const int HIGHLIGHT_BENCHMARK_TRACKS = 2;
+
+	/// Интервал между субтитрами в тесте задержки выделения субтитров.
+	const Time_ms HIGHLIGHT_BENCHMARK_INTERVAL = 500;
+
+	/// Параметры имитатора MPlayer'а по умолчанию для теста точности
+	/// планировщика команд.
+	const char* const CUE_BENCHMARK_MOCK_OPTIONS = "rate=25,duration=20";
+
+	/// Интервал между субтитрами в тесте точности планировщика команд.
+	const Time_ms CUE_BENCHMARK_INTERVAL = 1000;
+
+	/// Продолжительность одного субтитра в тесте точности планировщика
+	/// команд.
+	const Time_ms CUE_BENCHMARK_DURATION = 700;
+
+	/// Через сколько миллисекунд после паузы тест точности планировщика
+	/// команд продолжает воспроизведение.
+	const unsigned int CUE_BENCHMARK_PAUSE = 100;
+
+	/// Количество дорожек в тесте трансляции субтитров.
+	const int MIRROR_BENCHMARK_TRACKS = 2;
+
+	/// Количество субтитров в каждой дорожке в тесте трансляции субтитров.
+	const size_t MIRROR_BENCHMARK_CUES = 100000;
+
+	/// Количество смен текущего субтитра в тесте трансляции субтитров.
+	const size_t MIRROR_BENCHMARK_UPDATES = 2000;
+
+	/// Интервал между сменами текущего субтитра в тесте трансляции
+	/// субтитров (мс).
+	const unsigned int MIRROR_BENCHMARK_INTERVAL = 2;
+
+	/// Время, в течение которого клиент теста трансляции субтитров ожидает
+	/// данные от сервера (с).
+	const int MIRROR_BENCHMARK_TIMEOUT = 10;
+
+	/// Количество потоков-читателей в каждом из прогонов теста публикации
+	/// состояния в разделяемой памяти (-1 - конец списка).
+	const int SHM_BENCHMARK_READERS[] = { 0, 1, 2, 4, 8, -1 };
+
+	/// Продолжительность одного прогона теста публикации состояния в
+	/// разделяемой памяти.
+	const Time_us SHM_BENCHMARK_DURATION = 1000000;
+
+	/// Количество публикаций между проверками времени в тесте публикации
+	/// состояния в разделяемой памяти.
+	const size_t SHM_BENCHMARK_BATCH = 1000;
+
+	/// Количество дорожек в тесте публикации состояния в разделяемой
+	/// памяти.
+	const size_t SHM_BENCHMARK_TRACKS = 2;
+
+	/// Количество субтитров в тесте поиска.
+	const size_t SEARCH_BENCHMARK_CUES = 100000;
+
+	/// Количество различных слов в субтитрах теста поиска.
+	const size_t SEARCH_BENCHMARK_WORDS = 5000;
+
+	/// Количество запросов в тесте поиска.
+	const size_t SEARCH_BENCHMARK_QUERIES = 200;
+
+	/// Слоги, из которых составляются слова в тесте поиска (с заглавными
+	/// и акцентированными буквами, чтобы проверялась и нормализация).
+	const char* const SEARCH_BENCHMARK_SYLLABLES[] = {
+		"ka", "Lo", "mi", "ne", "ré", "su", "tö", "vi", "ba", "de",
+		"ко", "ЛЕ", "мё", "на", "ри", "сто", NULL
+	};
+
+
+
+	/// Поток, создающий нагрузку на процессор.
+	class Cpu_load: public boost::noncopyable
+	{
+		public:
+			Cpu_load(void);
+			~Cpu_load(void);
+
+
+		private:
+			volatile bool					stop;
+			boost::scoped_ptr<boost::thread>	thread;
+
+
+		private:
+			void	load_thread(void);
+	};
+
+
+
+	/// Тест точности планировщика команд: воспроизводит файл в режиме
+	/// паузы после каждого субтитра, снимая MPlayer с паузы через
+	/// CUE_BENCHMARK_PAUSE.
+	class Cue_benchmark: public boost::noncopyable
+	{
+		public:
+			Cue_benchmark(Mplayer& mplayer, Cue_scheduler& scheduler);
+
+
+		private:
+			Mplayer&						mplayer;
+			Cue_scheduler&					scheduler;
+			Glib::RefPtr<Glib::MainLoop>	loop;
+
+			/// Количество пауз, сделанных планировщиком.
+			size_t							pauses;
+
+			/// Находился ли MPlayer в режиме паузы при последнем изменении
+			/// состояния.
+			bool							paused;
+
+
+		public:
+			/// Выполняет тест до завершения MPlayer'а.
+			/// @return - количество пауз, сделанных планировщиком.
+			size_t	run(void);
+
+		private:
+			/// Обработчик изменения состояния воспроизведения.
+			void	on_offset_changed_cb(void);
+
+			/// Обработчик завершения MPlayer'а.
+			void	on_quit_cb(void);
+
+			/// Снимает MPlayer с паузы.
+			bool	on_resume_cb(void);
+	};
+
+
+
+	/// Тест трансляции субтитров: сервер и клиент работают через loopback
+	/// в одном процессе. Сервер меняет текущий субтитр каждые
+	/// MIRROR_BENCHMARK_INTERVAL мс, а клиент (в отдельном потоке)
+	/// записывает время получения каждого изменения.
+	class Mirror_benchmark: public boost::noncopyable
+	{
+		public:
+			Mirror_benchmark(Mirror_server& server);
+
+
+		private:
+			Mirror_server&					server;
+			Glib::RefPtr<Glib::MainLoop>	loop;
+
+			/// Количество выполненных смен текущего субтитра.
+			size_t							updates;
+
+			/// Время (по монотонным часам) каждой смены текущего субтитра.
+			std::vector<Time_us>			update_times;
+
+			/// Суммарное время выполнения Mirror_server::set_current().
+			double							set_current_time;
+
+			/// Защищает данные, разделяемые с потоком клиента.
+			boost::mutex					mutex;
+
+			/// Получил ли клиент тексты дорожек.
+			bool							client_ready;
+
+			/// Завершил ли клиент работу.
+			bool							client_finished;
+
+			/// Ошибка, возникшая в потоке клиента.
+			std::string						client_error;
+
+			/// Время получения клиентом текстов дорожек.
+			Time_us							tracks_time;
+
+			/// Размер сообщения с текстами дорожек.
+			size_t							tracks_size;
+
+			/// Время (по монотонным часам) получения клиентом каждого
+			/// изменения.
+			std::vector<Time_us>			receive_times;
+
+
+		public:
+			/// Выполняет тест и выводит его результаты.
+			void		run(void) throw(m::Exception);
+
+		private:
+			/// Поток клиента.
+			void		client_thread(int port);
+
+			/// Выполняет работу клиента.
+			void		run_client(int port) throw(m::Exception);
+
+			/// Меняет текущий субтитр.
+			bool		on_update_cb(void);
+
+			/// Читает из fd ровно size байт.
+			static void	read_exactly(int fd, void* buf, size_t size) throw(m::Exception);
+
+			/// Читает из fd один кадр WebSocket.
+			static std::string	read_frame(int fd) throw(m::Exception);
+	};
+
+
+
+	/// Поток, непрерывно читающий состояние воспроизведения из разделяемой
+	/// памяти с помощью submplayer_state.h и проверяющий его
+	/// согласованность.
+	class Shm_reader: public boost::noncopyable
+	{
+		public:
+			Shm_reader(const std::string& name) throw(m::Exception);
+			~Shm_reader(void);
+
+
+		private:
+			const struct submplayer_state_segment*	segment;
+			volatile bool							stop;
+			boost::scoped_ptr<boost::thread>		thread;
+
+		public:
+			/// Количество прочитанных копий состояния.
+			size_t									reads;
+
+			/// Количество несогласованных копий.
+			size_t									torn;
+
+			/// Количество неудачных попыток чтения.
+			size_t									failures;
+
+
+		public:
+			/// Останавливает поток.
+			void	finish(void);
+
+		private:
+			void	read_thread(void);
+	};
+
+
+
+	/// Тест производительности закрытия файловых дескрипторов при запуске
+	/// дочернего процесса.
+	void	close_fds_benchmark(void) throw(m::Exception);
+
+	/// Закрывает дескрипторы так, как это делалось раньше - перебором всех
+	/// возможных дескрипторов вплоть до лимита.
+	void	close_fds_legacy(int first_fd);
+
+	/// Тест точности отправки команд планировщиком на границах субтитров.
+	void	cue_scheduler_benchmark(void) throw(m::Exception);
+
+	/// Тест задержки от вывода плеером строки состояния до выделения
+	/// соответствующего ей субтитра.
+	void	highlight_latency_benchmark(void) throw(m::Exception);
+
+	/// Тест трансляции субтитров на другое устройство.
+	void	mirror_benchmark(void) throw(m::Exception);
+
+	/// Замеряет среднее время запуска дочернего процесса с помощью fork() +
+	/// exec(), закрывающего свои дескрипторы с помощью close_func.
+	/// @return - время одного запуска в микросекундах.
+	double	measure_fork(void (*close_func)(int)) throw(m::Exception);
+
+	/// Замеряет среднее время запуска дочернего процесса с помощью
+	/// m::Process.
+	/// @return - время одного запуска в микросекундах.
+	double	measure_spawn(void) throw(m::Exception);
+
+	/// Выводит распределение задержек.
+	void	print_latencies(const std::string& title, std::vector<Time_us> latencies);
+
+	/// Выводит результат одного теста.
+	void	print_result(const std::string& name, double time);
+
+	/// Выполняет тест производительности с именем name и выводит его
+	/// результаты в стандартный вывод.
+	void	run_benchmark(const std::string& name) throw(m::Exception);
+
+	/// Тест полнотекстового поиска: строит индекс по
+	/// SEARCH_BENCHMARK_CUES субтитрам и замеряет время запросов,
+	/// набираемых по одному символу.
+	void	search_benchmark(void) throw(m::Exception);
+
+	/// Тест публикации состояния воспроизведения в разделяемой памяти:
+	/// писатель публикует состояние без перерывов, а читатели в других
+	/// потоках непрерывно его читают.
+	void	shm_benchmark(void) throw(m::Exception);
+
+	/// Обертка над m::close_fds_from() с подходящей для measure_fork()
+	/// сигнатурой.
+	void	close_fds_new(int first_fd);
+
+
+
+	Cpu_load::Cpu_load(void)
+	:
+		stop(false)
+	{
+		this->thread.reset(new boost::thread(
+			boost::bind(&Cpu_load::load_thread, this)));
+	}
+
+
+
+	Cpu_load::~Cpu_load(void)
+	{
+		this->stop = true;
+		this->thread->join();
+	}
+
+
+
+	void Cpu_load::load_thread(void)
+	{
+		while(!this->stop)
+			;
+	}
+
+
+
+	Cue_benchmark::Cue_benchmark(Mplayer& mplayer, Cue_scheduler& scheduler)
+	:
+		mplayer(mplayer),
+		scheduler(scheduler),
+		loop(Glib::MainLoop::create()),
+		pauses(0),
+		paused(false)
+	{
+	}
+
+
+
+	void Cue_benchmark::on_offset_changed_cb(void)
+	{
+		bool paused = this->mplayer.get_playback_state().paused;
+
+		this->scheduler.update();
+
+		if(paused && !this->paused)
+		{
+			this->pauses++;
+			Glib::signal_timeout().connect(
+				sigc::mem_fun(*this, &Cue_benchmark::on_resume_cb), CUE_BENCHMARK_PAUSE);
+		}
+
+		this->paused = paused;
+	}
+
+
+
+	void Cue_benchmark::on_quit_cb(void)
+	{
+		this->loop->quit();
+	}
+
+
+
+	bool Cue_benchmark::on_resume_cb(void)
+	{
+		try
+		{
+			if(this->mplayer.get_playback_state().paused)
+				this->mplayer.send_command("pause");
+		}
+		catch(m::Exception& e)
+		{
+			MLIB_SW(EE(e));
+		}
+
+		return false;
+	}
+
+
+
+	size_t Cue_benchmark::run(void)
+	{
+		this->mplayer.connect_time_offset_changed_handler(
+			sigc::mem_fun(*this, &Cue_benchmark::on_offset_changed_cb));
+		this->mplayer.connect_quit_handler(
+			sigc::mem_fun(*this, &Cue_benchmark::on_quit_cb));
+
+		// Генерирует m::Exception
+		this->mplayer.start(std::vector<std::string>(1, "benchmark.avi"));
+		this->loop->run();
+
+		return this->pauses;
+	}
+
+
+
+	Mirror_benchmark::Mirror_benchmark(Mirror_server& server)
+	:
+		server(server),
+		loop(Glib::MainLoop::create()),
+		updates(0),
+		set_current_time(0),
+		client_ready(false),
+		client_finished(false),
+		tracks_time(0),
+		tracks_size(0),
+		receive_times(MIRROR_BENCHMARK_UPDATES)
+	{
+	}
+
+
+
+	void Mirror_benchmark::client_thread(int port)
+	{
+		std::string error;
+
+		try
+		{
+			this->run_client(port);
+		}
+		catch(m::Exception& e)
+		{
+			error = EE(e);
+		}
+
+		boost::mutex::scoped_lock lock(this->mutex);
+		this->client_finished = true;
+		this->client_error = error;
+	}
+
+
+
+	bool Mirror_benchmark::on_update_cb(void)
+	{
+		{
+			boost::mutex::scoped_lock lock(this->mutex);
+
+			if(this->client_finished)
+			{
+				this->loop->quit();
+				return false;
+			}
+
+			if(!this->client_ready)
+				return true;
+		}
+
+		if(this->updates >= MIRROR_BENCHMARK_UPDATES)
+			return true;
+
+		// Изменения нумеруются с 1: при подключении текущим является
+		// субтитр 0.
+		size_t cue_id = ++this->updates;
+		Time_us time = m::get_monotonic_time();
+
+		{
+			struct timespec start;
+			struct timespec end;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+			for(int track_id = 0; track_id < MIRROR_BENCHMARK_TRACKS; track_id++)
+				this->server.set_current(track_id, cue_id);
+
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			this->set_current_time +=
+				double(end.tv_sec - start.tv_sec) * 1e6 + double(end.tv_nsec - start.tv_nsec) / 1e3;
+		}
+
+		this->update_times.push_back(time);
+
+		return true;
+	}
+
+
+
+	void Mirror_benchmark::read_exactly(int fd, void* buf, size_t size) throw(m::Exception)
+	{
+		char* data = static_cast<char*>(buf);
+
+		while(size)
+		{
+			ssize_t readed_bytes = recv(fd, data, size, 0);
+
+			if(readed_bytes > 0)
+			{
+				data += readed_bytes;
+				size -= readed_bytes;
+			}
+			else if(readed_bytes == 0)
+				M_THROW(_("Connection has been closed by the server."));
+			else if(errno != EINTR)
+				M_THROW(__("Error while reading from the server: %1.", EE(errno)));
+		}
+	}
+
+
+
+	std::string Mirror_benchmark::read_frame(int fd) throw(m::Exception)
+	{
+		unsigned char header[8];
+		guint64 size;
+
+		read_exactly(fd, header, 2);
+		size = header[1] & 0x7f;
+
+		if(size >= 126)
+		{
+			size_t size_bytes = size == 126 ? 2 : 8;
+
+			read_exactly(fd, header, size_bytes);
+
+			size = 0;
+			for(size_t i = 0; i < size_bytes; i++)
+				size = size << 8 | header[i];
+		}
+
+		std::string payload(size, '\0');
+		if(size)
+			read_exactly(fd, &payload[0], size);
+
+		return payload;
+	}
+
+
+
+	void Mirror_benchmark::run(void) throw(m::Exception)
+	{
+		boost::thread client(
+			boost::bind(&Mirror_benchmark::client_thread, this, this->server.get_port()));
+
+		Glib::signal_timeout().connect(
+			sigc::mem_fun(*this, &Mirror_benchmark::on_update_cb), MIRROR_BENCHMARK_INTERVAL);
+		this->loop->run();
+
+		client.join();
+
+		if(!this->client_error.empty())
+			M_THROW(this->client_error);
+
+		std::cout
+			<< "Tracks: " << MIRROR_BENCHMARK_TRACKS << " x " << MIRROR_BENCHMARK_CUES << " subtitles, "
+			<< this->tracks_size << " bytes received in " << this->tracks_time << " us" << std::endl;
+
+		std::cout
+			<< "Mirror_server::set_current(): " << std::fixed << std::setprecision(3)
+			<< this->set_current_time / (this->updates * MIRROR_BENCHMARK_TRACKS) << " us/call" << std::endl;
+
+		std::vector<Time_us> latencies;
+
+		for(size_t i = 0; i < this->update_times.size(); i++)
+			latencies.push_back(this->receive_times[i] - this->update_times[i]);
+
+		print_latencies("Delivered updates", latencies);
+	}
+
+
+
+	void Mirror_benchmark::run_client(int port) throw(m::Exception)
+	{
+		m::File_holder fd;
+
+		// Подключаемся к серверу -->
+		{
+			fd.set(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+
+			if(fd.get() < 0)
+				M_THROW(__("Can't create a socket: %1.", EE(errno)));
+
+			struct timeval timeout;
+			timeout.tv_sec = MIRROR_BENCHMARK_TIMEOUT;
+			timeout.tv_usec = 0;
+			setsockopt(fd.get(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+			int nodelay = 1;
+			setsockopt(fd.get(), IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof nodelay);
+
+			struct sockaddr_in address;
+			memset(&address, 0, sizeof address);
+			address.sin_family = AF_INET;
+			address.sin_port = htons(port);
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+			if(connect(fd.get(), reinterpret_cast<struct sockaddr*>(&address), sizeof address))
+				M_THROW(__("Can't connect to the server: %1.", EE(errno)));
+		}
+		// Подключаемся к серверу <--
+
+		Time_us start_time = m::get_monotonic_time();
+
+		// Устанавливаем WebSocket-соединение -->
+		{
+			const char request[] =
+				"GET /ws HTTP/1.1\r\n"
+				"Host: 127.0.0.1\r\n"
+				"Upgrade: websocket\r\n"
+				"Connection: Upgrade\r\n"
+				"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+				"Sec-WebSocket-Version: 13\r\n"
+				"\r\n";
+
+			if(::send(fd.get(), request, sizeof request - 1, MSG_NOSIGNAL) != sizeof request - 1)
+				M_THROW(__("Can't send a request to the server: %1.", EE(errno)));
+
+			std::string response;
+
+			while(response.size() < 4 || response.compare(response.size() - 4, 4, "\r\n\r\n"))
+			{
+				char c;
+				read_exactly(fd.get(), &c, 1);
+				response += c;
+			}
+
+			// Ответный ключ для этого ключа клиента приведен в RFC 6455
+			if(
+				response.compare(0, 12, "HTTP/1.1 101") ||
+				response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") == std::string::npos
+			)
+				M_THROW(__("Invalid handshake response: '%1'.", response));
+		}
+		// Устанавливаем WebSocket-соединение <--
+
+		// Получаем тексты дорожек и текущие субтитры -->
+		{
+			std::string tracks = read_frame(fd.get());
+			std::string current = read_frame(fd.get());
+
+			if(tracks.compare(0, 11, "{\"tracks\":[") || current.compare(0, 11, "{\"current\":"))
+				M_THROW(_("Invalid initial messages."));
+
+			boost::mutex::scoped_lock lock(this->mutex);
+			this->tracks_time = m::get_monotonic_time() - start_time;
+			this->tracks_size = tracks.size();
+			this->client_ready = true;
+		}
+		// Получаем тексты дорожек и текущие субтитры <--
+
+		for(size_t received = 0; received < MIRROR_BENCHMARK_UPDATES; )
+		{
+			std::string delta = read_frame(fd.get());
+			Time_us time = m::get_monotonic_time();
+			unsigned long cue_id;
+
+			if(sscanf(delta.c_str(), "{\"d\":[%*u,%lu", &cue_id) != 1 || !cue_id || cue_id > MIRROR_BENCHMARK_UPDATES)
+				M_THROW(__("Invalid update message: '%1'.", delta));
+
+			// Изменения, произошедшие за один кадр, объединяются
+			while(received < cue_id)
+				this->receive_times[received++] = time;
+		}
+	}
+
+
+
+	Shm_reader::Shm_reader(const std::string& name) throw(m::Exception)
+	:
+		stop(false),
+		reads(0),
+		torn(0),
+		failures(0)
+	{
+		if( !( this->segment = submplayer_state_open(name.c_str()) ) )
+			M_THROW(__("Can't open shared memory segment '%1': %2.", name, EE(errno)));
+
+		this->thread.reset(new boost::thread(
+			boost::bind(&Shm_reader::read_thread, this)));
+	}
+
+
+
+	Shm_reader::~Shm_reader(void)
+	{
+		this->finish();
+		submplayer_state_close(this->segment);
+	}
+
+
+
+	void Shm_reader::finish(void)
+	{
+		this->stop = true;
+
+		if(this->thread->joinable())
+			this->thread->join();
+	}
+
+
+
+	void Shm_reader::read_thread(void)
+	{
+		struct submplayer_state state;
+
+		while(!this->stop)
+		{
+			if(submplayer_state_read(this->segment, &state))
+			{
+				this->failures++;
+				continue;
+			}
+
+			this->reads++;
+
+			// Писатель записывает во все поля одно и то же значение
+			bool consistent = state.timestamp == state.offset && state.tracks_num == SHM_BENCHMARK_TRACKS;
+
+			for(size_t track_id = 0; track_id < SHM_BENCHMARK_TRACKS; track_id++)
+				consistent &= state.cues[track_id] == state.offset;
+
+			if(!consistent)
+				this->torn++;
+		}
+	}
+
+
+
+	void close_fds_benchmark(void) throw(m::Exception)
+	{
+		// Поднимаем лимит на количество открытых файлов -->
+		{
+			struct rlimit limits;
+
+			if(getrlimit(RLIMIT_NOFILE, &limits))
+				M_THROW(__("Can't get max opened files limit: %1.", EE(errno)));
+
+			// Поднять жесткий лимит может только привилегированный процесс,
+			// поэтому ошибку игнорируем.
+			if(limits.rlim_max != RLIM_INFINITY && limits.rlim_max < BENCHMARK_FILES_LIMIT)
+			{
+				struct rlimit new_limits;
+				new_limits.rlim_cur = new_limits.rlim_max = BENCHMARK_FILES_LIMIT;
+
+				if(!setrlimit(RLIMIT_NOFILE, &new_limits))
+					limits = new_limits;
+			}
+
+			limits.rlim_cur = limits.rlim_max;
+
+			if(setrlimit(RLIMIT_NOFILE, &limits))
+				M_THROW(__("Can't set max opened files limit: %1.", EE(errno)));
+
+			std::cout << "Max opened files limit: " << limits.rlim_max << std::endl;
+		}
+		// Поднимаем лимит на количество открытых файлов <--
+
+		// Открываем "лишние" дескрипторы -->
+		std::vector<int> fds;
+
+		for(int i = 0; i < BENCHMARK_OPENED_FILES; i++)
+		{
+			int fd = open("/dev/null", O_RDONLY);
+
+			if(fd < 0)
+				M_THROW(__("Can't open '%1': %2.", "/dev/null", EE(errno)));
+
+			fds.push_back(fd);
+		}
+		// Открываем "лишние" дескрипторы <--
+
+		print_result("fork + close() loop", measure_fork(close_fds_legacy));
+		print_result("fork + close_fds_from()", measure_fork(close_fds_new));
+		print_result("m::Process::spawn()", measure_spawn());
+
+		M_FOR_CONST_IT(fds, it)
+			close(*it);
+	}
+
+
+
+	void close_fds_legacy(int first_fd)
+	{
+		struct rlimit limits;
+
+		if(getrlimit(RLIMIT_NOFILE, &limits))
+			_exit(EXIT_FAILURE);
+
+		for(int fd = first_fd; fd < (int) limits.rlim_max; fd++)
+			close(fd);
+	}
+
+
+
+	void close_fds_new(int first_fd)
+	{
+		if(m::close_fds_from(first_fd))
+			_exit(EXIT_FAILURE);
+	}
+
+
+
+	void cue_scheduler_benchmark(void) throw(m::Exception)
+	{
+		// Команды умеет принимать только имитатор MPlayer'а
+		if(!getenv(PLAYER_ENV_NAME))
+			M_THROW(__("%1 environment variable must point to the mock_mplayer program.", PLAYER_ENV_NAME));
+
+		setenv("SUBMPLAYER_MOCK", CUE_BENCHMARK_MOCK_OPTIONS, 0);
+		std::cout << "Mock player options: " << getenv("SUBMPLAYER_MOCK") << std::endl;
+
+		// Тест выполняется до того, как main() игнорирует SIGPIPE
+		signal(SIGPIPE, SIG_IGN);
+
+		Subtitles subtitles;
+
+		for(Time_ms time = CUE_BENCHMARK_INTERVAL; time < 60 * 60 * 1000; time += CUE_BENCHMARK_INTERVAL)
+			subtitles.add(Subtitles::Subtitle(time, time + CUE_BENCHMARK_DURATION, _C("Subtitle %1", time)));
+
+		Glib::thread_init();
+
+		size_t pauses;
+
+		{
+			Mplayer mplayer;
+			Cue_scheduler scheduler(mplayer, subtitles);
+			Cue_benchmark benchmark(mplayer, scheduler);
+
+			scheduler.set_pause_after_cue(true);
+			pauses = benchmark.run();
+		}
+
+		std::cout << "Pauses at subtitle boundaries: " << pauses << std::endl;
+		dump_latency_stats(std::cout);
+	}
+
+
+
+	void highlight_latency_benchmark(void) throw(m::Exception)
+	{
+		// Без имитатора MPlayer'а время вывода строк состояния неизвестно
+		if(!getenv(PLAYER_ENV_NAME))
+			M_THROW(__("%1 environment variable must point to the mock_mplayer program.", PLAYER_ENV_NAME));
+
+		setenv("SUBMPLAYER_MOCK", HIGHLIGHT_BENCHMARK_MOCK_OPTIONS, 0);
+		std::cout << "Mock player options: " << getenv("SUBMPLAYER_MOCK") << std::endl;
+
+		// Тест выполняется до того, как main() игнорирует SIGPIPE
+		signal(SIGPIPE, SIG_IGN);
+
+		// Генерируем субтитры -->
+			std::vector<Subtitles> subtitles(HIGHLIGHT_BENCHMARK_TRACKS);
+
+			M_FOR_IT(subtitles, it)
+			{
+				for(Time_ms time = 0; time < 3 * 60 * 60 * 1000; time += HIGHLIGHT_BENCHMARK_INTERVAL)
+					it->add(Subtitles::Subtitle(time, time + HIGHLIGHT_BENCHMARK_INTERVAL, _C("Subtitle %1", time)));
+			}
+		// Генерируем субтитры <--
+
+		// Создаем нагрузку на процессор -->
+			std::vector< boost::shared_ptr<Cpu_load> > load;
+
+			{
+				const char* load_threads = getenv("SUBMPLAYER_BENCHMARK_LOAD");
+				int threads = load_threads ? atoi(load_threads) : 0;
+
+				std::cout << "CPU load threads: " << threads << std::endl;
+
+				for(int i = 0; i < threads; i++)
+					load.push_back(boost::shared_ptr<Cpu_load>(new Cpu_load));
+			}
+		// Создаем нагрузку на процессор <--
+
+		std::vector<Time_us> latencies;
+
+		// Запускаем GUI -->
+		{
+			int argc = 1;
+			char arg[] = APP_UNIX_NAME;
+			char* args[] = { arg, NULL };
+			char** argv = args;
+
+			Glib::thread_init();
+			gdk_threads_init();
+
+			Gtk::Main gtk_main(argc, argv);
+
+			boost::shared_ptr<Mplayer> mplayer(new Mplayer);
+			mplayer->start(std::vector<std::string>(1, "benchmark.avi"));
+
+			Main_window window(subtitles, mplayer);
+			window.enable_latency_recording();
+			Gtk::Main::run();
+
+			latencies = window.get_highlight_latencies();
+		}
+		// Запускаем GUI <--
+
+		load.clear();
+
+		print_latencies("Highlight updates", latencies);
+		dump_latency_stats(std::cout);
+	}
+
+
+
+	void mirror_benchmark(void) throw(m::Exception)
+	{
+		std::vector<Subtitles> subtitles(MIRROR_BENCHMARK_TRACKS);
+
+		M_FOR_IT(subtitles, it)
+		{
+			for(size_t cue_id = 0; cue_id < MIRROR_BENCHMARK_CUES; cue_id++)
+			{
+				Time_ms time = cue_id * 1000;
+				it->add(Subtitles::Subtitle(time, time + 1000, _C("Subtitle \"%1\"\nsecond line", cue_id)));
+			}
+		}
+
+		Mirror_server server("127.0.0.1:0");
+		server.set_tracks(subtitles);
+
+		Mirror_benchmark benchmark(server);
+		benchmark.run();
+	}
+
+
+
+	double measure_fork(void (*close_func)(int)) throw(m::Exception)
+	{
+		Time_us start_time = m::get_monotonic_time();
+
+		for(int i = 0; i < BENCHMARK_ITERATIONS; i++)
+		{
+			pid_t pid = fork();
+
+			if(pid < 0)
+				M_THROW(__("Can't fork the process: %1.", EE(errno)));
+			else if(!pid)
+			{
+				close_func(STDERR_FILENO + 1);
+				execlp("true", "true", NULL);
+				_exit(EXIT_FAILURE);
+			}
+
+			int status;
+
+			while(waitpid(pid, &status, 0) < 0)
+			{
+				if(errno != EINTR)
+					M_THROW(__("Waiting for child process failed: %1.", EE(errno)));
+			}
+
+			if(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+				M_THROW(_("Child process failed."));
+		}
+
+		return double(m::get_monotonic_time() - start_time) / BENCHMARK_ITERATIONS;
+	}
+
+
+
+	double measure_spawn(void) throw(m::Exception)
+	{
+		Time_us start_time = m::get_monotonic_time();
+
+		for(int i = 0; i < BENCHMARK_ITERATIONS; i++)
+		{
+			m::Process process;
+
+			process.spawn("true", std::vector<std::string>());
+			process.wait();
+		}
+
+		return double(m::get_monotonic_time() - start_time) / BENCHMARK_ITERATIONS;
+	}
+
+
+
+	void print_latencies(const std::string& title, std::vector<Time_us> latencies)
+	{
+		std::cout << title << ": " << latencies.size() << std::endl;
+
+		if(latencies.empty())
+			return;
+
+		std::sort(latencies.begin(), latencies.end());
+
+		const struct Percentile
+		{
+			const char*	name;
+			double		value;
+		} PERCENTILES[] = {
+			{ "p50"	,	0.5		},
+			{ "p90"	,	0.9		},
+			{ "p99"	,	0.99	},
+			{ "max"	,	1		},
+			{ NULL	,	0		}
+		};
+
+		for(const Percentile* it = PERCENTILES; it->name; it++)
+		{
+			size_t id = std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * it->value));
+
+			std::cout
+				<< std::setw(6) << std::left << it->name
+				<< std::setw(12) << std::right << latencies[id]
+				<< " us" << std::endl;
+		}
+	}
+
+
+
+	void print_result(const std::string& name, double time)
+	{
+		std::cout
+			<< std::setw(30) << std::left << name
+			<< std::setw(12) << std::right << std::fixed << std::setprecision(1) << time
+			<< " us/launch" << std::endl;
+	}
+
+
+
+	void run_benchmark(const std::string& name) throw(m::Exception)
+	{
+		if(name == "close-fds")
+			close_fds_benchmark();
+		else if(name == "cue-scheduler")
+			cue_scheduler_benchmark();
+		else if(name == "highlight-latency")
+			highlight_latency_benchmark();
+		else if(name == "mirror")
+			mirror_benchmark();
+		else if(name == "search")
+			search_benchmark();
+		else if(name == "shm")
+			shm_benchmark();
+		else
+			M_THROW(__("Invalid benchmark name: '%1'.", name));
+	}
+
+
+
+	void search_benchmark(void) throw(m::Exception)
+	{
+		std::vector<Subtitles> subtitles(1);
+		std::vector<std::string> words;
+
+		srand(0);
+
+		// Генерируем субтитры -->
+			size_t syllables_num = 0;
+			while(SEARCH_BENCHMARK_SYLLABLES[syllables_num])
+				syllables_num++;
+
+			for(size_t word_id = 0; word_id < SEARCH_BENCHMARK_WORDS; word_id++)
+			{
+				std::string word;
+
+				for(int syllable_id = rand() % 3; syllable_id >= 0; syllable_id--)
+					word += SEARCH_BENCHMARK_SYLLABLES[rand() % syllables_num];
+
+				words.push_back(word);
+			}
+
+			for(size_t cue_id = 0; cue_id < SEARCH_BENCHMARK_CUES; cue_id++)
+			{
+				std::string text;
+
+				for(int word_id = rand() % 8 + 3; word_id >= 0; word_id--)
+				{
+					if(!text.empty())
+						text += rand() % 4 ? ' ' : '\n';
+
+					text += words[rand() % words.size()];
+				}
+
+				Time_ms time = cue_id * 1000;
+				subtitles.front().add(Subtitles::Subtitle(time, time + 1000, text));
+			}
+		// Генерируем субтитры <--
+
+		// Строим индекс -->
+			Time_us start_time = m::get_monotonic_time();
+
+			Search_index index(subtitles);
+			index.wait();
+
+			std::cout << "Index built in " << m::get_monotonic_time() - start_time << " us." << std::endl;
+		// Строим индекс <--
+
+		// Выполняем запросы -->
+		{
+			std::vector<Time_us> typing_latencies;
+			std::vector<Time_us> full_latencies;
+			std::vector<Search_result> results;
+
+			for(size_t query_id = 0; query_id < SEARCH_BENCHMARK_QUERIES; query_id++)
+			{
+				// Запрос - несколько слов подряд из случайного субтитра
+				const std::string& text = subtitles.front().get()[rand() % SEARCH_BENCHMARK_CUES].text;
+				std::string query = text.substr(0, text.find(' ', text.size() / 2));
+
+				// Набираем запрос по одному символу -->
+					index.search("", &results);
+
+					for(const char* it = query.c_str(); *it; )
+					{
+						it = g_utf8_next_char(it);
+
+						Time_us search_time = m::get_monotonic_time();
+						index.search(std::string(query.c_str(), it), &results);
+						typing_latencies.push_back(m::get_monotonic_time() - search_time);
+					}
+				// Набираем запрос по одному символу <--
+
+				if(results.empty())
+					M_THROW(__("Unable to find '%1'.", query));
+
+				// Выполняем тот же запрос без учета предыдущего -->
+				{
+					index.search("", &results);
+
+					Time_us search_time = m::get_monotonic_time();
+					index.search(query, &results);
+					full_latencies.push_back(m::get_monotonic_time() - search_time);
+				}
+				// Выполняем тот же запрос без учета предыдущего <--
+			}
+
+			print_latencies("Type-ahead queries", typing_latencies);
+			print_latencies("Full queries", full_latencies);
+		}
+		// Выполняем запросы <--
+	}
+
+
+
+	void shm_benchmark(void) throw(m::Exception)
+	{
+		std::string name = _C("/%1-benchmark-%2", APP_UNIX_NAME, getpid());
+		State_publisher publisher(name);
+
+		std::cout
+			<< std::setw(8) << "readers"
+			<< std::setw(14) << "writes/s"
+			<< std::setw(10) << "ns/write"
+			<< std::setw(14) << "reads/s"
+			<< std::setw(8) << "torn"
+			<< std::setw(10) << "failures" << std::endl;
+
+		for(const int* readers_num = SHM_BENCHMARK_READERS; *readers_num >= 0; readers_num++)
+		{
+			std::vector< boost::shared_ptr<Shm_reader> > readers;
+
+			for(int i = 0; i < *readers_num; i++)
+				readers.push_back(boost::shared_ptr<Shm_reader>(new Shm_reader(name)));
+
+			// Публикуем состояние -->
+				Playback_state state;
+				size_t started_by[SHM_BENCHMARK_TRACKS];
+				size_t writes = 0;
+				Time_us start_time = m::get_monotonic_time();
+				Time_us elapsed;
+
+				do
+				{
+					for(size_t i = 0; i < SHM_BENCHMARK_BATCH; i++, writes++)
+					{
+						state.offset = writes;
+						state.offset_timestamp = writes;
+
+						for(size_t track_id = 0; track_id < SHM_BENCHMARK_TRACKS; track_id++)
+							started_by[track_id] = writes + 1;
+
+						publisher.publish(state, started_by, SHM_BENCHMARK_TRACKS);
+					}
+
+					elapsed = m::get_monotonic_time() - start_time;
+				}
+				while(elapsed < SHM_BENCHMARK_DURATION);
+			// Публикуем состояние <--
+
+			size_t reads = 0;
+			size_t torn = 0;
+			size_t failures = 0;
+
+			M_FOR_CONST_IT(readers, it)
+			{
+				(*it)->finish();
+				reads += (*it)->reads;
+				torn += (*it)->torn;
+				failures += (*it)->failures;
+			}
+
+			std::cout
+				<< std::setw(8) << *readers_num
+				<< std::setw(14) << size_t(writes * 1e6 / elapsed)
+				<< std::setw(10) << std::fixed << std::setprecision(1) << elapsed * 1e3 / writes
+				<< std::setw(14) << size_t(reads * 1e6 / elapsed)
+				<< std::setw(8) << torn
+				<< std::setw(10) << failures << std::endl;
+		}
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	init_trace();
+
+	if(argc != 2)
+	{
+		std::cerr << U2L(__("Usage: %1 benchmark_name", argv[0])) << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		run_benchmark(argv[1]);
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_W(__("Benchmark '%1' failed: %2.", argv[1], EE(e)));
+		return EXIT_FAILURE;
+	}
+
+	save_trace();
+
+	return EXIT_SUCCESS;
+}
+
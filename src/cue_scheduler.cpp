@@ -0,0 +1,318 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <mlib/fs.hpp>
+
+#include "cue_scheduler.hpp"
+#include "latency_stats.hpp"
+#include "mplayer.hpp"
+#include "subtitles.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// После снятия с паузы MPlayer может сообщить позицию, немного не
+	/// доходящую до конца субтитра, на котором была сделана пауза (позиция
+	/// выводится с точностью до 0.1 секунды). Если до конца такого субтитра
+	/// осталось меньше этого значения, то повторно на нем паузу не делаем.
+	const Time_ms REPAUSE_THRESHOLD = 500;
+}
+
+
+
+Cue_scheduler::Cue::Cue(Time_ms start, Time_ms end)
+:
+	start(start),
+	end(end)
+{
+}
+
+
+
+Cue_scheduler::Cue_scheduler(Mplayer& mplayer, const Subtitles& subtitles) throw(m::Exception)
+:
+	mplayer(mplayer),
+	pause_after_cue(false),
+	armed(false),
+	armed_cue(0),
+	armed_time(0)
+{
+	// Получаем границы субтитров -->
+	{
+		const Subtitles::Storage& storage = subtitles.get();
+
+		for(size_t i = 0; i < storage.size(); i++)
+		{
+			Time_ms end = storage[i].end_time;
+
+			// Если время исчезновения субтитра неизвестно, то он
+			// заканчивается с появлением следующего.
+			if(end <= storage[i].time && i + 1 < storage.size())
+				end = storage[i + 1].time;
+
+			if(end > storage[i].time)
+				this->cues.push_back(Cue(storage[i].time, end));
+		}
+
+		this->paused_cue = this->cues.size();
+	}
+	// Получаем границы субтитров <--
+
+	// Создаем таймер -->
+	{
+		int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+		if(fd < 0)
+			M_THROW(__("Can't create a timer: %1.", EE(errno)));
+
+		this->timer_fd.set(fd);
+
+		// Команда должна быть отправлена как можно ближе к границе
+		// субтитра, поэтому таймер обрабатывается раньше перерисовки окна и
+		// прочих событий.
+		this->timer_connection = Glib::signal_io().connect(
+			sigc::mem_fun(*this, &Cue_scheduler::on_timer_cb),
+			this->timer_fd.get(), Glib::IO_IN, Glib::PRIORITY_HIGH
+		);
+	}
+	// Создаем таймер <--
+
+	if(const char* value = getenv(PAUSE_AFTER_CUE_ENV_NAME))
+		this->pause_after_cue = *value && strcmp(value, "0");
+}
+
+
+
+Cue_scheduler::~Cue_scheduler(void)
+{
+	this->timer_connection.disconnect();
+}
+
+
+
+void Cue_scheduler::arm(size_t cue_id, Time_us time)
+{
+	struct itimerspec spec;
+
+	memset(&spec, 0, sizeof spec);
+	spec.it_value.tv_sec = time / 1000000;
+	spec.it_value.tv_nsec = time % 1000000 * 1000;
+
+	if(timerfd_settime(this->timer_fd.get(), TFD_TIMER_ABSTIME, &spec, NULL))
+	{
+		MLIB_SW(__("Can't set a timer: %1.", EE(errno)));
+		this->armed = false;
+		return;
+	}
+
+	this->armed = true;
+	this->armed_cue = cue_id;
+	this->armed_time = time;
+}
+
+
+
+void Cue_scheduler::disarm(void)
+{
+	if(!this->armed)
+		return;
+
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof spec);
+
+	if(timerfd_settime(this->timer_fd.get(), 0, &spec, NULL))
+		MLIB_SW(__("Can't set a timer: %1.", EE(errno)));
+
+	this->armed = false;
+}
+
+
+
+size_t Cue_scheduler::find_next_end(Time_ms offset) const
+{
+	size_t low = 0;
+	size_t high = this->cues.size();
+
+	// Ищем первый субтитр, начинающийся после offset
+	while(low < high)
+	{
+		size_t mid = (low + high) / 2;
+
+		if(this->cues[mid].start <= offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	// Если offset попадает в предыдущий субтитр, то ближайшая граница - его
+	// конец.
+	if(low && this->cues[low - 1].end > offset)
+		return low - 1;
+	else
+		return low;
+}
+
+
+
+bool Cue_scheduler::get_pause_after_cue(void) const
+{
+	return this->pause_after_cue;
+}
+
+
+
+bool Cue_scheduler::on_timer_cb(Glib::IOCondition condition)
+{
+	TRACE_SPAN("cue_timer");
+
+	uint64_t expirations;
+
+	try
+	{
+		// Таймер мог быть перевзведен уже после срабатывания
+		if(!m::fs::unix_read(this->timer_fd.get(), &expirations, sizeof expirations, true))
+			return true;
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_SW(__("Can't read a timer: %1.", EE(e)));
+		return true;
+	}
+
+	if(!this->armed)
+		return true;
+
+	this->armed = false;
+
+	if(this->mplayer.get_playback_state().paused)
+		return true;
+
+	try
+	{
+		this->mplayer.send_command("pause");
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_SW(__("Unable to send a command to MPlayer: %1.", EE(e)));
+		return true;
+	}
+
+	Time_us delay = m::get_monotonic_time() - this->armed_time;
+	record_latency(LATENCY_CUE_DISPATCH, delay);
+
+	this->paused_cue = this->armed_cue;
+	MLIB_D(_C("Paused at the end of subtitle %1 (%2 us after the boundary).", this->armed_cue, delay));
+
+	return true;
+}
+
+
+
+void Cue_scheduler::replay_current_cue(void) throw(m::Exception)
+{
+	Playback_state state = this->mplayer.get_playback_state();
+	Time_ms offset = state.get_offset_at(m::get_monotonic_time());
+	size_t cue_id;
+
+	if(state.paused && this->paused_cue < this->cues.size())
+		cue_id = this->paused_cue;
+	else
+	{
+		cue_id = this->find_next_end(offset);
+
+		// Если сейчас никакой субтитр не отображается, то повторяем
+		// последний закончившийся.
+		if(cue_id >= this->cues.size() || this->cues[cue_id].start > offset)
+		{
+			if(!cue_id)
+				return;
+
+			cue_id--;
+		}
+	}
+
+	// Форматируем позицию без использования чисел с плавающей точкой, т. к.
+	// их формат зависит от текущей локали, а MPlayer ожидает точку.
+	char command[64];
+	snprintf(command, sizeof command, "seek %lld.%03lld 2",
+		static_cast<long long>(this->cues[cue_id].start / 1000),
+		static_cast<long long>(this->cues[cue_id].start % 1000));
+
+	MLIB_D(_C("Replaying subtitle %1 from %2.", cue_id, this->cues[cue_id].start));
+
+	// Генерирует m::Exception
+	this->mplayer.send_command(command);
+
+	// Перемотка снимает MPlayer с паузы
+	this->paused_cue = this->cues.size();
+}
+
+
+
+void Cue_scheduler::set_pause_after_cue(bool enable)
+{
+	MLIB_D(_C("Pause after each subtitle: %1.", enable));
+
+	this->pause_after_cue = enable;
+	this->paused_cue = this->cues.size();
+	this->update();
+}
+
+
+
+void Cue_scheduler::update(void)
+{
+	Playback_state state = this->mplayer.get_playback_state();
+
+	if(!this->pause_after_cue || state.paused || !state.offset_timestamp)
+	{
+		this->disarm();
+		return;
+	}
+
+	Time_ms offset = state.get_offset_at(m::get_monotonic_time());
+	size_t cue_id = this->find_next_end(offset);
+
+	if(
+		cue_id == this->paused_cue && cue_id < this->cues.size() &&
+		this->cues[cue_id].end - offset < REPAUSE_THRESHOLD
+	)
+		cue_id = this->find_next_end(this->cues[cue_id].end);
+
+	if(cue_id >= this->cues.size())
+	{
+		this->disarm();
+		return;
+	}
+
+	// Вычисляем время границы от момента изменения позиции, а не от
+	// текущего момента, чтобы не накапливать погрешность округления.
+	this->arm(cue_id, state.offset_timestamp + (this->cues[cue_id].end - state.offset) * 1000);
+}
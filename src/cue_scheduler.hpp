@@ -0,0 +1,130 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_CUE_SCHEDULER
+	#define HEADER_CUE_SCHEDULER
+
+	#include <string>
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+
+	#include <sigc++/connection.h>
+
+	#include <glibmm/main.h>
+
+	class Mplayer;
+	class Subtitles;
+
+
+	/// Переменная окружения, включающая режим паузы после каждого субтитра
+	/// при запуске программы.
+	#define PAUSE_AFTER_CUE_ENV_NAME "SUBMPLAYER_PAUSE_AFTER_CUE"
+
+
+	/// Отправляет MPlayer'у команды точно на границах субтитров - для
+	/// изучения языка: пауза после каждой реплики и повтор текущей реплики.
+	///
+	/// Момент окончания текущего субтитра вычисляется по интерполированной
+	/// позиции воспроизведения, и на него взводится timerfd (по
+	/// CLOCK_MONOTONIC), обрабатываемый в Main loop'е с высоким приоритетом.
+	/// Таймер перевзводится при каждом изменении состояния воспроизведения.
+	/// Отклонение момента отправки команды от вычисленной границы
+	/// записывается в статистику задержек (LATENCY_CUE_DISPATCH).
+	class Cue_scheduler: public boost::noncopyable
+	{
+		private:
+			/// Границы одного субтитра.
+			struct Cue
+			{
+				Cue(Time_ms start, Time_ms end);
+
+				Time_ms	start;
+				Time_ms	end;
+			};
+
+
+		public:
+			Cue_scheduler(Mplayer& mplayer, const Subtitles& subtitles) throw(m::Exception);
+			~Cue_scheduler(void);
+
+
+		private:
+			/// MPlayer, которому отправляются команды.
+			Mplayer&			mplayer;
+
+			/// Границы субтитров, упорядоченные по времени появления.
+			std::vector<Cue>	cues;
+
+			/// Включен ли режим паузы после каждого субтитра.
+			bool				pause_after_cue;
+
+			/// Таймер, срабатывающий на границе субтитра.
+			m::File_holder		timer_fd;
+
+			/// Обработчик срабатывания таймера.
+			sigc::connection	timer_connection;
+
+			/// Взведен ли таймер.
+			bool				armed;
+
+			/// Субтитр, на конец которого взведен таймер.
+			size_t				armed_cue;
+
+			/// Время (по монотонным часам), на которое взведен таймер.
+			Time_us				armed_time;
+
+			/// Субтитр, после которого уже была сделана пауза (cues.size(),
+			/// если такого нет).
+			size_t				paused_cue;
+
+
+		public:
+			/// Возвращает, включен ли режим паузы после каждого субтитра.
+			bool	get_pause_after_cue(void) const;
+
+			/// Воспроизводит текущий (или только что закончившийся)
+			/// субтитр с начала.
+			void	replay_current_cue(void) throw(m::Exception);
+
+			/// Включает или выключает режим паузы после каждого субтитра.
+			void	set_pause_after_cue(bool enable);
+
+			/// Перевзводит таймер в соответствии с текущим состоянием
+			/// воспроизведения. Должна вызываться при каждом его изменении.
+			void	update(void);
+
+		private:
+			/// Взводит таймер на момент time (по монотонным часам).
+			void	arm(size_t cue_id, Time_us time);
+
+			/// Снимает таймер.
+			void	disarm(void);
+
+			/// Возвращает первый субтитр, заканчивающийся после offset, или
+			/// cues.size(), если такого нет.
+			size_t	find_next_end(Time_ms offset) const;
+
+			/// Обработчик срабатывания таймера.
+			bool	on_timer_cb(Glib::IOCondition condition);
+	};
+
+#endif
@@ -0,0 +1,254 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <sigc++/functors/ptr_fun.h>
+
+#include <glibmm/main.h>
+
+#include <mlib/histogram.hpp>
+
+#include "latency_stats.hpp"
+
+
+
+namespace
+{
+	/// Имена этапов.
+	const char* const LATENCY_STAGE_NAMES[LATENCY_STAGES_NUM] = {
+		"parse",
+		"dispatch",
+		"handler",
+		"scroll_to",
+		"set_current",
+		"total",
+		"cue_dispatch",
+		"redraw"
+	};
+
+	/// Выводимые перцентили.
+	const struct Percentile
+	{
+		const char*	name;
+		double		value;
+	} PERCENTILES[] = {
+		{ "p50"		,	0.5		},
+		{ "p90"		,	0.9		},
+		{ "p99"		,	0.99	},
+		{ "p999"	,	0.999	},
+		{ NULL		,	0		}
+	};
+
+
+	/// Гистограммы задержек этапов.
+	m::Histogram	LATENCY_HISTOGRAMS[LATENCY_STAGES_NUM];
+
+	/// pipe, через который обработчик SIGUSR1 передает запрос на вывод
+	/// статистики в Main loop.
+	int				DUMP_REQUEST_PIPE[2] = { -1, -1 };
+
+
+
+	/// Обработчик запроса на вывод статистики.
+	bool	on_dump_request_cb(Glib::IOCondition condition);
+
+	/// Обработчик SIGUSR1.
+	void	sigusr1_handler(int signal_no);
+
+
+
+	bool on_dump_request_cb(Glib::IOCondition condition)
+	{
+		char buf[16];
+
+		while(read(DUMP_REQUEST_PIPE[0], buf, sizeof buf) > 0)
+			;
+
+		dump_latency_stats(std::cerr);
+		save_latency_stats();
+
+		return true;
+	}
+
+
+
+	void sigusr1_handler(int signal_no)
+	{
+		int saved_errno = errno;
+
+		// Ошибку игнорируем: если pipe переполнен, то запрос на вывод
+		// статистики уже и так ожидает обработки.
+		ssize_t rval = write(DUMP_REQUEST_PIPE[1], "", 1);
+		(void) rval;
+
+		errno = saved_errno;
+	}
+}
+
+
+
+void dump_latency_stats(std::ostream& stream)
+{
+	std::ios::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+
+	stream << "Latency statistics (us):" << std::endl;
+
+	stream << std::setw(12) << std::left << "stage" << std::right << std::setw(10) << "count";
+	for(const Percentile* percentile = PERCENTILES; percentile->name; percentile++)
+		stream << std::setw(8) << percentile->name;
+	stream << std::setw(8) << "max" << std::setw(10) << "mean" << std::endl;
+
+	for(int stage = 0; stage < LATENCY_STAGES_NUM; stage++)
+	{
+		const m::Histogram& histogram = LATENCY_HISTOGRAMS[stage];
+
+		stream
+			<< std::setw(12) << std::left << LATENCY_STAGE_NAMES[stage]
+			<< std::right << std::setw(10) << histogram.get_count();
+
+		for(const Percentile* percentile = PERCENTILES; percentile->name; percentile++)
+			stream << std::setw(8) << histogram.get_percentile(percentile->value);
+
+		stream
+			<< std::setw(8) << histogram.get_max()
+			<< std::setw(10) << std::fixed << std::setprecision(1) << histogram.get_mean()
+			<< std::endl;
+	}
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+
+
+void dump_latency_stats_json(std::ostream& stream)
+{
+	std::ios::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+
+	stream << "{";
+
+	for(int stage = 0; stage < LATENCY_STAGES_NUM; stage++)
+	{
+		const m::Histogram& histogram = LATENCY_HISTOGRAMS[stage];
+
+		stream
+			<< (stage ? ", " : "")
+			<< "\"" << LATENCY_STAGE_NAMES[stage] << "\": {"
+			<< "\"count\": " << histogram.get_count();
+
+		for(const Percentile* percentile = PERCENTILES; percentile->name; percentile++)
+			stream << ", \"" << percentile->name << "\": " << histogram.get_percentile(percentile->value);
+
+		stream
+			<< ", \"max\": " << histogram.get_max()
+			<< ", \"mean\": " << std::fixed << std::setprecision(1) << histogram.get_mean()
+			<< "}";
+	}
+
+	stream << "}" << std::endl;
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+
+
+void init_latency_stats(void) throw(m::Exception)
+{
+	if(DUMP_REQUEST_PIPE[0] >= 0)
+		return;
+
+	// Создаем pipe -->
+	{
+		// Генерирует m::Exception
+		std::pair<int, int> pipe_fds = m::unix_pipe(O_CLOEXEC | O_NONBLOCK);
+
+		DUMP_REQUEST_PIPE[0] = pipe_fds.first;
+		DUMP_REQUEST_PIPE[1] = pipe_fds.second;
+	}
+	// Создаем pipe <--
+
+	Glib::signal_io().connect(
+		sigc::ptr_fun(&on_dump_request_cb), DUMP_REQUEST_PIPE[0], Glib::IO_IN);
+
+	// Устанавливаем обработчик сигнала -->
+	{
+		struct sigaction sig_action;
+
+		sig_action.sa_handler = &sigusr1_handler;
+		sigemptyset(&sig_action.sa_mask);
+		sig_action.sa_flags = SA_RESTART;
+
+		if(sigaction(SIGUSR1, &sig_action, NULL))
+			M_THROW(__("Can't set SIGUSR1 handler: %1.", EE(errno)));
+	}
+	// Устанавливаем обработчик сигнала <--
+}
+
+
+
+void record_latency(Latency_stage stage, Time_us latency)
+{
+	LATENCY_HISTOGRAMS[stage].record(latency);
+}
+
+
+
+void save_latency_stats(void)
+{
+	const char* prefix = getenv(STATS_ENV_NAME);
+
+	if(!prefix || !*prefix)
+		return;
+
+	{
+		std::string path = std::string(prefix) + ".txt";
+		std::ofstream file(path.c_str());
+
+		dump_latency_stats(file);
+
+		if(!file.good())
+			MLIB_SW(__("Unable to save latency statistics to '%1'.", L2U(path)));
+	}
+
+	{
+		std::string path = std::string(prefix) + ".json";
+		std::ofstream file(path.c_str());
+
+		dump_latency_stats_json(file);
+
+		if(!file.good())
+			MLIB_SW(__("Unable to save latency statistics to '%1'.", L2U(path)));
+	}
+}
+
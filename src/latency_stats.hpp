@@ -0,0 +1,87 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_LATENCY_STATS
+	#define HEADER_LATENCY_STATS
+
+	#include <ostream>
+
+
+	/// Переменная окружения, задающая префикс путей к файлам, в которые
+	/// сохраняется статистика задержек (<префикс>.txt и <префикс>.json).
+	#define STATS_ENV_NAME "SUBMPLAYER_STATS"
+
+
+	/// Этапы передачи новой позиции от MPlayer'а до выделения субтитра.
+	enum Latency_stage
+	{
+		/// Чтение вывода MPlayer'а -> разбор строки состояния.
+		LATENCY_PARSE,
+
+		/// Разбор строки состояния -> получение уведомления Main loop'ом.
+		LATENCY_DISPATCH,
+
+		/// Получение уведомления Main loop'ом -> вызов обработчика в главном
+		/// окне.
+		LATENCY_HANDLER,
+
+		/// Поиск по общей временной шкале дорожек (Timeline) и выполнение
+		/// Subtitles_control::scroll_to() для всех дорожек.
+		LATENCY_SCROLL,
+
+		/// Выполнение Subtitles_control::set_current().
+		LATENCY_SET_CURRENT,
+
+		/// Чтение вывода MPlayer'а -> выделение нового субтитра.
+		LATENCY_TOTAL,
+
+		/// Граница субтитра -> отправка команды MPlayer'у планировщиком
+		/// команд (Cue_scheduler).
+		LATENCY_CUE_DISPATCH,
+
+		/// Перерисовка списка субтитров (Subtitles_view).
+		LATENCY_REDRAW,
+
+		LATENCY_STAGES_NUM
+	};
+
+
+	/// Выводит статистику задержек в текстовом виде.
+	void	dump_latency_stats(std::ostream& stream);
+
+	/// Выводит статистику задержек в формате JSON.
+	void	dump_latency_stats_json(std::ostream& stream);
+
+	/// Устанавливает обработчик SIGUSR1, по которому статистика задержек
+	/// выводится в стандартный поток ошибок и сохраняется в файлы.
+	/// Должна вызываться из потока, в котором работает Main loop.
+	void	init_latency_stats(void) throw(m::Exception);
+
+	/// Записывает задержку (в микросекундах) этапа stage. Не использует
+	/// блокировок и может вызываться из любого потока.
+	void	record_latency(Latency_stage stage, Time_us latency);
+
+	/// Сохраняет статистику задержек в файлы, если задана переменная
+	/// окружения STATS_ENV_NAME.
+	void	save_latency_stats(void);
+
+#endif
+
@@ -27,11 +27,15 @@
 
 #include <cerrno>
 #include <clocale>
+#include <cstring>
 
 #include <iostream>
 #include <memory>
 
-#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 #include <gdk/gdk.h>
 
@@ -40,9 +44,16 @@
 
 #include <mlib/fs.hpp>
 
+#include "latency_stats.hpp"
 #include "main_window.hpp"
 #include "mplayer.hpp"
+#include "playlist.hpp"
+#include "prefetcher.hpp"
+#include "startup_report.hpp"
 #include "subtitles.hpp"
+#include "terminal_screen.hpp"
+#include "terminal_ui.hpp"
+#include "trace.hpp"
 
 
 
@@ -54,6 +65,46 @@ namespace
 	/// Были ли эти опции изменены.
 	bool			TIO_CHANGED = false;
 
+	/// Опции MPlayer'а, значение которых передается следующим аргументом
+	/// (все опции из вывода "mplayer -list-options", не являющиеся флагами).
+	/// Только по ним можно отличить значения опций (в том числе имена
+	/// файлов: -sub, -audiofile, -dumpfile...) от проигрываемых файлов.
+	const char* const VALUE_OPTIONS[] = {
+		"a52drc", "ac", "af", "af-add", "af-adv", "af-del", "af-pre", "afm",
+		"aid", "alang", "ao", "aspect", "ass-border-color",
+		"ass-bottom-margin", "ass-color", "ass-font-scale", "ass-force-style",
+		"ass-hinting", "ass-line-spacing", "ass-styles", "ass-top-margin",
+		"audio-demuxer", "audiofile", "audiofile-cache", "autosync",
+		"bandwidth", "bluray-angle", "bluray-device", "brightness", "cache",
+		"cache-min", "cache-seek-min", "cdda", "cdrom-device", "channels",
+		"chapter", "codecs-file", "colorkey", "contrast", "cookies-file",
+		"delay", "demuxer", "display", "doubleclick-time", "dumpfile",
+		"dvd-device", "dvd-speed", "dvdangle", "edl", "edlout", "endpos",
+		"ffactor", "font", "format", "fps", "frames", "fstype", "gamma",
+		"geometry", "heartbeat-cmd", "heartbeat-interval",
+		"http-header-fields", "hue", "icy-encoding", "ifo", "include", "input",
+		"key-fifo-size", "lavdopts", "lavfdopts", "lircconf", "loadidx",
+		"loop", "mc", "menu-cfg", "menu-chroot", "menu-root", "mf", "mixer",
+		"mixer-channel", "monitor-dotclock", "monitor-hfreq", "monitor-vfreq",
+		"monitoraspect", "monitorpixelaspect", "msgcharset", "msglevel",
+		"name", "osd-duration", "osdlevel", "panscan", "panscanrange",
+		"passwd", "playing-msg", "playlist", "pp", "priority", "profile",
+		"psprobe", "pvr", "radio", "rawaudio", "rawvideo", "referrer",
+		"refreshrate", "rtc-device", "rtsp-destination", "rtsp-port",
+		"saturation", "saveidx", "sb", "screenh", "screenw", "sid", "slang",
+		"softvol-max", "speed", "spuaa", "spualign", "spugauss", "srate", "ss",
+		"sstep", "stereo", "sub", "sub-bg-alpha", "sub-bg-color",
+		"sub-demuxer", "sub-fuzziness", "subalign", "subcc", "subcp",
+		"subdelay", "subfile", "subfont", "subfont-autoscale", "subfont-blur",
+		"subfont-encoding", "subfont-osd-scale", "subfont-outline",
+		"subfont-text-scale", "subfps", "subpos", "subwidth", "sws",
+		"term-osd-esc", "title", "tsprobe", "tsprog", "tv", "tvscan", "udp-ip",
+		"udp-port", "udp-seek-threshold", "unrarexec", "user", "user-agent",
+		"vc", "vf", "vf-add", "vf-del", "vf-pre", "vfm", "vid", "vo", "vobsub",
+		"vobsubid", "volstep", "volume", "wid", "x", "xineramascreen", "xy",
+		"y", NULL
+	};
+
 
 
 	/// Отключает строковую буферизацию стандартного ввода.
@@ -63,6 +114,18 @@ namespace
 	/// выполнить перед завершением программы.
 	void exit_wrap(int status) __attribute__ ((__noreturn__));
 
+	/// Проверяет, может ли arg быть проигрываемым файлом: является ли он
+	/// существующим путем или URL.
+	bool is_playable(const char* arg);
+
+	/// Проверяет, является ли arg опцией MPlayer'а, значение которой
+	/// передается следующим аргументом.
+	bool is_value_option(const char* arg);
+
+	/// Загружает субтитры из файлов paths в subtitles (выполняется
+	/// отдельным потоком параллельно с запуском MPlayer'а и GTK).
+	void load_subtitles_thread(const std::vector<std::string>* paths, std::vector<Subtitles>* subtitles);
+
 	/// Если в терминальный интерфейс стандартного ввода были внесены
 	/// какие-либо изменения - возвращает их к исходному состоянию.
 	void rollback_stdin_tio_changes(void);
@@ -97,12 +160,59 @@ namespace
 
 	void exit_wrap(int status)
 	{
+		restore_terminal_screen();
 		rollback_stdin_tio_changes();
+		save_trace();
 		exit(status);
 	}
 
 
 
+	bool is_playable(const char* arg)
+	{
+		if(strstr(arg, "://"))
+			return true;
+
+		try
+		{
+			m::fs::unix_stat(L2U(arg));
+			return true;
+		}
+		catch(m::Sys_exception&)
+		{
+			return false;
+		}
+	}
+
+
+
+	bool is_value_option(const char* arg)
+	{
+		if(*arg++ != '-')
+			return false;
+
+		// MPlayer принимает опции и с двумя дефисами
+		if(*arg == '-')
+			arg++;
+
+		for(const char* const* it = VALUE_OPTIONS; *it; it++)
+			if(!strcmp(arg, *it))
+				return true;
+
+		return false;
+	}
+
+
+
+	void load_subtitles_thread(const std::vector<std::string>* paths, std::vector<Subtitles>* subtitles)
+	{
+		startup_phase_begin(STARTUP_PARSE);
+		load_subtitles(*paths).swap(*subtitles);
+		startup_phase_end(STARTUP_PARSE);
+	}
+
+
+
 	void rollback_stdin_tio_changes(void)
 	{
 		if(TIO_CHANGED)
@@ -125,6 +235,8 @@ namespace
 
 	void warning_function(const char* file, const int line, const std::string& title, const std::string& message)
 	{
+		// Иначе сообщение останется на альтернативном экране терминала
+		restore_terminal_screen();
 
 		std::cerr
 			#ifdef DEBUG_MODE
@@ -148,7 +260,7 @@ namespace
 	{
 		std::cout << U2L(__(
 			"Usage:\n"
-			"%1 video_file [other mplayer options]",
+			"%1 video_file [other video files] [other mplayer options]",
 			APP_UNIX_NAME
 		)) << std::endl;
 
@@ -161,6 +273,8 @@ namespace
 int main(int argc, char *argv[])
 {
 	m::set_warning_function(warning_function);
+	init_trace();
+	init_startup_report();
 
 	// Устанавливаем обработчики сигналов -->
 	{
@@ -198,107 +312,117 @@ int main(int argc, char *argv[])
 	// gettext <--
 
 
-	std::vector<Subtitles> subtitles;
+	std::vector<std::string> subtitles_paths;
 	std::vector<std::string> mplayer_args;
+	boost::shared_ptr<Playlist> playlist;
+	boost::scoped_ptr<Prefetcher> prefetcher;
 
 	// Получаем все необходимые нам данные -->
 	{
-		std::string file_to_play;
-		std::vector<std::string> subtitles_paths;
+		std::vector<std::string> files_to_play;
 
 		// Парсим аргументы командной строки -->
 			MLIB_D("Parsing command line args...");
+			startup_phase_begin(STARTUP_ARGS);
 
 			if(argc < 2)
 				usage();
 
 			{
 				char* const* arg = argv + 1;
+				const char* unplayable_file = NULL;
 
 				while(*arg)
 				{
 					MLIB_D(_C("Gotten arg: '%1'.", *arg));
 
-					if(**arg != '-' && file_to_play.empty())
-						file_to_play = L2U(*arg);
+					// Все аргументы, не являющиеся опциями или их
+					// значениями, - проигрываемые файлы.
+					if(is_value_option(*arg) && arg[1])
+					{
+						mplayer_args.push_back(L2U(*arg++));
+						MLIB_D(_C("Gotten option value: '%1'.", *arg));
+					}
+					else if(**arg != '-')
+					{
+						// Значение опции, отсутствующей в VALUE_OPTIONS, не
+						// должно стать элементом списка воспроизведения,
+						// поэтому им считаются только существующие файлы и
+						// URL.
+						if(is_playable(*arg))
+							files_to_play.push_back(L2U(*arg));
+						else if(!unplayable_file)
+							unplayable_file = *arg;
+					}
 					mplayer_args.push_back(L2U(*arg));
 
 					arg++;
 				}
+
+				// Ни один аргумент не похож на файл - пусть об ошибке
+				// сообщит MPlayer.
+				if(files_to_play.empty() && unplayable_file)
+					files_to_play.push_back(L2U(unplayable_file));
 			}
 
-			if(file_to_play.empty())
+			if(files_to_play.empty())
 				usage();
 
-			MLIB_D(_C("File to play: '%1'.", file_to_play));
+			MLIB_D(_C("File to play: '%1'.", files_to_play.front()));
+			startup_phase_end(STARTUP_ARGS);
 		// Парсим аргументы командной строки <--
 
-		// Получаем список файлов с субтитрами, соответствующими проигрываемому
-		// файлу.
-		// -->
+		// Начало видео загружаем в кэш, пока ищутся субтитры и
+		// запускается MPlayer.
+		if(Prefetcher::is_enabled())
 		{
-			MLIB_D(_C("Finding subtitles for '%1'...", file_to_play));
+			prefetcher.reset(new Prefetcher);
+			prefetcher->add_video(files_to_play.front());
+		}
 
-			Path file_dir_path = Path(file_to_play).dirname();
-			Glib::ustring play_name = m::fs::strip_extension(Path(file_to_play).basename()).uppercase();
+		// Ищем субтитры, соответствующие проигрываемому файлу. Сами
+		// субтитры загружаются позже - параллельно с запуском MPlayer'а.
+		// -->
+			startup_phase_begin(STARTUP_SCAN);
 
 			try
 			{
-				for(
-					fs::directory_iterator it(U2L(file_dir_path.string()));
-					it != fs::directory_iterator(); it++
-				)
-				{
-					Glib::ustring file_name = L2U( Path(it->path()).basename() );
-					MLIB_D(_C("Gotten file: '%1'.", file_name));
-
-					if(!m::fs::check_extension(file_name, "srt"))
-						continue;
+				subtitles_paths = find_subtitles(files_to_play.front());
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_W(EE(e));
+			}
 
-					file_name = m::fs::strip_extension(file_name);
+			startup_phase_end(STARTUP_SCAN);
 
-					if(file_name.size() >= play_name.size() && file_name.substr(0, play_name.size()).uppercase() == play_name)
-					{
-						MLIB_D("This file is subtitles file for our playing file.");
-						subtitles_paths.push_back(L2U( it->path().string() ));
-					}
-				}
-			}
-			catch(fs::filesystem_error& e)
+			if(prefetcher.get() != NULL)
 			{
-				MLIB_W(__("Error while reading directory '%1': %2.", file_dir_path, EE(errno)));
+				M_FOR_CONST_IT(subtitles_paths, it)
+					prefetcher->add_file(*it);
 			}
-		}
 		// <--
 
-		// Загружаем все необходимые субтитры -->
-			M_FOR_CONST_IT(subtitles_paths, it)
-			{
-				subtitles.push_back(Subtitles());
+		// Если MPlayer будет проигрывать несколько файлов, то субтитры для
+		// последующих файлов загружаются по мере необходимости.
+		if(files_to_play.size() > 1)
+		{
+			MLIB_D(_C("Playlist mode: %1 files.", files_to_play.size()));
 
-				try
-				{
-					subtitles.back().load(*it);
-				#ifdef DEVELOP_MODE
-					subtitles.back().dump();
-				#endif
-				}
-				catch(m::Exception& e)
-				{
-					MLIB_SW(__("Error while reading subtitles file '%1': %2.", *it, EE(e)));
-					subtitles.pop_back();
-				}
-			}
-		// Загружаем все необходимые субтитры <--
+			// Playlist сообщает об окончании загрузки субтитров через
+			// Glib::Dispatcher.
+			Glib::thread_init();
+			playlist.reset(new Playlist(files_to_play));
+		}
 	}
 	// Получаем все необходимые нам данные <--
 
 	// Начинаем работу -->
-		if(subtitles.empty())
+		if(subtitles_paths.empty() && !playlist)
 		{
 			try
 			{
-				m::unix_execvp("mplayer", mplayer_args);
+				m::unix_execvp(get_player_path(), mplayer_args);
 			}
 			catch(m::Sys_exception& e)
 			{
@@ -307,12 +431,56 @@ int main(int argc, char *argv[])
 		}
 		else
 		{
-			Glib::thread_init();
-			gdk_threads_init();
+			std::vector<Subtitles> subtitles;
+			boost::shared_ptr<Mplayer> mplayer;
+			bool terminal_ui = is_terminal_ui_requested();
+
+			if(!Glib::thread_supported())
+				Glib::thread_init();
+
+			// MPlayer запускаем в первую очередь: его собственный запуск
+			// (разбор контейнера, открытие декодеров) выполняется
+			// параллельно с загрузкой субтитров, инициализацией GTK и
+			// созданием окна.
+			// -->
+				startup_phase_begin(STARTUP_PLAYER_SPAWN);
+
+				mplayer.reset(new Mplayer);
+
+				// Экраном терминала управляет терминальный интерфейс
+				if(terminal_ui)
+					mplayer->disable_terminal_output();
+
+				try
+				{
+					mplayer->start(mplayer_args);
+				}
+				catch(m::Exception& e)
+				{
+					MLIB_W(EE(e));
+				}
+
+				startup_phase_end(STARTUP_PLAYER_SPAWN);
+			// <--
 
-			std::auto_ptr<Gtk::Main> gtk_main = std::auto_ptr<Gtk::Main>(new Gtk::Main(argc, argv));
-			Glib::set_prgname(APP_UNIX_NAME);
-			Glib::set_application_name(APP_NAME);
+			boost::thread subtitles_loader(
+				boost::bind(&load_subtitles_thread, &subtitles_paths, &subtitles));
+
+			// Терминальный интерфейс работает без GTK
+			std::auto_ptr<Gtk::Main> gtk_main;
+
+			if(!terminal_ui)
+			{
+				startup_phase_begin(STARTUP_GTK_INIT);
+
+				gdk_threads_init();
+
+				gtk_main = std::auto_ptr<Gtk::Main>(new Gtk::Main(argc, argv));
+				Glib::set_prgname(APP_UNIX_NAME);
+				Glib::set_application_name(APP_NAME);
+
+				startup_phase_end(STARTUP_GTK_INIT);
+			}
 
 			// Отключаем строковую буферизацию стандартного ввода -->
 				switch(isatty(STDIN_FILENO))
@@ -330,9 +498,76 @@ int main(int argc, char *argv[])
 				}
 			// Отключаем строковую буферизацию стандартного ввода <--
 
-			Main_window window(subtitles, mplayer_args);
-			subtitles.clear();
-			Gtk::Main::run();
+			try
+			{
+				init_latency_stats();
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_W(EE(e));
+			}
+
+			// Окно (или терминальный интерфейс) создается до окончания
+			// загрузки субтитров - до появления дорожек последняя позиция, о
+			// которой сообщил MPlayer, просто сохраняется.
+			// -->
+				if(terminal_ui)
+				{
+					boost::scoped_ptr<Terminal_ui> ui;
+
+					startup_phase_begin(STARTUP_WINDOW);
+
+					try
+					{
+						ui.reset(new Terminal_ui(mplayer, playlist));
+					}
+					catch(m::Exception& e)
+					{
+						MLIB_W(EE(e));
+					}
+
+					startup_phase_end(STARTUP_WINDOW);
+
+					startup_phase_begin(STARTUP_PARSE_WAIT);
+					subtitles_loader.join();
+					startup_phase_end(STARTUP_PARSE_WAIT);
+
+					if(subtitles.empty() && !playlist)
+						MLIB_SW(_("None of the subtitles files could be loaded."));
+
+					startup_phase_begin(STARTUP_TRACKS);
+					ui->set_subtitles(subtitles);
+					startup_phase_end(STARTUP_TRACKS);
+
+					ui->run();
+				}
+				else
+				{
+					startup_phase_begin(STARTUP_WINDOW);
+					Main_window window(std::vector<Subtitles>(), mplayer, playlist);
+					startup_phase_end(STARTUP_WINDOW);
+
+					startup_phase_begin(STARTUP_PARSE_WAIT);
+					subtitles_loader.join();
+					startup_phase_end(STARTUP_PARSE_WAIT);
+
+					// Как и в случае, когда субтитры не были найдены, MPlayer
+					// просто проигрывает файл - окно без субтитров не нужно.
+					if(subtitles.empty() && !playlist)
+					{
+						MLIB_SW(_("None of the subtitles files could be loaded."));
+						window.hide();
+					}
+
+					startup_phase_begin(STARTUP_TRACKS);
+					window.set_subtitles(subtitles);
+					startup_phase_end(STARTUP_TRACKS);
+
+					Gtk::Main::run();
+				}
+			// <--
+
+			save_latency_stats();
 		}
 	// Начинаем работу <--
 
@@ -25,9 +25,11 @@
 #include <gdk/gdk.h>
 #include <gdk/gdkkeysyms.h>
 
-#include <pango/pango-font.h>
-#include <pango/pango-utils.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#include <algorithm>
 #include <utility>
 #if M_BOOST_GET_VERSION() >= M_GET_VERSION(1, 36, 0)
 	#include <boost/unordered_map.hpp>
@@ -35,20 +37,38 @@
 	#include <map>
 #endif
 
+#include <boost/scoped_ptr.hpp>
+
 #include <glibmm/main.h>
 
+#include <gtkmm/adjustment.h>
 #include <gtkmm/box.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/frame.h>
+#include <gtkmm/liststore.h>
 #include <gtkmm/main.h>
+#include <gtkmm/scrollbar.h>
 #include <gtkmm/scrolledwindow.h>
-#include <gtkmm/textview.h>
+#include <gtkmm/treeview.h>
 
 #include <mlib/gtk/window_settings.hpp>
 #include <mlib/fs.hpp>
 #include <mlib/misc.hpp>
 
+#include "cue_scheduler.hpp"
+#include "latency_stats.hpp"
 #include "main_window.hpp"
+#include "mirror_server.hpp"
 #include "mplayer.hpp"
+#include "playlist.hpp"
+#include "search_index.hpp"
+#include "seek_keys.hpp"
+#include "startup_report.hpp"
+#include "state_publisher.hpp"
 #include "subtitles.hpp"
+#include "subtitles_view.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
 
 
 
@@ -117,56 +137,119 @@ namespace
 		{ GDK_KP_0			,	"\x1b\x5b\x32\x7e"		},
 		{ 0					,	NULL					}
 	};
-}
 
+	/// Если после предсказанной перемотки позиция, о которой сообщает
+	/// MPlayer, отличается от той, которая была бы без перемотки, больше чем
+	/// на это значение, то считается, что MPlayer выполнил перемотку.
+	const Time_ms SEEK_DETECTION_THRESHOLD = 2000;
 
+	/// Время, в течение которого ожидается выполнение MPlayer'ом
+	/// предсказанной перемотки.
+	const Time_us SEEK_PREDICTION_TIMEOUT = 5 * 1000 * 1000;
 
-class Subtitles_control: public Gtk::ScrolledWindow
-{
-	private:
-		struct Subtitle
-		{
-			Subtitle(Time_ms time, Glib::RefPtr<Gtk::TextMark> mark);
+	/// Ширина окна по умолчанию в расчете на одну дорожку субтитров.
+	const int TRACK_WIDTH = 400;
+
+	/// Высота окна по умолчанию.
+	const int WINDOW_HEIGHT = 200;
+
+	/// Минимальный интервал между обновлениями дорожек субтитров
+	/// (один кадр при частоте обновления экрана 60 Гц).
+	const Time_us FRAME_INTERVAL = 1000000 / 60;
+
+	/// Приоритет обновления дорожек субтитров: после обработки всех
+	/// поступивших от MPlayer'а данных, но до перерисовки окна, чтобы
+	/// изменения попали в тот же кадр.
+	const int FRAME_PRIORITY = GDK_PRIORITY_REDRAW - 10;
+
+	/// Высота списка результатов поиска.
+	const int SEARCH_RESULTS_HEIGHT = 120;
+
+
+	/// Форматирует время в виде "ч:мм:сс".
+	std::string	format_time(Time_ms time);
 
-			Time_ms						time;
-			Glib::RefPtr<Gtk::TextMark>	mark;
-		};
 
 
+	std::string format_time(Time_ms time)
+	{
+		char buf[32];
+
+		snprintf(buf, sizeof buf, "%d:%02d:%02d",
+			int(time / 3600000), int(time / 60000 % 60), int(time / 1000 % 60));
+
+		return buf;
+	}
+}
+
+
+
+class Subtitles_control: public Gtk::Frame
+{
 	public:
 		Subtitles_control(const Subtitles& subtitles);
 
 
 	private:
-		Gtk::TextView*					text_view;
-		Glib::RefPtr<Gtk::TextBuffer>	buffer;
+		/// Прокрутка списка субтитров.
+		Gtk::Adjustment					adjustment;
 
-		/// Тэг, определяющий параметры отображения субтитров, проигрываемых в
-		/// данный момент.
-		Glib::RefPtr<Gtk::TextTag>		tag_current;
+		/// Список субтитров.
+		Subtitles_view*					view;
 
 
-		/// "Субтитр", выделенный в данный момент в текстовом буфере.
-		size_t							cur_id;
+		/// Субтитры дорожки.
+		const Subtitles&				subtitles;
 
-		/// Список указателей на субтитры в текстовом буфере.
-		std::vector<Subtitle>			subtitles;
+		/// Субтитр, выделенный в данный момент.
+		size_t							cur_id;
 
 
 	public:
-		/// Делает активным субтитр, соответствующий времени offset.
-		void			scroll_to(Time_ms time);
+		/// Если список субтитров имеет фокус ввода, то копирует в буфер
+		/// обмена выделенный в нем пользователем субтитр.
+		/// @return - true, если субтитр был скопирован.
+		bool			copy_selection(void);
 
-	private:
-		/// Возвращает итератор для субтитра id.
-		Gtk::TextIter	get_iter_for(size_t id) const;
+		/// Возвращает субтитр, выделенный в данный момент.
+		size_t			get_current(void) const;
+
+		/// Делает активным субтитр, соответствующий времени time.
+		/// @param started_before, started_by - количество субтитров
+		/// дорожки, появившихся раньше и не позже time (см. Timeline).
+		/// @return - true, если активный субтитр изменился.
+		bool			scroll_to(Time_ms time, size_t started_before, size_t started_by);
 
+	private:
 		/// Задает текущий субтитр.
 		void			set_current(size_t id);
 };
 
 
 
+/// Столбцы списка результатов поиска.
+class Search_columns: public Gtk::TreeModel::ColumnRecord
+{
+	public:
+		Search_columns(void);
+
+
+	public:
+		/// Время появления субтитра.
+		Gtk::TreeModelColumn<Glib::ustring>	time;
+
+		/// Текст субтитра в одну строку.
+		Gtk::TreeModelColumn<Glib::ustring>	text;
+
+		/// Номер дорожки.
+		Gtk::TreeModelColumn<unsigned int>	track_id;
+
+		/// Номер субтитра в дорожке.
+		Gtk::TreeModelColumn<unsigned int>	cue_id;
+};
+
+
+
 struct Main_window::Private
 {
 	Private(void);
@@ -177,139 +260,207 @@ struct Main_window::Private
 	std::map<int, std::string>				key_values;
 #endif
 
+	/// Контейнер, в котором располагаются дорожки субтитров.
+	Gtk::HBox*								main_hbox;
+
+	/// Субтитры отображаемых дорожек.
+	std::vector<Subtitles>					subtitles;
+
 	std::vector<Subtitles_control*>			controls;
+
+	/// Общая временная шкала дорожек.
+	boost::scoped_ptr<Timeline>				timeline;
 	sigc::connection						time_offset_changed_connection;
 
-	Mplayer									mplayer;
+	/// Трансляция субтитров на другое устройство (если включена).
+	boost::scoped_ptr<Mirror_server>		mirror;
 
-	m::File_holder							nonblock_stdin;
-};
+	/// Публикация состояния воспроизведения в разделяемой памяти (если
+	/// включена).
+	boost::scoped_ptr<State_publisher>		state_publisher;
 
+	/// Полнотекстовый индекс по отображаемым дорожкам.
+	boost::scoped_ptr<Search_index>			search_index;
 
+	/// Панель поиска (скрыта, пока поиск не запрошен).
+	Gtk::VBox*								search_box;
 
-// Subtitles_control -->
-	Subtitles_control::Subtitle::Subtitle(Time_ms time, Glib::RefPtr<Gtk::TextMark> mark)
-	:
-		time(time), mark(mark)
-	{
-	}
+	/// Поле ввода поискового запроса.
+	Gtk::Entry*								search_entry;
+
+	/// Список результатов поиска.
+	Gtk::TreeView*							search_view;
+	Search_columns							search_columns;
+	Glib::RefPtr<Gtk::ListStore>			search_store;
+
+	/// Были ли уже созданы дорожки субтитров.
+	bool									tracks_attached;
+
+	/// Список проигрываемых файлов (если MPlayer проигрывает несколько
+	/// файлов).
+	boost::shared_ptr<Playlist>				playlist;
+
+	/// Номер проигрываемого файла в playlist.
+	size_t									playlist_pos;
+
+	/// Ожидается ли окончание загрузки субтитров файла playlist_pos.
+	bool									playlist_pending;
+
+	/// MPlayer, за которым мы наблюдаем.
+	boost::shared_ptr<Mplayer>				mplayer;
+
+	/// Планировщик команд MPlayer'у на границах субтитров первой дорожки.
+	boost::scoped_ptr<Cue_scheduler>		cue_scheduler;
+
+	/// Записывать ли задержки выделения субтитров.
+	bool									record_latencies;
 
+	/// Ожидается ли выполнение MPlayer'ом предсказанной перемотки.
+	bool									seek_predicted;
 
+	/// Позиция, в которую должна привести перемотка.
+	Time_ms									predicted_offset;
 
+	/// Является ли предсказанная перемотка перемоткой в абсолютную позицию.
+	bool									predicted_absolute;
+
+	/// Последнее состояние воспроизведения, полученное от MPlayer'а до
+	/// перемотки.
+	Playback_state							pre_seek_state;
+
+	/// Время предсказания перемотки.
+	Time_us									prediction_time;
+
+	/// Запланированное обновление дорожек субтитров.
+	sigc::connection						frame_connection;
+
+	/// Время последнего обновления дорожек субтитров.
+	Time_us									last_frame_time;
+
+	/// Позиция, в которую должно быть перемещено выделение в ближайшем
+	/// кадре.
+	Time_ms									frame_offset;
+
+	/// Получена ли frame_offset от MPlayer'а.
+	bool									frame_from_player;
+
+	/// Состояние воспроизведения, которому соответствует frame_offset
+	/// (если frame_from_player).
+	Playback_state							frame_state;
+
+	/// Задержки от вывода плеером строки состояния до выделения
+	/// соответствующего ей субтитра.
+	std::vector<Time_us>					highlight_latencies;
+
+	m::File_holder							nonblock_stdin;
+};
+
+
+
+// Subtitles_control -->
 	Subtitles_control::Subtitles_control(const Subtitles& subtitles)
 	:
+		adjustment(0, 0, 0),
+		subtitles(subtitles),
 		cur_id(0)
 	{
-		this->set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
 		this->set_shadow_type(Gtk::SHADOW_IN);
 
-		this->text_view = Gtk::manage( new Gtk::TextView );
-		this->text_view->set_editable(false);
-		this->text_view->set_wrap_mode(Gtk::WRAP_WORD);
-		this->text_view->property_left_margin() = 3;
-		this->add(*this->text_view);
+		Gtk::HBox* hbox = Gtk::manage( new Gtk::HBox );
+		this->add(*hbox);
 
-		this->buffer = this->text_view->get_buffer();
+		this->view = Gtk::manage( new Subtitles_view(subtitles, this->adjustment) );
+		hbox->pack_start(*this->view, true, true);
+
+		hbox->pack_start(*Gtk::manage( new Gtk::VScrollbar(this->adjustment) ), false, false);
+	}
 
-		this->tag_current = this->buffer->create_tag();
-		this->tag_current->property_scale() = PANGO_SCALE_X_LARGE;
-	#if PANGO_VERSION_CHECK(1, 24, 0)
-		this->tag_current->property_weight() = PANGO_WEIGHT_MEDIUM;
-	#else
-		this->tag_current->property_weight() = (PANGO_WEIGHT_NORMAL + PANGO_WEIGHT_SEMIBOLD) / 2;
-	#endif
 
-		bool first = true;
-		M_FOR_CONST_IT(subtitles.get(), it)
-		{
-			Glib::RefPtr<Gtk::TextMark> mark = this->buffer->create_mark(this->buffer->end());
-			this->buffer->insert(
-				this->buffer->end(),
-				first ? it->text : "\n" + it->text
-			);
-			this->subtitles.push_back( Subtitle(it->time, mark) );
-
-			first = false;
-		}
 
-		this->set_current(this->cur_id);
+	bool Subtitles_control::copy_selection(void)
+	{
+		return this->view->has_focus() && this->view->copy_selection();
 	}
 
 
 
-	Gtk::TextIter Subtitles_control::get_iter_for(size_t id) const
+	size_t Subtitles_control::get_current(void) const
 	{
-		if(id >= this->subtitles.size())
-			return this->buffer->end();
-		else
-			return this->buffer->get_iter_at_mark(this->subtitles[id].mark);
+		return this->cur_id;
 	}
 
 
 
-	void Subtitles_control::scroll_to(Time_ms time)
+	bool Subtitles_control::scroll_to(Time_ms time, size_t started_before, size_t started_by)
 	{
+		const Subtitles::Storage& subtitles = this->subtitles.get();
 		size_t id = this->cur_id;
 
-		if(this->subtitles[id].time < time)
-		{
-			size_t size = subtitles.size();
+		if(id >= subtitles.size())
+			return false;
 
-			while(++id != size)
-				if(this->subtitles[id].time > time)
-					break;
-			id--;
-		}
+		// При движении вперед активным становится последний начавшийся
+		// субтитр, а при движении назад - первый, начинающийся не раньше
+		// time.
+		if(subtitles[id].time < time)
+			id = started_by - 1;
 		else
-		{
-			while(--id != static_cast<size_t>(-1))
-				if(this->subtitles[id].time < time)
-					break;
-			id++;
-		}
+			id = started_before;
+
+		if(id == this->cur_id)
+			return false;
 
-		if(id != this->cur_id)
-			this->set_current(id);
+		this->set_current(id);
+		return true;
 	}
 
 
 
 	void Subtitles_control::set_current(size_t id)
 	{
-		// Снимаем выделение с текущего субтитра
-		this->buffer->remove_all_tags(
-			this->get_iter_for(this->cur_id),
-			this->get_iter_for(this->cur_id + 1)
-		);
+		TRACE_SPAN("set_current");
+
+		Time_us start_time = m::get_monotonic_time();
 
-		// Изменяем текущий субтитр
 		this->cur_id = id;
+		this->view->set_current(id);
 
-		Gtk::TextIter next_subtitle_it = this->get_iter_for(this->cur_id + 1);
-
-		// Выделяем текущий субтитр
-		this->buffer->apply_tag(
-			this->tag_current,
-			this->get_iter_for(this->cur_id),
-			next_subtitle_it
-		);
-
-		// Прокручиваем TextView так, чтобы текущий субтитр находился внизу
-		// экрана.
-		// -->
-			// Почему-то одного раза GTK не достаточно - текст прокручивается,
-			// но только частично, не останавливаясь в точности там, где
-			// требуется. Судя по тестам, двух раз всегда бывает достаточно.
-			for(size_t i = 0; i < 2; i++)
-				this->text_view->scroll_to(next_subtitle_it, 0, 1, 1);
-		// <--
+		record_latency(LATENCY_SET_CURRENT, m::get_monotonic_time() - start_time);
 	}
 // Subtitles_control <--
 
 
 
+// Search_columns -->
+	Search_columns::Search_columns(void)
+	{
+		this->add(this->time);
+		this->add(this->text);
+		this->add(this->track_id);
+		this->add(this->cue_id);
+	}
+// Search_columns <--
+
+
+
 // Private -->
 	Main_window::Private::Private(void)
+	:
+		main_hbox(NULL),
+		search_box(NULL),
+		search_entry(NULL),
+		search_view(NULL),
+		tracks_attached(false),
+		playlist_pos(0),
+		playlist_pending(false),
+		record_latencies(false),
+		seek_predicted(false),
+		predicted_offset(0),
+		predicted_absolute(false),
+		prediction_time(0),
+		last_frame_time(0),
+		frame_offset(0),
+		frame_from_player(false)
 	{
 		// Создаем индекс по клавишам -->
 		{
@@ -329,25 +480,101 @@ struct Main_window::Private
 
 
 // Main_window -->
-	Main_window::Main_window(const std::vector<Subtitles>& subtitles, const std::vector<std::string>& mplayer_args)
+	Main_window::Main_window(
+		const std::vector<Subtitles>& subtitles, const boost::shared_ptr<Mplayer>& mplayer,
+		const boost::shared_ptr<Playlist>& playlist
+	)
 	:
-		m::gtk::Window(APP_NAME, m::gtk::Window_settings(), 400 * subtitles.size(), 200, 2),
+		m::gtk::Window(APP_NAME, m::gtk::Window_settings(),
+			TRACK_WIDTH * std::max<size_t>(1, subtitles.size()), WINDOW_HEIGHT, 2),
 		priv( new Private )
 	{
-		Gtk::HBox* main_hbox = Gtk::manage( new Gtk::HBox(false, 3) );
-		this->add(*main_hbox);
+		priv->mplayer = mplayer;
 
-		M_FOR_CONST_IT(subtitles, it)
+		Gtk::VBox* main_vbox = Gtk::manage( new Gtk::VBox(false, 3) );
+		this->add(*main_vbox);
+
+		priv->main_hbox = Gtk::manage( new Gtk::HBox(false, 3) );
+		main_vbox->pack_start(*priv->main_hbox, true, true);
+
+		// Создаем панель поиска -->
 		{
-			Subtitles_control* control = Gtk::manage( new Subtitles_control(*it) );
-			main_hbox->pack_start(*control, true, true);
-			priv->controls.push_back(control);
+			priv->search_box = Gtk::manage( new Gtk::VBox(false, 3) );
+			priv->search_box->set_no_show_all();
+			main_vbox->pack_start(*priv->search_box, false, false);
+
+			priv->search_entry = Gtk::manage( new Gtk::Entry );
+			priv->search_entry->signal_changed().connect(
+				sigc::mem_fun(*this, &Main_window::on_search_changed_cb));
+			priv->search_entry->signal_activate().connect(
+				sigc::mem_fun(*this, &Main_window::on_search_activate_cb));
+			priv->search_box->pack_start(*priv->search_entry, false, false);
+
+			Gtk::ScrolledWindow* scrolled_window = Gtk::manage( new Gtk::ScrolledWindow );
+			scrolled_window->set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+			scrolled_window->set_shadow_type(Gtk::SHADOW_IN);
+			scrolled_window->set_size_request(-1, SEARCH_RESULTS_HEIGHT);
+			priv->search_box->pack_start(*scrolled_window, true, true);
+
+			priv->search_store = Gtk::ListStore::create(priv->search_columns);
+
+			priv->search_view = Gtk::manage( new Gtk::TreeView(priv->search_store) );
+			priv->search_view->set_headers_visible(false);
+			priv->search_view->set_enable_search(false);
+			priv->search_view->append_column("", priv->search_columns.time);
+			priv->search_view->append_column("", priv->search_columns.text);
+			priv->search_view->signal_row_activated().connect(
+				sigc::mem_fun(*this, &Main_window::on_search_row_activated_cb));
+			scrolled_window->add(*priv->search_view);
+
+			priv->search_entry->show();
+			priv->search_view->show();
+			scrolled_window->show();
+		}
+		// Создаем панель поиска <--
+
+		if(const char* address = getenv(MIRROR_ENV_NAME))
+		{
+			try
+			{
+				priv->mirror.reset(new Mirror_server(address));
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_SW(__("Unable to start the subtitle mirror: %1.", EE(e)));
+			}
 		}
 
-		priv->time_offset_changed_connection =
-			priv->mplayer.connect_time_offset_changed_handler(
-				sigc::mem_fun(*this, &Main_window::on_time_offset_changed_cb)
-			);
+		if(const char* name = getenv(SHM_ENV_NAME))
+		{
+			try
+			{
+				priv->state_publisher.reset(new State_publisher(name));
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_SW(__("Unable to publish the playback state: %1.", EE(e)));
+			}
+		}
+
+		if(!subtitles.empty())
+		{
+			std::vector<Subtitles> tracks(subtitles);
+			this->set_subtitles(tracks);
+		}
+
+		if(playlist)
+		{
+			priv->playlist = playlist;
+
+			priv->mplayer->connect_file_changed_handler(
+				sigc::mem_fun(*this, &Main_window::on_file_changed_cb));
+
+			playlist->connect_loaded_handler(
+				sigc::mem_fun(*this, &Main_window::on_playlist_loaded_cb));
+
+			playlist->set_current(0);
+		}
 
 		this->add_events(Gdk::KEY_PRESS_MASK);
 		this->signal_key_press_event().connect(
@@ -356,18 +583,9 @@ struct Main_window::Private
 		this->signal_delete_event().connect(
 			sigc::mem_fun(*this, &Main_window::on_delete_cb));
 
-		priv->mplayer.connect_quit_handler(
+		priv->mplayer->connect_quit_handler(
 			sigc::mem_fun(*this, &Main_window::on_player_closed_cb));
 
-		try
-		{
-			priv->mplayer.start(mplayer_args);
-		}
-		catch(m::Exception& e)
-		{
-			MLIB_W(EE(e));
-		}
-
 		// Прослушиваем стандартный ввод -->
 		{
 			int fd;
@@ -408,19 +626,140 @@ struct Main_window::Private
 
 
 
+	void Main_window::hide_search(void)
+	{
+		priv->search_box->hide();
+	}
+
+
+
 	bool Main_window::on_delete_cb(GdkEventAny* event)
 	{
 		priv->time_offset_changed_connection.disconnect();
+		priv->frame_connection.disconnect();
 		this->hide();
 		return false;
 	}
 
 
 
+	void Main_window::enable_latency_recording(void)
+	{
+		priv->record_latencies = true;
+	}
+
+
+
+	const std::vector<Time_us>& Main_window::get_highlight_latencies(void) const
+	{
+		return priv->highlight_latencies;
+	}
+
+
+
+	void Main_window::on_file_changed_cb(void)
+	{
+		std::string file_path = priv->mplayer->get_playing_file();
+		size_t id = priv->playlist->find(file_path, priv->playlist_pos + 1);
+
+		if(id >= priv->playlist->size())
+		{
+			MLIB_D(_C("MPlayer plays '%1' which is not in the playlist.", file_path));
+			return;
+		}
+
+		if(id == priv->playlist_pos)
+			return;
+
+		Time_us start_time = m::get_monotonic_time();
+		std::vector<Subtitles> subtitles;
+
+		priv->playlist_pos = id;
+		priv->playlist->set_current(id);
+
+		// Если субтитры еще не загружены, то до окончания их загрузки
+		// дорожки предыдущего файла убираются.
+		priv->playlist_pending = !priv->playlist->get_subtitles(id, &subtitles);
+		this->set_subtitles(subtitles);
+
+		MLIB_D(_C("Switched to '%1' in %2 us.", file_path, m::get_monotonic_time() - start_time));
+	}
+
+
+
 	bool Main_window::on_key_press_event_cb(const GdkEventKey* event)
 	{
 		std::string string;
 
+		// Поиск -->
+			if(event->state & GDK_CONTROL_MASK && gdk_keyval_to_lower(event->keyval) == GDK_f)
+			{
+				this->show_search();
+				return true;
+			}
+
+			if(priv->search_box->is_visible())
+			{
+				switch(event->keyval)
+				{
+					case GDK_Escape:
+						this->hide_search();
+						return true;
+
+					case GDK_Down:
+						if(priv->search_entry->has_focus())
+						{
+							priv->search_view->grab_focus();
+							return true;
+						}
+						break;
+
+					default:
+						break;
+				}
+
+				// Остальные клавиши обрабатываются полем ввода и списком
+				// результатов, а не передаются MPlayer'у.
+				return false;
+			}
+		// Поиск <--
+
+		// Копирование субтитра, выделенного пользователем -->
+			if(event->state & GDK_CONTROL_MASK && gdk_keyval_to_lower(event->keyval) == GDK_c)
+			{
+				M_FOR_CONST_IT(priv->controls, it)
+					if((*it)->copy_selection())
+						return true;
+			}
+		// Копирование субтитра, выделенного пользователем <--
+
+		// Команды режима изучения языка -->
+			if(priv->cue_scheduler && event->state & GDK_CONTROL_MASK)
+			{
+				switch(gdk_keyval_to_lower(event->keyval))
+				{
+					case GDK_p:
+						priv->cue_scheduler->set_pause_after_cue(
+							!priv->cue_scheduler->get_pause_after_cue());
+						return true;
+
+					case GDK_r:
+						try
+						{
+							priv->cue_scheduler->replay_current_cue();
+						}
+						catch(m::Exception& e)
+						{
+							MLIB_SW(__("Unable to replay the current subtitle: %1.", EE(e)));
+						}
+						return true;
+
+					default:
+						break;
+				}
+			}
+		// Команды режима изучения языка <--
+
 		// Получаем последовательность байт, представляющих нажатую клавишу -->
 		{
 			M_CONST_ITER_TYPE(priv->key_values) key_it = priv->key_values.find(event->keyval);
@@ -441,7 +780,8 @@ struct Main_window::Private
 		{
 			try
 			{
-				priv->mplayer.write_to_stdio(string.data(), string.size());
+				if(priv->mplayer->write_to_stdio(string.data(), string.size()))
+					this->predict_seek(string);
 			}
 			catch(m::Exception& e)
 			{
@@ -457,11 +797,36 @@ struct Main_window::Private
 	void Main_window::on_player_closed_cb(void)
 	{
 		MLIB_D("Player closed.");
+
+	#ifdef DEBUG_MODE
+		{
+			Stdin_stats stats = priv->mplayer->get_stdin_stats();
+
+			MLIB_D(_C("MPlayer's stdin queue: max depth %1, coalesced commands %2.",
+				stats.max_queue_depth, stats.coalesced));
+			MLIB_D(_C("MPlayer's stdin write latency: last %1 us, max %2 us.",
+				stats.last_latency, stats.max_latency));
+		}
+	#endif
+
 		Gtk::Main::quit();
 	}
 
 
 
+	void Main_window::on_playlist_loaded_cb(void)
+	{
+		std::vector<Subtitles> subtitles;
+
+		if(priv->playlist_pending && priv->playlist->get_subtitles(priv->playlist_pos, &subtitles))
+		{
+			priv->playlist_pending = false;
+			this->set_subtitles(subtitles);
+		}
+	}
+
+
+
 	bool Main_window::on_stdin_data(Glib::IOCondition condition)
 	{
 		// Вполне достаточно, если учесть то, что пользователь просто нажимает
@@ -485,8 +850,8 @@ struct Main_window::Private
 
 		try
 		{
-			if(readed_bytes)
-				priv->mplayer.write_to_stdio(buf, readed_bytes);
+			if(readed_bytes && priv->mplayer->write_to_stdio(buf, readed_bytes))
+				this->predict_seek(std::string(buf, readed_bytes));
 		}
 		catch(m::Exception& e)
 		{
@@ -498,14 +863,408 @@ struct Main_window::Private
 
 
 
+	void Main_window::predict_seek(const std::string& keys)
+	{
+		Time_ms seek = 0;
+		Time_ms offset;
+		Time_us cur_time = m::get_monotonic_time();
+
+		// Ищем команды перемотки -->
+			for(size_t pos = 0; pos < keys.size(); )
+			{
+				const Seek_key* key = find_seek_key(keys, pos);
+
+				if(key)
+				{
+					seek += key->seek;
+					pos += strlen(key->value);
+				}
+				else
+					pos++;
+			}
+
+			if(!seek)
+				return;
+		// Ищем команды перемотки <--
+
+		// Вычисляем позицию, от которой будет выполнена перемотка -->
+			if(priv->seek_predicted)
+			{
+				// Предыдущая перемотка еще не выполнена - MPlayer выполнит
+				// эту вслед за ней.
+				offset = priv->predicted_offset;
+			}
+			else
+			{
+				priv->pre_seek_state = priv->mplayer->get_playback_state();
+				offset = priv->pre_seek_state.offset;
+
+				if(!priv->pre_seek_state.paused)
+					offset += (cur_time - priv->pre_seek_state.timestamp) / 1000;
+			}
+		// Вычисляем позицию, от которой будет выполнена перемотка <--
+
+		priv->seek_predicted = true;
+		priv->predicted_offset = std::max<Time_ms>(0, offset + seek);
+		priv->predicted_absolute = false;
+		priv->prediction_time = cur_time;
+
+		MLIB_D(_C("Predicting seek from %1 to %2.", offset, priv->predicted_offset));
+
+		this->request_frame(priv->predicted_offset);
+	}
+
+
+
+	void Main_window::set_subtitles(std::vector<Subtitles>& subtitles)
+	{
+		// Режим паузы после каждого субтитра сохраняется при смене файла
+		bool pause_after_cue = priv->cue_scheduler && priv->cue_scheduler->get_pause_after_cue();
+		bool had_scheduler = priv->cue_scheduler.get() != NULL;
+
+		// Удаляем старые дорожки -->
+			priv->cue_scheduler.reset();
+
+			M_FOR_IT(priv->controls, it)
+			{
+				priv->main_hbox->remove(**it);
+				delete *it;
+			}
+
+			priv->controls.clear();
+		// Удаляем старые дорожки <--
+
+		// Дорожки, индекс и результаты поиска ссылаются на эти субтитры
+		priv->timeline.reset();
+		priv->search_index.reset();
+		priv->search_store->clear();
+		priv->subtitles.clear();
+		priv->subtitles.swap(subtitles);
+
+		if(!priv->subtitles.empty())
+		{
+			priv->timeline.reset(new Timeline(priv->subtitles));
+
+			// Результаты поиска обновятся, когда индекс будет построен
+			priv->search_index.reset(new Search_index(priv->subtitles));
+			priv->search_index->connect_ready_handler(
+				sigc::mem_fun(*this, &Main_window::on_search_changed_cb));
+		}
+
+		// Создаем новые дорожки -->
+			M_FOR_CONST_IT(priv->subtitles, it)
+			{
+				Subtitles_control* control = Gtk::manage( new Subtitles_control(*it) );
+				priv->main_hbox->pack_start(*control, true, true);
+				priv->controls.push_back(control);
+			}
+
+			priv->main_hbox->show_all();
+		// Создаем новые дорожки <--
+
+		if(priv->mirror)
+			priv->mirror->set_tracks(priv->subtitles);
+
+		if(priv->state_publisher)
+		{
+			priv->state_publisher->tracks_changed();
+			this->publish_state(priv->mplayer->get_playback_state());
+		}
+
+		// Повтор субтитров выполняется командами MPlayer'у
+		if(!priv->subtitles.empty() && priv->mplayer->can_send_commands())
+		{
+			try
+			{
+				priv->cue_scheduler.reset(new Cue_scheduler(*priv->mplayer, priv->subtitles.front()));
+
+				if(had_scheduler)
+					priv->cue_scheduler->set_pause_after_cue(pause_after_cue);
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_SW(EE(e));
+			}
+		}
+
+		// Предсказанная перемотка относилась к предыдущему файлу
+		priv->seek_predicted = false;
+
+		// До появления дорожек изменения позиции не отслеживаются: последняя
+		// позиция хранится в Mplayer'е и применяется ниже.
+		if(!priv->tracks_attached)
+		{
+			priv->tracks_attached = true;
+
+			priv->time_offset_changed_connection =
+				priv->mplayer->connect_time_offset_changed_handler(
+					sigc::mem_fun(*this, &Main_window::on_time_offset_changed_cb)
+				);
+
+			if(priv->subtitles.size() > 1)
+				this->resize(TRACK_WIDTH * priv->subtitles.size(), WINDOW_HEIGHT);
+		}
+
+		this->scroll_tracks_to(priv->mplayer->get_current_offset());
+	}
+
+
+
+	bool Main_window::scroll_tracks_to(Time_ms offset)
+	{
+		const size_t* started_before;
+		const size_t* started_by;
+		bool changed = false;
+
+		if(!priv->timeline)
+			return false;
+
+		priv->timeline->find(offset, &started_before, &started_by);
+
+		for(size_t track_id = 0; track_id < priv->controls.size(); track_id++)
+		{
+			Subtitles_control* control = priv->controls[track_id];
+
+			if(control->scroll_to(offset, started_before[track_id], started_by[track_id]))
+			{
+				changed = true;
+
+				if(priv->mirror)
+					priv->mirror->set_current(track_id, control->get_current());
+			}
+		}
+
+		return changed;
+	}
+
+
+
+	void Main_window::on_search_activate_cb(void)
+	{
+		Gtk::TreeModel::iterator it = priv->search_view->get_selection()->get_selected();
+
+		if(!it)
+		{
+			it = priv->search_store->children().begin();
+
+			if(it == priv->search_store->children().end())
+				return;
+		}
+
+		this->seek_to_search_result(*it);
+	}
+
+
+
+	void Main_window::on_search_changed_cb(void)
+	{
+		std::vector<Search_result> results;
+
+		if(!priv->search_index || !priv->search_index->search(priv->search_entry->get_text(), &results))
+			return;
+
+		// Отключаем модель от списка на время заполнения, чтобы он не
+		// обрабатывал каждую добавленную строку.
+		priv->search_view->unset_model();
+		priv->search_store->clear();
+
+		M_FOR_CONST_IT(results, it)
+		{
+			const Subtitles::Subtitle& cue = priv->subtitles[it->track_id].get()[it->cue_id];
+			Gtk::TreeModel::Row row = *priv->search_store->append();
+
+			std::string text = cue.text;
+			std::replace(text.begin(), text.end(), '\n', ' ');
+
+			row[priv->search_columns.time] = format_time(cue.time);
+			row[priv->search_columns.text] = text;
+			row[priv->search_columns.track_id] = it->track_id;
+			row[priv->search_columns.cue_id] = it->cue_id;
+		}
+
+		priv->search_view->set_model(priv->search_store);
+	}
+
+
+
+	void Main_window::on_search_row_activated_cb(const Gtk::TreeModel::Path& path, Gtk::TreeViewColumn* column)
+	{
+		this->seek_to_search_result(*priv->search_store->get_iter(path));
+	}
+
+
+
 	void Main_window::on_time_offset_changed_cb(void)
 	{
 		MLIB_D("Current time offset has been changed.");
+		TRACE_SPAN("on_time_offset_changed");
+
+		Time_us handler_time = m::get_monotonic_time();
+		Playback_state state = priv->mplayer->get_playback_state();
+
+		record_latency(LATENCY_HANDLER, handler_time - priv->mplayer->get_notification_time());
+
+		if(priv->cue_scheduler)
+			priv->cue_scheduler->update();
+
+		if(priv->state_publisher)
+			this->publish_state(state);
+
+		// Сверяем предсказанную перемотку с реальной позицией -->
+			if(priv->seek_predicted)
+			{
+				const Playback_state& pre_seek_state = priv->pre_seek_state;
+
+				// Позиция, в которой MPlayer был бы, если бы не выполнял
+				// перемотку.
+				Time_ms unseeked_offset = pre_seek_state.offset;
+				if(!pre_seek_state.paused)
+					unseeked_offset += (state.timestamp - pre_seek_state.timestamp) / 1000;
+
+				// MPlayer еще не выполнил перемотку - оставляем выделение в
+				// предсказанной позиции. Перемотку в абсолютную позицию,
+				// близкую к текущей, по отличию от позиции без перемотки
+				// обнаружить нельзя, поэтому она считается выполненной, как
+				// только MPlayer оказывается рядом с предсказанной позицией.
+				if(
+					llabs(state.offset - unseeked_offset) < SEEK_DETECTION_THRESHOLD &&
+					!(
+						priv->predicted_absolute &&
+						llabs(state.offset - priv->predicted_offset) < SEEK_DETECTION_THRESHOLD
+					) &&
+					handler_time - priv->prediction_time < SEEK_PREDICTION_TIMEOUT
+				)
+					return;
+
+				MLIB_D(_C("Predicted seek to %1, MPlayer has seeked to %2.", priv->predicted_offset, state.offset));
+				priv->seek_predicted = false;
+			}
+		// Сверяем предсказанную перемотку с реальной позицией <--
+
+		this->request_frame(state.offset, &state);
+	}
+
+
+
+	bool Main_window::on_frame_cb(void)
+	{
+		TRACE_SPAN("frame");
+
+		Time_us start_time = m::get_monotonic_time();
+
+		priv->last_frame_time = start_time;
+		bool changed = this->scroll_tracks_to(priv->frame_offset);
+
+		Time_us done_time = m::get_monotonic_time();
+		record_latency(LATENCY_SCROLL, done_time - start_time);
+
+		if(changed && priv->frame_from_player)
+		{
+			const Playback_state& state = priv->frame_state;
+
+			startup_finished();
+			record_latency(LATENCY_TOTAL, done_time - state.received);
+
+			if(priv->record_latencies)
+				priv->highlight_latencies.push_back(done_time - state.emitted);
+		}
 
-		Time_ms time = priv->mplayer.get_current_offset();
+		return false;
+	}
+
+
+
+	void Main_window::publish_state(const Playback_state& state)
+	{
+		const size_t* started_before;
+		const size_t* started_by = NULL;
+
+		if(priv->timeline)
+			priv->timeline->find(state.offset, &started_before, &started_by);
+
+		priv->state_publisher->publish(state, started_by, started_by ? priv->subtitles.size() : 0);
+	}
+
+
+
+	void Main_window::request_frame(Time_ms offset, const Playback_state* state)
+	{
+		priv->frame_offset = offset;
+		priv->frame_from_player = state != NULL;
+		if(state)
+			priv->frame_state = *state;
+
+		if(priv->frame_connection.connected())
+			return;
+
+		// Если с предыдущего обновления кадр еще не прошел, то откладываем
+		// обновление до его окончания, иначе - выполняем его, как только
+		// будут обработаны все поступившие данные.
+		Time_us elapsed = m::get_monotonic_time() - priv->last_frame_time;
+
+		if(elapsed >= FRAME_INTERVAL)
+		{
+			priv->frame_connection = Glib::signal_idle().connect(
+				sigc::mem_fun(*this, &Main_window::on_frame_cb), FRAME_PRIORITY);
+		}
+		else
+		{
+			priv->frame_connection = Glib::signal_timeout().connect(
+				sigc::mem_fun(*this, &Main_window::on_frame_cb),
+				(FRAME_INTERVAL - elapsed + 999) / 1000, FRAME_PRIORITY);
+		}
+	}
 
-		M_FOR_IT(priv->controls, it)
-			(*it)->scroll_to(time);
+
+
+	void Main_window::seek_to_search_result(const Gtk::TreeModel::Row& row)
+	{
+		// Пользователь уже был предупрежден о том, почему MPlayer'у нельзя
+		// отправлять команды.
+		if(!priv->mplayer->can_send_commands())
+			return;
+
+		size_t track_id = row[priv->search_columns.track_id];
+		size_t cue_id = row[priv->search_columns.cue_id];
+		Time_ms offset = priv->subtitles[track_id].get()[cue_id].time;
+
+		// Форматируем позицию без использования чисел с плавающей точкой, т. к.
+		// их формат зависит от текущей локали, а MPlayer ожидает точку.
+		char command[64];
+		snprintf(command, sizeof command, "seek %lld.%03lld 2",
+			static_cast<long long>(offset / 1000), static_cast<long long>(offset % 1000));
+
+		MLIB_D(_C("Seeking to subtitle %1 of track %2 at %3.", cue_id, track_id, offset));
+
+		try
+		{
+			priv->mplayer->send_command(command);
+		}
+		catch(m::Exception& e)
+		{
+			MLIB_SW(__("Unable to seek to the subtitle: %1.", EE(e)));
+			return;
+		}
+
+		// Перемещаем выделение, не дожидаясь, пока MPlayer выполнит
+		// перемотку (см. predict_seek()).
+		if(!priv->seek_predicted)
+			priv->pre_seek_state = priv->mplayer->get_playback_state();
+
+		priv->seek_predicted = true;
+		priv->predicted_offset = offset;
+		priv->predicted_absolute = true;
+		priv->prediction_time = m::get_monotonic_time();
+
+		this->request_frame(offset);
+	}
+
+
+
+	void Main_window::show_search(void)
+	{
+		priv->search_box->show();
+		priv->search_entry->grab_focus();
 	}
 // Main_window <--
 
@@ -22,14 +22,22 @@
 #ifndef HEADER_MAIN_WINDOW
 	#define HEADER_MAIN_WINDOW
 
+	#include <vector>
+
 	#include <boost/shared_ptr.hpp>
 
 	#include <glibmm/main.h>
 
+	#include <gtkmm/treemodel.h>
+	#include <gtkmm/treeviewcolumn.h>
+
 	#include <mlib/gtk/window.hpp>
 
 
+	class Mplayer;
+	class Playlist;
 	class Subtitles;
+	struct Playback_state;
 
 	class Main_window: public m::gtk::Window
 	{
@@ -38,9 +46,14 @@
 
 
 		public:
+			/// @param mplayer - уже запущенный MPlayer.
+			/// @param playlist - список проигрываемых файлов (если MPlayer
+			/// проигрывает несколько файлов), subtitles - субтитры первого
+			/// из них.
 			Main_window(
 				const std::vector<Subtitles>& subtitles,
-				const std::vector<std::string>& mplayer_args
+				const boost::shared_ptr<Mplayer>& mplayer,
+				const boost::shared_ptr<Playlist>& playlist = boost::shared_ptr<Playlist>()
 			);
 
 
@@ -48,22 +61,96 @@
 			boost::shared_ptr<Private>	priv;
 
 
+		public:
+			/// Включает запись задержек от вывода плеером строки состояния до
+			/// выделения соответствующего ей субтитра (используется встроенным
+			/// тестом производительности).
+			void						enable_latency_recording(void);
+
+			/// Возвращает записанные задержки.
+			const std::vector<Time_us>&	get_highlight_latencies(void) const;
+
+			/// Заменяет отображаемые дорожки субтитров. До первого вызова
+			/// изменения позиции не отслеживаются (окно может быть создано
+			/// до окончания загрузки субтитров).
+			///
+			/// Субтитры не копируются: содержимое subtitles забирается
+			/// окном, а сам вектор остается пустым.
+			void						set_subtitles(std::vector<Subtitles>& subtitles);
+
 		private:
+			/// Скрывает панель поиска.
+			void	hide_search(void);
+
 			/// Обработчик сигнала на закрытие окна.
 			bool	on_delete_cb(GdkEventAny* event);
 
+			/// Выполняется не чаще одного раза за кадр при наличии изменений
+			/// и перемещает выделение субтитров в последнюю запрошенную
+			/// позицию.
+			bool	on_frame_cb(void);
+
+			/// Обработчик сигнала на начало воспроизведения MPlayer'ом
+			/// очередного файла.
+			void	on_file_changed_cb(void);
+
 			/// Обработчик сигнала на нажатие кнопки на клавиатуре.
 			bool	on_key_press_event_cb(const GdkEventKey* event);
 
 			/// Обработчик сигнала на закрытие плеера.
 			void	on_player_closed_cb(void);
 
+			/// Обработчик сигнала на окончание загрузки субтитров очередного
+			/// файла playlist'а.
+			void	on_playlist_loaded_cb(void);
+
+			/// Обработчик нажатия Enter в поле поиска - переходит к
+			/// выбранному (или первому) результату.
+			void	on_search_activate_cb(void);
+
+			/// Обработчик изменения текста поиска и окончания построения
+			/// поискового индекса - обновляет список результатов.
+			void	on_search_changed_cb(void);
+
+			/// Обработчик активации результата поиска.
+			void	on_search_row_activated_cb(const Gtk::TreeModel::Path& path, Gtk::TreeViewColumn* column);
+
 			/// Обработчик сигнала на поступление данных в stdin.
 			bool	on_stdin_data(Glib::IOCondition condition);
 
 			/// Обработчик сигнала на изменение текущей позиции в проигрываемом
 			/// файле.
 			void	on_time_offset_changed_cb(void);
+
+			/// Если keys, переданные MPlayer'у, содержат команды перемотки, то
+			/// сразу же перемещает выделение субтитров в позицию, которая
+			/// должна получиться после перемотки, не дожидаясь, пока о ней
+			/// сообщит MPlayer.
+			void	predict_seek(const std::string& keys);
+
+			/// Публикует состояние воспроизведения state в разделяемой
+			/// памяти.
+			void	publish_state(const Playback_state& state);
+
+			/// Запрашивает перемещение выделения субтитров в позицию offset
+			/// в ближайшем кадре. Если запросов за кадр было несколько, то
+			/// выполняется только последний.
+			/// @param state - состояние воспроизведения, полученное от
+			/// MPlayer'а (для записи задержек), или NULL.
+			void	request_frame(Time_ms offset, const Playback_state* state = NULL);
+
+			/// Перемещает выделение субтитров во всех дорожках в позицию
+			/// offset.
+			/// @return - true, если выделение изменилось хотя бы в одной
+			/// дорожке.
+			bool	scroll_tracks_to(Time_ms offset);
+
+			/// Перематывает MPlayer к субтитру, соответствующему результату
+			/// поиска row, и сразу же перемещает в него выделение.
+			void	seek_to_search_result(const Gtk::TreeModel::Row& row);
+
+			/// Показывает панель поиска и переводит фокус в поле ввода.
+			void	show_search(void);
 	};
 
 #endif
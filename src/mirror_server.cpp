@@ -0,0 +1,849 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <sstream>
+
+#include <glib.h>
+
+#include <sigc++/adaptors/bind.h>
+#include <sigc++/functors/mem_fun.h>
+
+#include "mirror_server.hpp"
+#include "subtitles.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Строка, которая по протоколу WebSocket добавляется к ключу клиента
+	/// при вычислении ответного ключа.
+	const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+	/// Коды кадров WebSocket.
+	enum Websocket_opcode {
+		WEBSOCKET_TEXT	= 0x1,
+		WEBSOCKET_CLOSE	= 0x8,
+		WEBSOCKET_PING	= 0x9,
+		WEBSOCKET_PONG	= 0xa
+	};
+
+	/// Максимальный размер HTTP-запроса и кадра, принимаемого от клиента.
+	const size_t MAX_REQUEST_SIZE = 8 * 1024;
+
+	/// Максимальный объем данных, который может ожидать отправки клиенту
+	/// сверх текстов дорожек. Клиенты, не успевающие принимать данные,
+	/// отключаются.
+	const size_t MAX_OUTPUT_BACKLOG = 1024 * 1024;
+
+	/// Максимальное количество одновременных соединений.
+	const size_t MAX_CLIENTS = 32;
+
+	/// Страница, отображающая транслируемые субтитры.
+	const char INDEX_PAGE[] =
+		"<!DOCTYPE html>\n"
+		"<html><head><meta charset=\"utf-8\">\n"
+		"<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">\n"
+		"<title>" APP_NAME "</title>\n"
+		"<style>\n"
+		"body { margin: 0; display: flex; height: 100vh; font: 18px sans-serif; background: #111; color: #aaa; }\n"
+		".track { flex: 1; overflow-y: auto; padding: 0 6px; border-left: 1px solid #333; }\n"
+		".cue { padding: 3px 0; white-space: pre-wrap; }\n"
+		".current { background: #335; color: #fff; }\n"
+		"</style></head><body><script>\n"
+		"var tracks = [], current = [];\n"
+		"function highlight(t, id) {\n"
+		"	if(!tracks[t]) return;\n"
+		"	var cues = tracks[t].children;\n"
+		"	if(current[t] < cues.length) cues[current[t]].className = 'cue';\n"
+		"	current[t] = id;\n"
+		"	if(id < cues.length) { cues[id].className = 'cue current'; cues[id].scrollIntoView({ block: 'center' }); }\n"
+		"}\n"
+		"function connect() {\n"
+		"	var ws = new WebSocket('ws://' + location.host + '/ws');\n"
+		"	ws.onmessage = function(event) {\n"
+		"		var msg = JSON.parse(event.data), i;\n"
+		"		if(msg.tracks) {\n"
+		"			document.body.innerHTML = ''; tracks = []; current = [];\n"
+		"			msg.tracks.forEach(function(texts) {\n"
+		"				var track = document.createElement('div');\n"
+		"				track.className = 'track';\n"
+		"				texts.forEach(function(text) {\n"
+		"					var cue = document.createElement('div');\n"
+		"					cue.className = 'cue'; cue.textContent = text; track.appendChild(cue);\n"
+		"				});\n"
+		"				document.body.appendChild(track); tracks.push(track); current.push(texts.length);\n"
+		"			});\n"
+		"		}\n"
+		"		if(msg.current) for(i = 0; i < msg.current.length; i++) highlight(i, msg.current[i]);\n"
+		"		if(msg.d) for(i = 0; i + 1 < msg.d.length; i += 2) highlight(msg.d[i], msg.d[i + 1]);\n"
+		"	};\n"
+		"	ws.onclose = function() { setTimeout(connect, 1000); };\n"
+		"}\n"
+		"connect();\n"
+		"</script></body></html>\n";
+
+
+
+	/// Дописывает к json строку string в формате JSON.
+	void		append_json_string(std::string* json, const std::string& string);
+
+	/// Возвращает адрес (host[:port]) из значения заголовка Origin в
+	/// нижнем регистре.
+	std::string	get_origin_host(const std::string& origin);
+
+	/// Вычисляет ответный ключ WebSocket для ключа клиента key.
+	std::string	get_websocket_accept(const std::string& key);
+
+	/// Формирует HTTP-ответ.
+	std::string	make_http_response(const std::string& status, const std::string& content_type, const std::string& body);
+
+	/// Формирует кадр WebSocket.
+	std::string	make_websocket_frame(Websocket_opcode opcode, const std::string& payload);
+
+
+
+	void append_json_string(std::string* json, const std::string& string)
+	{
+		json->reserve(json->size() + string.size() + 2);
+		*json += '"';
+
+		for(size_t i = 0; i < string.size(); i++)
+		{
+			unsigned char c = string[i];
+
+			switch(c)
+			{
+				case '"':
+					*json += "\\\"";
+					break;
+
+				case '\\':
+					*json += "\\\\";
+					break;
+
+				case '\n':
+					*json += "\\n";
+					break;
+
+				default:
+					if(c < 0x20)
+					{
+						char buf[8];
+						snprintf(buf, sizeof buf, "\\u%04x", c);
+						*json += buf;
+					}
+					else
+						*json += c;
+					break;
+			}
+		}
+
+		*json += '"';
+	}
+
+
+
+	std::string get_origin_host(const std::string& origin)
+	{
+		size_t host_pos = origin.find("://");
+		host_pos = host_pos == std::string::npos ? 0 : host_pos + 3;
+
+		std::string host = origin.substr(host_pos, origin.find('/', host_pos) - host_pos);
+		std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+
+		return host;
+	}
+
+
+
+	std::string get_websocket_accept(const std::string& key)
+	{
+		std::string data = key + WEBSOCKET_GUID;
+		guint8 digest[20];
+		gsize digest_size = sizeof digest;
+
+		GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA1);
+		g_checksum_update(checksum, reinterpret_cast<const guchar*>(data.data()), data.size());
+		g_checksum_get_digest(checksum, digest, &digest_size);
+		g_checksum_free(checksum);
+
+		gchar* encoded = g_base64_encode(digest, digest_size);
+		std::string accept = encoded;
+		g_free(encoded);
+
+		return accept;
+	}
+
+
+
+	std::string make_http_response(const std::string& status, const std::string& content_type, const std::string& body)
+	{
+		std::ostringstream response;
+
+		response
+			<< "HTTP/1.1 " << status << "\r\n"
+			<< "Content-Type: " << content_type << "\r\n"
+			<< "Content-Length: " << body.size() << "\r\n"
+			<< "Cache-Control: no-cache\r\n"
+			<< "Connection: close\r\n"
+			<< "\r\n"
+			<< body;
+
+		return response.str();
+	}
+
+
+
+	std::string make_websocket_frame(Websocket_opcode opcode, const std::string& payload)
+	{
+		std::string frame;
+		size_t size = payload.size();
+
+		frame.reserve(size + 10);
+		frame += char(0x80 | opcode);
+
+		if(size < 126)
+			frame += char(size);
+		else if(size <= 0xffff)
+		{
+			frame += char(126);
+			frame += char(size >> 8);
+			frame += char(size);
+		}
+		else
+		{
+			frame += char(127);
+			for(int shift = 56; shift >= 0; shift -= 8)
+				frame += char(guint64(size) >> shift);
+		}
+
+		frame += payload;
+
+		return frame;
+	}
+}
+
+
+
+Mirror_server::Client::Client(int fd)
+:
+	fd(fd),
+	websocket(false),
+	closing(false)
+{
+}
+
+
+
+Mirror_server::Client::~Client(void)
+{
+	this->read_connection.disconnect();
+	this->write_connection.disconnect();
+}
+
+
+
+Mirror_server::Mirror_server(const std::string& address) throw(m::Exception)
+{
+	std::string host;
+	std::string port;
+
+	// Разбираем адрес -->
+	{
+		size_t colon_pos = address.rfind(':');
+
+		if(colon_pos == std::string::npos)
+			M_THROW(__("Invalid %1 value: '%2'.", MIRROR_ENV_NAME, address));
+
+		host = address.substr(0, colon_pos);
+		port = address.substr(colon_pos + 1);
+
+		if(host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']')
+			host = host.substr(1, host.size() - 2);
+
+		if(host.empty())
+			MLIB_SW(__("%1 has no host, so the mirror server is listening on all network interfaces.", MIRROR_ENV_NAME));
+	}
+	// Разбираем адрес <--
+
+	// Создаем слушающий сокет -->
+	{
+		struct addrinfo hints;
+		struct addrinfo* addresses;
+
+		memset(&hints, 0, sizeof hints);
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+
+		if(int error = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &addresses))
+			M_THROW(__("Invalid mirror address '%1': %2.", address, gai_strerror(error)));
+
+		int fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+		if(fd < 0)
+		{
+			int saved_errno = errno;
+			freeaddrinfo(addresses);
+			M_THROW(__("Can't create a socket: %1.", EE(saved_errno)));
+		}
+
+		this->listen_fd.set(fd);
+
+		int reuse = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+
+		int rval = bind(fd, addresses->ai_addr, addresses->ai_addrlen);
+		int saved_errno = errno;
+		freeaddrinfo(addresses);
+
+		if(rval)
+			M_THROW(__("Can't bind to '%1': %2.", address, EE(saved_errno)));
+
+		if(listen(fd, SOMAXCONN))
+			M_THROW(__("Can't listen on '%1': %2.", address, EE(errno)));
+	}
+	// Создаем слушающий сокет <--
+
+	this->accept_connection = Glib::signal_io().connect(
+		sigc::mem_fun(*this, &Mirror_server::on_accept_cb), this->listen_fd.get(), Glib::IO_IN);
+
+	MLIB_D(_C("Mirror server is listening on '%1' (port %2).", address, this->get_port()));
+}
+
+
+
+Mirror_server::~Mirror_server(void)
+{
+	this->accept_connection.disconnect();
+	this->flush_connection.disconnect();
+	this->clients.clear();
+}
+
+
+
+void Mirror_server::close_client(int fd)
+{
+	MLIB_D(_C("Closing mirror connection %1.", fd));
+	this->clients.erase(fd);
+}
+
+
+
+std::string Mirror_server::get_current_message(void) const
+{
+	std::ostringstream message;
+
+	message << "{\"current\":[";
+
+	for(size_t track_id = 0; track_id < this->sent.size(); track_id++)
+		message << (track_id ? "," : "") << this->sent[track_id];
+
+	message << "]}";
+
+	return message.str();
+}
+
+
+
+int Mirror_server::get_port(void) const
+{
+	struct sockaddr_storage address;
+	socklen_t address_size = sizeof address;
+
+	if(getsockname(this->listen_fd.get(), reinterpret_cast<struct sockaddr*>(&address), &address_size))
+		return -1;
+
+	if(address.ss_family == AF_INET)
+		return ntohs(reinterpret_cast<struct sockaddr_in*>(&address)->sin_port);
+	else if(address.ss_family == AF_INET6)
+		return ntohs(reinterpret_cast<struct sockaddr_in6*>(&address)->sin6_port);
+	else
+		return -1;
+}
+
+
+
+bool Mirror_server::handle_http_request(Client& client)
+{
+	std::string method;
+	std::string path;
+	std::string upgrade;
+	std::string key;
+	std::string host;
+	std::string origin;
+	bool has_origin = false;
+
+	// Получаем запрос -->
+	{
+		size_t end_pos = client.input.find("\r\n\r\n");
+
+		if(end_pos == std::string::npos)
+			return client.input.size() <= MAX_REQUEST_SIZE;
+
+		std::istringstream request(client.input.substr(0, end_pos));
+		client.input.erase(0, end_pos + 4);
+
+		std::string line;
+		std::getline(request, line);
+
+		{
+			std::istringstream request_line(line);
+			request_line >> method >> path;
+		}
+
+		path = path.substr(0, path.find('?'));
+
+		while(std::getline(request, line))
+		{
+			size_t colon_pos = line.find(':');
+
+			if(colon_pos == std::string::npos)
+				continue;
+
+			std::string name = line.substr(0, colon_pos);
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+			std::string value = line.substr(colon_pos + 1);
+			value.erase(0, value.find_first_not_of(" \t"));
+			value.erase(value.find_last_not_of(" \t\r") + 1);
+
+			if(name == "upgrade")
+			{
+				upgrade = value;
+				std::transform(upgrade.begin(), upgrade.end(), upgrade.begin(), ::tolower);
+			}
+			else if(name == "sec-websocket-key")
+				key = value;
+			else if(name == "host")
+			{
+				host = value;
+				std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+			}
+			else if(name == "origin")
+			{
+				origin = value;
+				has_origin = true;
+			}
+		}
+	}
+	// Получаем запрос <--
+
+	MLIB_D(_C("Mirror request: %1 %2.", method, path));
+
+	client.closing = true;
+
+	if(method != "GET")
+		return this->send(client, make_http_response("405 Method Not Allowed", "text/plain", "Method not allowed.\n"));
+	else if(path == "/")
+		return this->send(client, make_http_response("200 OK", "text/html; charset=utf-8", INDEX_PAGE));
+	else if(path != "/ws")
+		return this->send(client, make_http_response("404 Not Found", "text/plain", "Not found.\n"));
+	else if(upgrade != "websocket" || key.empty())
+		return this->send(client, make_http_response("400 Bad Request", "text/plain", "WebSocket handshake expected.\n"));
+	// Браузер передает Origin страницы, открывшей соединение. Без этой
+	// проверки любая открытая в нем страница могла бы подключиться к
+	// серверу и прочитать все субтитры. Клиенты, не являющиеся браузерами,
+	// Origin не передают.
+	else if(has_origin && get_origin_host(origin) != host)
+	{
+		MLIB_D(_C("Rejecting mirror connection from origin '%1' (host '%2').", origin, host));
+		return this->send(client, make_http_response("403 Forbidden", "text/plain", "Cross-origin connections are not allowed.\n"));
+	}
+
+	// Устанавливаем WebSocket-соединение -->
+	{
+		client.closing = false;
+		client.websocket = true;
+
+		std::string response =
+			"HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: " + get_websocket_accept(key) + "\r\n"
+			"\r\n";
+
+		if(!this->send(client, response))
+			return false;
+
+		if(!this->tracks_frame.empty())
+		{
+			if(
+				!this->send(client, this->tracks_frame) ||
+				!this->send(client, make_websocket_frame(WEBSOCKET_TEXT, this->get_current_message()))
+			)
+				return false;
+		}
+	}
+	// Устанавливаем WebSocket-соединение <--
+
+	return this->handle_websocket_frames(client);
+}
+
+
+
+bool Mirror_server::handle_websocket_frames(Client& client)
+{
+	std::string& input = client.input;
+
+	while(input.size() >= 2)
+	{
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+		int opcode = data[0] & 0x0f;
+		bool masked = data[1] & 0x80;
+		guint64 size = data[1] & 0x7f;
+		size_t header_size = 2;
+
+		if(size == 126)
+			header_size += 2;
+		else if(size == 127)
+			header_size += 8;
+
+		if(input.size() < header_size)
+			break;
+
+		if(size >= 126)
+		{
+			size = 0;
+			for(size_t i = 2; i < header_size; i++)
+				size = size << 8 | data[i];
+		}
+
+		// Кадры клиента обязаны быть замаскированы
+		if(!masked || size > MAX_REQUEST_SIZE)
+			return false;
+
+		if(input.size() < header_size + 4 + size)
+			break;
+
+		std::string payload = input.substr(header_size + 4, size);
+
+		for(size_t i = 0; i < payload.size(); i++)
+			payload[i] ^= data[header_size + i % 4];
+
+		input.erase(0, header_size + 4 + size);
+
+		switch(opcode)
+		{
+			case WEBSOCKET_CLOSE:
+				client.closing = true;
+				return this->send(client, make_websocket_frame(WEBSOCKET_CLOSE, payload.substr(0, 2)));
+
+			case WEBSOCKET_PING:
+				if(!this->send(client, make_websocket_frame(WEBSOCKET_PONG, payload)))
+					return false;
+				break;
+
+			// Остальные сообщения клиента не используются
+			default:
+				break;
+		}
+	}
+
+	return true;
+}
+
+
+
+bool Mirror_server::on_accept_cb(Glib::IOCondition condition)
+{
+	int fd;
+
+	while( ( fd = accept4(this->listen_fd.get(), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC) ) >= 0 )
+	{
+		boost::shared_ptr<Client> client(new Client(fd));
+
+		if(this->clients.size() >= MAX_CLIENTS)
+		{
+			MLIB_D("Too many mirror connections.");
+			continue;
+		}
+
+		// Изменения состоят из нескольких байт и должны доставляться сразу
+		int nodelay = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof nodelay);
+
+		client->read_connection = Glib::signal_io().connect(
+			sigc::bind(sigc::mem_fun(*this, &Mirror_server::on_read_cb), fd),
+			fd, Glib::IO_IN | Glib::IO_HUP | Glib::IO_ERR);
+
+		this->clients[fd] = client;
+
+		MLIB_D(_C("Accepted mirror connection %1.", fd));
+	}
+
+	if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED)
+		MLIB_SW(__("Can't accept a connection: %1.", EE(errno)));
+
+	return true;
+}
+
+
+
+bool Mirror_server::on_flush_cb(void)
+{
+	TRACE_SPAN("mirror_flush");
+
+	std::ostringstream message;
+	bool changed = false;
+
+	message << "{\"d\":[";
+
+	for(size_t track_id = 0; track_id < this->current.size(); track_id++)
+	{
+		if(this->current[track_id] == this->sent[track_id])
+			continue;
+
+		message << (changed ? "," : "") << track_id << "," << this->current[track_id];
+		this->sent[track_id] = this->current[track_id];
+		changed = true;
+	}
+
+	message << "]}";
+
+	if(changed)
+		this->send_to_all(make_websocket_frame(WEBSOCKET_TEXT, message.str()));
+
+	return false;
+}
+
+
+
+bool Mirror_server::on_read_cb(Glib::IOCondition condition, int fd)
+{
+	Clients::iterator it = this->clients.find(fd);
+
+	if(it == this->clients.end())
+		return false;
+
+	// Клиент может быть удален во время обработки
+	boost::shared_ptr<Client> client = it->second;
+	bool ok = true;
+
+	// Получаем данные -->
+		while(true)
+		{
+			char buf[4096];
+			ssize_t size = recv(fd, buf, sizeof buf, 0);
+
+			if(size > 0)
+			{
+				client->input.append(buf, size);
+				continue;
+			}
+
+			if(size < 0 && errno == EINTR)
+				continue;
+
+			if(size == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK ))
+				ok = false;
+
+			break;
+		}
+	// Получаем данные <--
+
+	if(ok && !client->closing)
+	{
+		if(client->websocket)
+			ok = this->handle_websocket_frames(*client);
+		else
+			ok = this->handle_http_request(*client);
+	}
+
+	if(!ok)
+	{
+		this->close_client(fd);
+		return false;
+	}
+
+	return true;
+}
+
+
+
+bool Mirror_server::on_write_cb(Glib::IOCondition condition, int fd)
+{
+	Clients::iterator it = this->clients.find(fd);
+
+	if(it == this->clients.end())
+		return false;
+
+	boost::shared_ptr<Client> client = it->second;
+
+	if(!this->write_output(*client))
+	{
+		this->close_client(fd);
+		return false;
+	}
+
+	return !client->output.empty();
+}
+
+
+
+bool Mirror_server::send(Client& client, const std::string& data)
+{
+	client.output += data;
+
+	if(client.output.size() > this->tracks_frame.size() + MAX_OUTPUT_BACKLOG)
+	{
+		MLIB_D(_C("Mirror connection %1 is too slow.", client.fd.get()));
+		return false;
+	}
+
+	return this->write_output(client);
+}
+
+
+
+void Mirror_server::send_to_all(const std::string& frame)
+{
+	std::vector<int> failed;
+
+	M_FOR_IT(this->clients, it)
+	{
+		Client& client = *it->second;
+
+		if(client.websocket && !client.closing && !this->send(client, frame))
+			failed.push_back(it->first);
+	}
+
+	M_FOR_CONST_IT(failed, it)
+		this->close_client(*it);
+}
+
+
+
+void Mirror_server::set_current(size_t track_id, size_t cue_id)
+{
+	if(track_id >= this->current.size())
+		return;
+
+	this->current[track_id] = cue_id;
+
+	// Без клиентов отправлять изменения некому: новые клиенты получают
+	// текущие субтитры при подключении.
+	if(this->clients.empty())
+		this->sent[track_id] = cue_id;
+	else if(!this->flush_connection.connected())
+	{
+		// Изменения отправляются после перерисовки окна
+		this->flush_connection = Glib::signal_idle().connect(
+			sigc::mem_fun(*this, &Mirror_server::on_flush_cb), Glib::PRIORITY_DEFAULT_IDLE);
+	}
+}
+
+
+
+void Mirror_server::set_tracks(const std::vector<Subtitles>& subtitles)
+{
+	TRACE_SPAN("mirror_set_tracks");
+
+	// Формируем сообщение с текстами дорожек -->
+	{
+		std::string message = "{\"tracks\":[";
+
+		for(size_t track_id = 0; track_id < subtitles.size(); track_id++)
+		{
+			const Subtitles::Storage& cues = subtitles[track_id].get();
+
+			message += track_id ? ",[" : "[";
+
+			for(size_t cue_id = 0; cue_id < cues.size(); cue_id++)
+			{
+				if(cue_id)
+					message += ',';
+
+				append_json_string(&message, cues[cue_id].text);
+			}
+
+			message += ']';
+		}
+
+		message += "]}";
+
+		this->tracks_frame = make_websocket_frame(WEBSOCKET_TEXT, message);
+	}
+	// Формируем сообщение с текстами дорожек <--
+
+	this->flush_connection.disconnect();
+	this->current.assign(subtitles.size(), 0);
+	this->sent = this->current;
+
+	this->send_to_all(this->tracks_frame);
+	this->send_to_all(make_websocket_frame(WEBSOCKET_TEXT, this->get_current_message()));
+}
+
+
+
+bool Mirror_server::write_output(Client& client)
+{
+	size_t written = 0;
+
+	while(written < client.output.size())
+	{
+		ssize_t size = ::send(client.fd.get(), client.output.data() + written,
+			client.output.size() - written, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if(size >= 0)
+			written += size;
+		else if(errno == EINTR)
+			continue;
+		else if(errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		else
+		{
+			MLIB_D(_C("Can't send data to mirror connection %1: %2.", client.fd.get(), EE(errno)));
+			return false;
+		}
+	}
+
+	client.output.erase(0, written);
+
+	if(client.output.empty())
+	{
+		client.write_connection.disconnect();
+
+		if(client.closing)
+			return false;
+	}
+	else if(!client.write_connection.connected())
+	{
+		client.write_connection = Glib::signal_io().connect(
+			sigc::bind(sigc::mem_fun(*this, &Mirror_server::on_write_cb), client.fd.get()),
+			client.fd.get(), Glib::IO_OUT);
+	}
+
+	return true;
+}
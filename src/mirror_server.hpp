@@ -0,0 +1,178 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_MIRROR_SERVER
+	#define HEADER_MIRROR_SERVER
+
+	#include <map>
+	#include <string>
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/shared_ptr.hpp>
+
+	#include <glibmm/main.h>
+
+	#include <sigc++/connection.h>
+	#include <sigc++/trackable.h>
+
+	class Subtitles;
+
+
+	/// Переменная окружения, задающая адрес ("host:port" или "[host]:port"),
+	/// на котором принимает соединения Mirror_server. Если она не задана, то
+	/// сервер не запускается. Пустой host (":port") означает все сетевые
+	/// интерфейсы - субтитры станут доступны всем в сети.
+	#define MIRROR_ENV_NAME "SUBMPLAYER_MIRROR"
+
+
+	/// Встроенный HTTP и WebSocket сервер, транслирующий субтитры на другое
+	/// устройство (например, на планшет рядом с телевизором).
+	///
+	/// По адресу "/" отдается страница, которая подключается к "/ws" по
+	/// протоколу WebSocket. Тексты всех дорожек передаются клиенту один
+	/// раз при подключении (и при смене файла), а далее - только номера
+	/// субтитров, ставших текущими. Изменения накапливаются и отправляются
+	/// одним сообщением из idle-обработчика, т. е. после перерисовки окна, и
+	/// не задерживают выделение субтитров в самом окне.
+	///
+	/// Весь ввод-вывод неблокирующий и выполняется в Main loop'е. Клиенты,
+	/// не успевающие принимать данные, отключаются.
+	class Mirror_server: public sigc::trackable, public boost::noncopyable
+	{
+		private:
+			/// Одно соединение.
+			struct Client
+			{
+				Client(int fd);
+				~Client(void);
+
+				/// Сокет соединения.
+				m::File_holder		fd;
+
+				/// Установлено ли соединение по протоколу WebSocket (иначе
+				/// ожидается HTTP-запрос).
+				bool				websocket;
+
+				/// Должно ли соединение быть закрыто после отправки output.
+				bool				closing;
+
+				/// Принятые, но еще не обработанные данные.
+				std::string			input;
+
+				/// Данные, ожидающие отправки.
+				std::string			output;
+
+				/// Обработчик поступления данных.
+				sigc::connection	read_connection;
+
+				/// Обработчик готовности сокета к отправке данных (подключен,
+				/// только если output не пуст).
+				sigc::connection	write_connection;
+			};
+
+			typedef std::map< int, boost::shared_ptr<Client> > Clients;
+
+
+		public:
+			/// @param address - адрес в формате MIRROR_ENV_NAME. Порт 0
+			/// означает любой свободный порт (см. get_port()).
+			Mirror_server(const std::string& address) throw(m::Exception);
+			~Mirror_server(void);
+
+
+		private:
+			/// Слушающий сокет.
+			m::File_holder		listen_fd;
+
+			/// Обработчик входящих соединений.
+			sigc::connection	accept_connection;
+
+			/// Подключенные клиенты.
+			Clients				clients;
+
+			/// Кадр WebSocket с текстами всех дорожек.
+			std::string			tracks_frame;
+
+			/// Текущий субтитр каждой дорожки.
+			std::vector<size_t>	current;
+
+			/// Текущий субтитр каждой дорожки, о котором уже сообщено
+			/// клиентам.
+			std::vector<size_t>	sent;
+
+			/// Запланированная отправка изменений.
+			sigc::connection	flush_connection;
+
+
+		public:
+			/// Возвращает порт, на котором сервер принимает соединения.
+			int			get_port(void) const;
+
+			/// Задает текущий субтитр дорожки track_id. Изменения
+			/// отправляются клиентам позже, одним сообщением.
+			void		set_current(size_t track_id, size_t cue_id);
+
+			/// Задает транслируемые дорожки субтитров и отправляет их
+			/// тексты всем клиентам.
+			void		set_tracks(const std::vector<Subtitles>& subtitles);
+
+		private:
+			/// Закрывает соединение.
+			void		close_client(int fd);
+
+			/// Формирует сообщение с текущими субтитрами всех дорожек.
+			std::string	get_current_message(void) const;
+
+			/// Обрабатывает HTTP-запрос клиента, если он получен целиком.
+			/// @return - false, если соединение должно быть закрыто.
+			bool		handle_http_request(Client& client);
+
+			/// Обрабатывает полученные от клиента кадры WebSocket.
+			/// @return - false, если соединение должно быть закрыто.
+			bool		handle_websocket_frames(Client& client);
+
+			/// Обработчик входящего соединения.
+			bool		on_accept_cb(Glib::IOCondition condition);
+
+			/// Отправляет клиентам накопившиеся изменения.
+			bool		on_flush_cb(void);
+
+			/// Обработчик поступления данных от клиента.
+			bool		on_read_cb(Glib::IOCondition condition, int fd);
+
+			/// Обработчик готовности сокета клиента к отправке данных.
+			bool		on_write_cb(Glib::IOCondition condition, int fd);
+
+			/// Ставит data в очередь на отправку клиенту и отправляет то,
+			/// что можно отправить без блокировки.
+			/// @return - false, если соединение должно быть закрыто.
+			bool		send(Client& client, const std::string& data);
+
+			/// Отправляет кадр WebSocket frame всем WebSocket-клиентам.
+			void		send_to_all(const std::string& frame);
+
+			/// Отправляет данные, ожидающие отправки, не блокируясь.
+			/// @return - false, если соединение должно быть закрыто.
+			bool		write_output(Client& client);
+	};
+
+#endif
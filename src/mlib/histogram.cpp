@@ -0,0 +1,143 @@
+/**************************************************************************
+*                                                                         *
+*   MLib - library of some useful things for internal usage               *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef MLIB_ENABLE_ALIASES
+	#define MLIB_ENABLE_ALIASES
+#endif
+
+#include <algorithm>
+
+#include "histogram.hpp"
+
+
+
+namespace m {
+
+Histogram::Histogram(void)
+{
+	this->reset();
+}
+
+
+
+int Histogram::get_bucket(uint64_t value)
+{
+	if(value < static_cast<uint64_t>(SUB_BUCKETS))
+		return value;
+
+	int exponent = 63 - __builtin_clzll(value);
+	int shift = exponent - SUB_BUCKET_BITS;
+
+	return (shift + 1) * SUB_BUCKETS + ( (value >> shift) & (SUB_BUCKETS - 1) );
+}
+
+
+
+uint64_t Histogram::get_bucket_max(int bucket)
+{
+	if(bucket < SUB_BUCKETS)
+		return bucket;
+
+	int shift = bucket / SUB_BUCKETS - 1;
+	uint64_t sub_bucket = SUB_BUCKETS + bucket % SUB_BUCKETS;
+
+	return ( (sub_bucket + 1) << shift ) - 1;
+}
+
+
+
+uint64_t Histogram::get_count(void) const
+{
+	return this->total_count;
+}
+
+
+
+uint64_t Histogram::get_max(void) const
+{
+	return this->max;
+}
+
+
+
+double Histogram::get_mean(void) const
+{
+	uint64_t count = this->total_count;
+	return count ? double(this->sum) / count : 0;
+}
+
+
+
+uint64_t Histogram::get_percentile(double percentile) const
+{
+	uint64_t count = 0;
+	uint64_t max = this->max;
+
+	for(int bucket = 0; bucket < BUCKETS; bucket++)
+		count += this->counts[bucket];
+
+	if(!count)
+		return 0;
+
+	uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile * count + 0.5));
+	uint64_t cur_count = 0;
+
+	for(int bucket = 0; bucket < BUCKETS; bucket++)
+	{
+		cur_count += this->counts[bucket];
+
+		if(cur_count >= rank)
+			return std::min(get_bucket_max(bucket), max);
+	}
+
+	return max;
+}
+
+
+
+void Histogram::record(int64_t value)
+{
+	uint64_t unsigned_value = std::max<int64_t>(value, 0);
+
+	__sync_fetch_and_add(&this->counts[get_bucket(unsigned_value)], 1);
+	__sync_fetch_and_add(&this->total_count, 1);
+	__sync_fetch_and_add(&this->sum, unsigned_value);
+
+	for(uint64_t max = this->max; unsigned_value > max; max = this->max)
+		if(__sync_bool_compare_and_swap(&this->max, max, unsigned_value))
+			break;
+}
+
+
+
+void Histogram::reset(void)
+{
+	for(int bucket = 0; bucket < BUCKETS; bucket++)
+		this->counts[bucket] = 0;
+
+	this->total_count = 0;
+	this->sum = 0;
+	this->max = 0;
+
+	__sync_synchronize();
+}
+
+}
+
@@ -0,0 +1,104 @@
+/**************************************************************************
+*                                                                         *
+*   MLib - library of some useful things for internal usage               *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_MLIB_HISTOGRAM
+#define HEADER_MLIB_HISTOGRAM
+
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+
+
+
+namespace m {
+
+/// Гистограмма распределения неотрицательных целых значений (как правило -
+/// задержек в микросекундах).
+///
+/// Корзины устроены так же, как в HdrHistogram: каждая степень двойки
+/// делится на SUB_BUCKETS равных частей, поэтому относительная погрешность
+/// не превышает 1 / SUB_BUCKETS при постоянном объеме памяти.
+///
+/// Запись значений не использует блокировок и может производиться
+/// одновременно из нескольких потоков. Чтение во время записи возвращает
+/// значения, которые могут не учитывать несколько последних записей.
+class Histogram: public boost::noncopyable
+{
+	public:
+		/// Количество бит, задающих номер корзины внутри степени двойки.
+		static const int		SUB_BUCKET_BITS = 4;
+
+		/// Количество корзин внутри одной степени двойки.
+		static const int		SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+		/// Общее количество корзин.
+		static const int		BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+
+	public:
+		Histogram(void);
+
+
+	private:
+		/// Количество значений в корзинах.
+		volatile uint64_t	counts[BUCKETS];
+
+		/// Общее количество значений.
+		volatile uint64_t	total_count;
+
+		/// Сумма всех значений.
+		volatile uint64_t	sum;
+
+		/// Максимальное значение.
+		volatile uint64_t	max;
+
+
+	public:
+		/// Возвращает количество записанных значений.
+		uint64_t	get_count(void) const;
+
+		/// Возвращает максимальное записанное значение.
+		uint64_t	get_max(void) const;
+
+		/// Возвращает среднее значение.
+		double		get_mean(void) const;
+
+		/// Возвращает значение, не превышаемое долей percentile (0..1) всех
+		/// записанных значений (с точностью до размера корзины).
+		uint64_t	get_percentile(double percentile) const;
+
+		/// Записывает значение. Отрицательные значения считаются нулевыми.
+		void		record(int64_t value);
+
+		/// Удаляет все записанные значения.
+		void		reset(void);
+
+	private:
+		/// Возвращает номер корзины для значения value.
+		static int		get_bucket(uint64_t value);
+
+		/// Возвращает наибольшее значение, попадающее в корзину bucket.
+		static uint64_t	get_bucket_max(int bucket);
+};
+
+}
+
+#endif
+
@@ -23,6 +23,7 @@
 #endif
 
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <fcntl.h>
 #include <semaphore.h>
@@ -39,6 +40,7 @@
 
 #include "messages.hpp"
 #include "misc.hpp"
+#include "process.hpp"
 #include "string.hpp"
 #include "types.hpp"
 
@@ -459,13 +461,101 @@ namespace
 
 void close_all_fds(void) throw(m::Exception)
 {
-	struct rlimit limits;
+	int error = close_fds_from(STDERR_FILENO + 1);
 
-	if(getrlimit(RLIMIT_OFILE, &limits))
-		M_THROW(__("Can't get max opened files limit: %1.", EE(errno)));
+	if(error)
+		M_THROW(__("Can't close file descriptors: %1.", EE(error)));
+}
+
+
+
+int close_fds_from(int first_fd)
+{
+	// Внимание!
+	// Функция может вызываться в дочернем процессе, созданном vfork(),
+	// поэтому не должна выделять память и изменять глобальные данные.
+
+	// Linux >= 5.9 - закрываем все одним системным вызовом
+#ifdef SYS_close_range
+	if(!syscall(SYS_close_range, first_fd, ~0U, 0))
+		return 0;
+#endif
+
+	// Перебираем только открытые дескрипторы - их список есть в
+	// /proc/self/fd.
+	// -->
+	{
+		int dir_fd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+		if(dir_fd >= 0)
+		{
+			struct Dirent
+			{
+				uint64_t		d_ino;
+				int64_t			d_off;
+				unsigned short	d_reclen;
+				unsigned char	d_type;
+				char			d_name[];
+			};
+
+			char buf[4096] __attribute__ ((aligned(8)));
+			long size;
+			bool closed = false;
+
+			while( (size = syscall(SYS_getdents64, dir_fd, buf, sizeof buf)) > 0 )
+			{
+				for(long pos = 0; pos < size; )
+				{
+					const Dirent* entry = reinterpret_cast<const Dirent*>(buf + pos);
+					const char* name = entry->d_name;
+					int fd = 0;
+
+					pos += entry->d_reclen;
+
+					if(*name < '0' || *name > '9')
+						continue;
+
+					for(; *name >= '0' && *name <= '9'; name++)
+						fd = fd * 10 + (*name - '0');
+
+					if(fd >= first_fd && fd != dir_fd)
+					{
+						close(fd);
+						closed = true;
+					}
+				}
+
+				// Закрытие дескрипторов изменяет содержимое директории, поэтому
+				// после каждой порции перечитываем ее с начала.
+				if(closed)
+				{
+					closed = false;
+
+					if(lseek(dir_fd, 0, SEEK_SET) < 0)
+						break;
+				}
+			}
+
+			close(dir_fd);
+
+			if(!size)
+				return 0;
+		}
+	}
+	// <--
+
+	// Если /proc недоступен - перебираем все возможные дескрипторы
+	{
+		struct rlimit limits;
 
-	for(int fd = STDERR_FILENO + 1; fd < (int) limits.rlim_max; fd++)
-		close(fd);
+		if(getrlimit(RLIMIT_OFILE, &limits))
+			return errno;
+
+		for(int fd = first_fd; fd < (int) limits.rlim_max; fd++)
+			close(fd);
+	}
+
+	return 0;
 }
 
 
@@ -495,6 +585,18 @@ std::string	get_log_debug_prefix(const char* file, int line)
 
 
 
+Time_us get_monotonic_time(void)
+{
+	struct timespec time;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &time))
+		MLIB_E(__("Can't get monotonic time: %1.", EE(errno)));
+
+	return Time_us(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+
+
 void* realloc(void *ptr, const size_t size)
 {
 	ptr = ::realloc(ptr, size);
@@ -509,46 +611,15 @@ void* realloc(void *ptr, const size_t size)
 
 void run(const std::string& cmd_name, const std::vector<std::string>& args) throw(m::Exception)
 {
-	if(!m::unix_fork())
-	{
-		// Дочерний процесс
-
-		try
-		{
-			// Закрываем все открытые файловые дескрипторы
-			// Генерирует m::Exception.
-			m::close_all_fds();
-
-			char** argv;
-			std::vector<std::string> argv_vector;
+	Process process;
 
-			// Формируем массив аргументов -->
-			{
-				argv_vector.push_back( U2L(cmd_name) );
-
-				for(size_t i = 0; i < args.size(); i++)
-					argv_vector.push_back( U2L(args[i]) );
-
-
-				argv = new char*[argv_vector.size() + 1];
-
-				for(size_t i = 0; i < argv_vector.size(); i++)
-					argv[i] = const_cast<char *>( argv_vector[i].c_str() );
-
-				argv[argv_vector.size()] = NULL;
-			}
-			// Формируем массив аргументов <--
-
-			if(execvp(U2L(cmd_name).c_str(), argv) < 0)
-				M_THROW(EE(errno));
-		}
-		catch(m::Exception& e)
-		{
-			MLIB_SW(__("Running command '%1' failed: %2.", cmd_name, EE(e)));
-			_exit(1);
-		}
-
-		MLIB_LE();
+	try
+	{
+		process.spawn(cmd_name, args);
+	}
+	catch(m::Exception& e)
+	{
+		M_THROW(__("Running command '%1' failed: %2", cmd_name, EE(e)));
 	}
 }
 
@@ -620,11 +691,11 @@ pid_t unix_fork(void) throw(m::Exception)
 
 
 
-std::pair<int, int> unix_pipe(void) throw(m::Exception)
+std::pair<int, int> unix_pipe(int flags) throw(m::Exception)
 {
 	int fds[2];
 
-	if(pipe(fds) == -1)
+	if(pipe2(fds, flags) == -1)
 		M_THROW(__("Can't create a pipe: %1.", EE(errno)));
 	else
 		return std::pair<int, int>(fds[0], fds[1]);
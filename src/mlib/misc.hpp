@@ -289,6 +289,15 @@ class Semaphore: public boost::noncopyable
 /// Закрывает все файловые дескрипторы, оставляя только stdin, stdout и stderr.
 void				close_all_fds(void) throw(m::Exception);
 
+/// Закрывает все файловые дескрипторы, начиная с first_fd.
+/// Использует close_range(), а если ядро его не поддерживает - перебирает
+/// только открытые дескрипторы из /proc/self/fd, поэтому время работы не
+/// зависит от лимита на количество открытых файлов.
+/// Использует только системные вызовы, поэтому может вызываться в дочернем
+/// процессе, созданном vfork().
+/// @return - 0 или код ошибки.
+int					close_fds_from(int first_fd);
+
 /// Возвращает строку копирайта.
 /// @param start_year - год, в котором была написана программа.
 std::string			get_copyright_string(const std::string& author, const int start_year);
@@ -310,6 +319,11 @@ Version				get_major_minor_version(Version version);
 inline
 int					get_minor_version(Version version);
 
+/// Возвращает текущее значение монотонных часов (CLOCK_MONOTONIC). Значение
+/// не зависит от изменений системного времени, поэтому подходит для
+/// измерения интервалов.
+Time_us				get_monotonic_time(void);
+
 /// Возвращает sub-minor версию.
 inline
 int					get_sub_minor_version(Version version);
@@ -351,8 +365,9 @@ void				unix_execvp(const std::string& command, const std::vector<std::string>&
 /// Аналог системного fork().
 pid_t				unix_fork(void) throw(m::Exception);
 
-/// Аналог системного pipe().
-std::pair<int, int>	unix_pipe(void) throw(m::Exception);
+/// Аналог системного pipe2().
+/// @param flags - флаги для pipe2(), например O_CLOEXEC.
+std::pair<int, int>	unix_pipe(int flags = 0) throw(m::Exception);
 
 }
 
@@ -0,0 +1,333 @@
+/**************************************************************************
+*                                                                         *
+*   MLib - library of some useful things for internal usage               *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef MLIB_ENABLE_ALIASES
+	#define MLIB_ENABLE_ALIASES
+#endif
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include <algorithm>
+
+#include <boost/scoped_array.hpp>
+
+#include "messages.hpp"
+#include "misc.hpp"
+#include "process.hpp"
+#include "string.hpp"
+
+
+extern char** environ;
+
+// posix_spawn() умеет закрывать все лишние файловые дескрипторы только
+// начиная с glibc 2.34.
+#ifdef __GLIBC__
+	#if __GLIBC_PREREQ(2, 34)
+		#define MLIB_PROCESS_USE_POSIX_SPAWN
+	#endif
+#endif
+
+
+
+namespace m
+{
+
+Process::Process(void)
+:
+	pid(-1),
+	exited(false),
+	status(0)
+{
+}
+
+
+
+pid_t Process::get_pid(void) const
+{
+	return this->pid;
+}
+
+
+
+int Process::get_pidfd(void) const
+{
+	return this->pidfd.get();
+}
+
+
+
+int Process::get_status(void) const
+{
+	return this->status;
+}
+
+
+
+void Process::redirect(int parent_fd, int child_fd)
+{
+	this->redirections.push_back(std::pair<int, int>(parent_fd, child_fd));
+}
+
+
+
+void Process::spawn(const std::string& command, const std::vector<std::string>& args) throw(m::Exception)
+{
+	if(this->pid > 0)
+		M_THROW(_("Process is already started."));
+
+	// Формируем массив аргументов -->
+		std::vector<std::string> argv_strings;
+		argv_strings.reserve(args.size() + 1);
+
+		argv_strings.push_back(U2L(command));
+		M_FOR_CONST_IT(args, it)
+			argv_strings.push_back(U2L(*it));
+
+		boost::scoped_array<char*> argv(new char*[argv_strings.size() + 1]);
+
+		{
+			char** arg = argv.get();
+
+			M_FOR_CONST_IT(argv_strings, it)
+				*arg++ = const_cast<char*>(it->c_str());
+
+			*arg = NULL;
+		}
+	// Формируем массив аргументов <--
+
+	// Чтобы перенаправления не затирали друг друга, сначала переносим все
+	// дескрипторы на номера, которые заведомо больше всех используемых,
+	// и только затем - на требуемые.
+	// -->
+		int max_fd = STDERR_FILENO;
+		int max_child_fd = STDERR_FILENO;
+		size_t redirections_num = this->redirections.size();
+
+		M_FOR_CONST_IT(this->redirections, it)
+		{
+			max_fd = std::max(max_fd, std::max(it->first, it->second));
+			max_child_fd = std::max(max_child_fd, it->second);
+		}
+
+		int temp_fd_base = max_fd + 1;
+	// <--
+
+#ifdef MLIB_PROCESS_USE_POSIX_SPAWN
+	{
+		int error = 0;
+		sigset_t signals;
+		posix_spawnattr_t attrs;
+		posix_spawn_file_actions_t actions;
+
+		if( (error = posix_spawn_file_actions_init(&actions)) )
+			M_THROW(__("Can't initialize spawn file actions: %1.", EE(error)));
+
+		if( (error = posix_spawnattr_init(&attrs)) )
+		{
+			posix_spawn_file_actions_destroy(&actions);
+			M_THROW(__("Can't initialize spawn attributes: %1.", EE(error)));
+		}
+
+		// Перенаправления -->
+			for(size_t i = 0; i < redirections_num && !error; i++)
+				error = posix_spawn_file_actions_adddup2(&actions, this->redirections[i].first, temp_fd_base + i);
+
+			for(size_t i = 0; i < redirections_num && !error; i++)
+				error = posix_spawn_file_actions_adddup2(&actions, temp_fd_base + i, this->redirections[i].second);
+		// Перенаправления <--
+
+		// Закрываем все остальные дескрипторы -->
+			for(int fd = STDERR_FILENO + 1; fd <= max_child_fd && !error; fd++)
+			{
+				bool redirected = false;
+
+				M_FOR_CONST_IT(this->redirections, it)
+					redirected = redirected || it->second == fd;
+
+				if(!redirected)
+					error = posix_spawn_file_actions_addclose(&actions, fd);
+			}
+
+			if(!error)
+				error = posix_spawn_file_actions_addclosefrom_np(&actions, max_child_fd + 1);
+		// Закрываем все остальные дескрипторы <--
+
+		// Дочерний процесс не должен унаследовать от нас маску сигналов и
+		// игнорирование SIGPIPE.
+		// -->
+			if(!error)
+				error = posix_spawnattr_setflags(&attrs, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+			if(!error)
+			{
+				sigemptyset(&signals);
+				error = posix_spawnattr_setsigmask(&attrs, &signals);
+			}
+
+			if(!error)
+			{
+				sigemptyset(&signals);
+				sigaddset(&signals, SIGPIPE);
+				error = posix_spawnattr_setsigdefault(&attrs, &signals);
+			}
+		// <--
+
+		if(!error)
+			error = posix_spawnp(&this->pid, argv[0], &actions, &attrs, argv.get(), environ);
+
+		posix_spawnattr_destroy(&attrs);
+		posix_spawn_file_actions_destroy(&actions);
+
+		if(error)
+		{
+			this->pid = -1;
+			M_THROW(EE(error));
+		}
+	}
+#else
+	{
+		// Заполняется дочерним процессом, если exec() завершится неудачей.
+		// Т. к. vfork() не копирует память, родительский процесс увидит это
+		// значение.
+		volatile int exec_errno = 0;
+
+		const std::pair<int, int>* redirections = redirections_num ? &this->redirections[0] : NULL;
+
+		pid_t pid = vfork();
+
+		if(pid == -1)
+			M_THROW(__("Can't fork the process: %1.", EE(errno)));
+		else if(!pid)
+		{
+			// Дочерний процесс.
+			// Внимание! До exec() здесь допустимы только системные вызовы.
+
+			for(size_t i = 0; i < redirections_num; i++)
+				if(dup2(redirections[i].first, temp_fd_base + i) < 0)
+					goto error;
+
+			for(size_t i = 0; i < redirections_num; i++)
+				if(dup2(temp_fd_base + i, redirections[i].second) < 0)
+					goto error;
+
+			for(int fd = STDERR_FILENO + 1; fd <= max_child_fd; fd++)
+			{
+				bool redirected = false;
+
+				for(size_t i = 0; i < redirections_num; i++)
+					redirected = redirected || redirections[i].second == fd;
+
+				if(!redirected)
+					close(fd);
+			}
+
+			if( (exec_errno = close_fds_from(max_child_fd + 1)) )
+				_exit(127);
+
+			{
+				sigset_t signals;
+				sigemptyset(&signals);
+				sigprocmask(SIG_SETMASK, &signals, NULL);
+				signal(SIGPIPE, SIG_DFL);
+			}
+
+			execvp(argv[0], argv.get());
+
+		error:
+			exec_errno = errno;
+			_exit(127);
+		}
+
+		this->pid = pid;
+
+		if(exec_errno)
+		{
+			this->wait();
+			this->pid = -1;
+			this->exited = false;
+			M_THROW(EE(exec_errno));
+		}
+	}
+#endif
+
+	MLIB_D(_C("Process '%1' has been started with PID %2.", command, this->pid));
+
+	// Получаем pidfd для отслеживания завершения процесса -->
+	#ifdef SYS_pidfd_open
+	{
+		int fd = syscall(SYS_pidfd_open, this->pid, 0);
+
+		if(fd < 0)
+			MLIB_D(_C("Unable to get pidfd for process %1: %2.", this->pid, EE(errno)));
+		else
+			this->pidfd.set(fd);
+	}
+	#endif
+	// Получаем pidfd для отслеживания завершения процесса <--
+}
+
+
+
+bool Process::wait(bool block) throw(m::Exception)
+{
+	int status;
+	pid_t rval;
+
+	if(this->exited)
+		return true;
+
+	if(this->pid <= 0)
+		M_THROW(_("Process is not started."));
+
+	do
+		rval = waitpid(this->pid, &status, block ? 0 : WNOHANG);
+	while(rval < 0 && errno == EINTR);
+
+	if(rval < 0)
+	{
+		// Процесс уже мог быть обработан кем-то другим (например,
+		// обработчиком SIGCHLD).
+		if(errno == ECHILD)
+		{
+			MLIB_D(_C("Process %1 has been already reaped.", this->pid));
+			this->exited = true;
+			return true;
+		}
+		else
+			M_THROW(__("Can't wait for process %1: %2.", this->pid, EE(errno)));
+	}
+	else if(rval == 0)
+		return false;
+
+	this->exited = true;
+	this->status = status;
+
+	return true;
+}
+
+}
+
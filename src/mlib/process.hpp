@@ -0,0 +1,112 @@
+/**************************************************************************
+*                                                                         *
+*   MLib - library of some useful things for internal usage               *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_MLIB_PROCESS
+#define HEADER_MLIB_PROCESS
+
+#include <sys/types.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "errors.hpp"
+#include "misc.hpp"
+
+
+
+namespace m {
+
+/// Запускает дочерний процесс, не копируя адресное пространство текущего
+/// процесса.
+///
+/// В отличие от fork() + exec() не копирует таблицы страниц родительского
+/// процесса (что для большого многопоточного GUI-приложения и медленно, и
+/// небезопасно) - для запуска используется posix_spawn(), а там, где
+/// posix_spawn() не умеет закрывать лишние файловые дескрипторы - vfork().
+///
+/// Дочерний процесс получает только stdin, stdout, stderr и явно
+/// перенаправленные в него файловые дескрипторы - все остальные
+/// закрываются.
+///
+/// Объект не завершает процесс и не ожидает его завершения при своем
+/// уничтожении.
+class Process: public boost::noncopyable
+{
+	public:
+		Process(void);
+
+
+	private:
+		/// Перенаправления файловых дескрипторов: дескриптор родительского
+		/// процесса -> дескриптор дочернего процесса.
+		std::vector< std::pair<int, int> >	redirections;
+
+		/// PID запущенного процесса.
+		pid_t								pid;
+
+		/// pidfd запущенного процесса (если поддерживается ядром).
+		File_holder							pidfd;
+
+		/// Завершился ли уже процесс.
+		bool								exited;
+
+		/// Код завершения процесса в формате waitpid().
+		int									status;
+
+
+	public:
+		/// Возвращает PID запущенного процесса.
+		pid_t	get_pid(void) const;
+
+		/// Возвращает pidfd запущенного процесса, который становится
+		/// доступным для чтения, когда процесс завершается. Это позволяет
+		/// ожидать завершения процесса с помощью poll() или Main loop'а.
+		/// Возвращает -1, если ядро не поддерживает pidfd.
+		int		get_pidfd(void) const;
+
+		/// Возвращает код завершения процесса в формате waitpid(). Имеет смысл
+		/// только после того, как wait() вернула true.
+		int		get_status(void) const;
+
+		/// Задает перенаправление файлового дескриптора: в дочернем процессе
+		/// parent_fd будет доступен как child_fd.
+		///
+		/// Рекомендуется, чтобы parent_fd был создан с флагом O_CLOEXEC -
+		/// тогда он не попадет в другие процессы, запускаемые параллельно.
+		void	redirect(int parent_fd, int child_fd);
+
+		/// Запускает процесс. Поиск исполняемого файла осуществляется так же,
+		/// как это делает execvp().
+		void	spawn(const std::string& command, const std::vector<std::string>& args) throw(m::Exception);
+
+		/// Ожидает завершения процесса.
+		/// @param block - если false, то только проверяет, не завершился ли
+		/// процесс.
+		/// @return - true, если процесс завершился.
+		bool	wait(bool block = true) throw(m::Exception);
+};
+
+}
+
+#endif
+
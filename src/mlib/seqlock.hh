@@ -0,0 +1,78 @@
+/**************************************************************************
+*                                                                         *
+*   MLib - library of some useful things for internal usage               *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+namespace m
+{
+
+template<class T>
+Seqlock<T>::Seqlock(void)
+:
+	sequence(0),
+	value()
+{
+}
+
+
+
+template<class T>
+Seqlock<T>::Seqlock(const T& value)
+:
+	sequence(0),
+	value(value)
+{
+}
+
+
+
+template<class T>
+T Seqlock<T>::load(void) const
+{
+	T value;
+	unsigned int sequence;
+
+	do
+	{
+		// Ждем, пока писатель закончит изменение значения
+		while( (sequence = this->sequence) & 1 )
+			;
+
+		__sync_synchronize();
+		value = this->value;
+		__sync_synchronize();
+	}
+	while(sequence != this->sequence);
+
+	return value;
+}
+
+
+
+template<class T>
+void Seqlock<T>::store(const T& value)
+{
+	this->sequence++;
+	__sync_synchronize();
+	this->value = value;
+	__sync_synchronize();
+	this->sequence++;
+}
+
+}
+
@@ -0,0 +1,74 @@
+/**************************************************************************
+*                                                                         *
+*   MLib - library of some useful things for internal usage               *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_MLIB_SEQLOCK
+#define HEADER_MLIB_SEQLOCK
+
+#include <boost/noncopyable.hpp>
+
+
+
+namespace m {
+
+/// Seqlock - позволяет одному потоку-писателю публиковать значение, а любому
+/// количеству потоков-читателей получать его согласованную копию, не
+/// используя блокировок.
+///
+/// Читатели никогда не задерживают писателя: если во время чтения значение
+/// было изменено, читатель просто повторяет попытку. Поэтому T должен быть
+/// простым типом, который можно безопасно копировать побайтно и размер
+/// которого невелик.
+template<class T>
+class Seqlock: public boost::noncopyable
+{
+	public:
+		inline
+		Seqlock(void);
+
+		inline
+		Seqlock(const T& value);
+
+
+	private:
+		/// Счетчик изменений. Нечетное значение означает, что в данный момент
+		/// писатель изменяет value.
+		volatile unsigned int	sequence;
+
+		/// Публикуемое значение.
+		T						value;
+
+
+	public:
+		/// Возвращает согласованную копию значения.
+		inline
+		T		load(void) const;
+
+		/// Публикует новое значение.
+		/// Внимание! Может вызываться только из одного потока.
+		inline
+		void	store(const T& value);
+};
+
+}
+
+#include "seqlock.hh"
+
+#endif
+
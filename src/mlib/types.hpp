@@ -113,6 +113,9 @@
 		/// Время в милисекундах.
 		typedef long long	Time_ms;
 
+		/// Время в микросекундах.
+		typedef long long	Time_us;
+
 		// Числовое представление версии приложения/библиотеки.
 		// К примеру версия 1.12.4 должна записываться следующим
 		// образом: 1012004.
@@ -142,6 +145,7 @@
 		using m::Speed;
 		using m::Time;
 		using m::Time_ms;
+		using m::Time_us;
 		using m::Version;
 	#endif
 
@@ -0,0 +1,531 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+/// Имитатор MPlayer'а для тестирования и замеров производительности.
+///
+/// Выводит строки состояния в том же формате, что и MPlayer, добавляя в конец
+/// каждой поле "T:", содержащее время (по монотонным часам, в микросекундах),
+/// в которое строка была выведена. Параметры работы задаются переменной
+/// окружения SUBMPLAYER_MOCK в виде списка "имя=значение" через запятую:
+///
+/// rate          - количество строк состояния в секунду (10);
+/// duration      - продолжительность "файла" в секундах (60);
+/// start         - начальная позиция в секундах (0);
+/// speed         - скорость воспроизведения (1);
+/// seek_every    - период автоматической перемотки в секундах (0 - нет);
+/// seek_step     - величина автоматической перемотки в секундах (30);
+/// pause_every   - период автоматической паузы в секундах (0 - нет);
+/// pause_for     - продолжительность автоматической паузы в секундах (1);
+/// burst_every   - период выдачи пачки строк в секундах (0 - нет);
+/// burst_size    - количество строк в пачке (100).
+///
+/// Со стандартного ввода принимаются те же клавиши, что и у MPlayer'а:
+/// q и Escape - выход, p и пробел - пауза, стрелки и PgUp/PgDn - перемотка.
+///
+/// Из файла, заданного опцией "-input file=...", принимаются команды
+/// slave-режима MPlayer'а: pause, seek <значение> [<тип>] и quit.
+
+
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <string>
+
+#include "seek_keys.hpp"
+
+
+
+namespace
+{
+	/// Параметры работы имитатора.
+	struct Options
+	{
+		Options(void);
+
+		double	rate;
+		double	duration;
+		double	start;
+		double	speed;
+		double	seek_every;
+		double	seek_step;
+		double	pause_every;
+		double	pause_for;
+		double	burst_every;
+		double	burst_size;
+	};
+
+
+	/// Время в микросекундах.
+	typedef long long Time_us;
+
+
+	/// Время, в течение которого ожидается продолжение escape-
+	/// последовательности, прежде чем считать, что был нажат Escape.
+	const Time_us ESCAPE_TIMEOUT = 50 * 1000;
+
+
+
+	/// Выводит сообщение об ошибке и завершает работу.
+	void	die(const std::string& message) __attribute__ ((__noreturn__));
+
+	/// Возвращает текущее значение монотонных часов.
+	Time_us	get_monotonic_time(void);
+
+	/// Разбирает значение переменной окружения SUBMPLAYER_MOCK.
+	Options	parse_options(const char* string);
+
+	/// Выводит строку состояния для позиции position.
+	void	print_status(double position);
+
+	/// Выполняет команду slave-режима MPlayer'а.
+	/// @return - false, если получена команда завершения работы.
+	bool	process_command(const std::string& command, const Options& options, double* position, bool* paused);
+
+	/// Читает все имеющиеся данные из fd в buf.
+	/// @return - false, если достигнут конец файла.
+	bool	read_input(int fd, std::string* buf);
+
+	/// Записывает строку в стандартный вывод.
+	void	write_string(const std::string& string);
+
+
+
+	Options::Options(void)
+	:
+		rate(10),
+		duration(60),
+		start(0),
+		speed(1),
+		seek_every(0),
+		seek_step(30),
+		pause_every(0),
+		pause_for(1),
+		burst_every(0),
+		burst_size(100)
+	{
+	}
+
+
+
+	void die(const std::string& message)
+	{
+		fprintf(stderr, "mock_mplayer: %s\n", message.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+
+
+	Time_us get_monotonic_time(void)
+	{
+		struct timespec time;
+
+		if(clock_gettime(CLOCK_MONOTONIC, &time))
+			die(std::string("Unable to get monotonic time: ") + strerror(errno));
+
+		return Time_us(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+	}
+
+
+
+	Options parse_options(const char* string)
+	{
+		Options options;
+
+		const struct Option
+		{
+			const char*	name;
+			double		Options::* value;
+		} OPTIONS[] = {
+			{ "rate"		,	&Options::rate			},
+			{ "duration"	,	&Options::duration		},
+			{ "start"		,	&Options::start			},
+			{ "speed"		,	&Options::speed			},
+			{ "seek_every"	,	&Options::seek_every	},
+			{ "seek_step"	,	&Options::seek_step		},
+			{ "pause_every"	,	&Options::pause_every	},
+			{ "pause_for"	,	&Options::pause_for		},
+			{ "burst_every"	,	&Options::burst_every	},
+			{ "burst_size"	,	&Options::burst_size	},
+			{ NULL			,	NULL					}
+		};
+
+		std::string options_string = string ? string : "";
+		size_t pos = 0;
+
+		while(pos < options_string.size())
+		{
+			size_t end_pos = options_string.find(',', pos);
+			if(end_pos == std::string::npos)
+				end_pos = options_string.size();
+
+			std::string option = options_string.substr(pos, end_pos - pos);
+			pos = end_pos + 1;
+
+			if(option.empty())
+				continue;
+
+			size_t delimiter_pos = option.find('=');
+			if(delimiter_pos == std::string::npos)
+				die("Invalid option '" + option + "'.");
+
+			std::string name = option.substr(0, delimiter_pos);
+			std::string value_string = option.substr(delimiter_pos + 1);
+
+			const Option* it = OPTIONS;
+			while(it->name && name != it->name)
+				it++;
+
+			if(!it->name)
+				die("Unknown option '" + name + "'.");
+
+			char* value_end;
+			double value = strtod(value_string.c_str(), &value_end);
+
+			if(value_string.empty() || *value_end || value < 0)
+				die("Invalid value for option '" + name + "'.");
+
+			options.*(it->value) = value;
+		}
+
+		if(options.rate <= 0)
+			die("Invalid status line rate.");
+
+		return options;
+	}
+
+
+
+	void print_status(double position)
+	{
+		char buf[128];
+
+		snprintf(buf, sizeof buf,
+			"A:%6.1f V:%6.1f A-V:  0.000 ct:  0.000   0/  0  0%%  0%%  0.0%% 0 0 T:%lld\r",
+			position, position, get_monotonic_time());
+
+		write_string(buf);
+	}
+
+
+
+	bool process_command(const std::string& command, const Options& options, double* position, bool* paused)
+	{
+		char name[32];
+		double value = 0;
+		int type = 0;
+
+		if(sscanf(command.c_str(), "%31s %lf %d", name, &value, &type) < 1)
+			return true;
+
+		if(!strcmp(name, "quit"))
+			return false;
+		else if(!strcmp(name, "pause"))
+		{
+			*paused = !*paused;
+			if(*paused)
+				write_string("\n  =====  PAUSE  =====\r\n");
+		}
+		else if(!strcmp(name, "seek"))
+		{
+			switch(type)
+			{
+				case 1:
+					*position = options.duration * value / 100;
+					break;
+
+				case 2:
+					*position = value;
+					break;
+
+				default:
+					*position += value;
+					break;
+			}
+
+			*position = std::max(0.0, std::min(*position, options.duration));
+
+			// Как и MPlayer, любая команда, кроме pause, снимает паузу
+			*paused = false;
+		}
+
+		return true;
+	}
+
+
+
+	bool read_input(int fd, std::string* buf)
+	{
+		char data[64];
+		ssize_t size;
+
+		while( (size = read(fd, data, sizeof data)) > 0 )
+			buf->append(data, size);
+
+		return size < 0 && (errno == EINTR || errno == EAGAIN);
+	}
+
+
+
+	void write_string(const std::string& string)
+	{
+		const char* data = string.data();
+		size_t size = string.size();
+
+		while(size)
+		{
+			ssize_t written = write(STDOUT_FILENO, data, size);
+
+			if(written < 0)
+			{
+				if(errno == EINTR)
+					continue;
+
+				// Читатель закрыл свой конец pipe'а
+				exit(EXIT_SUCCESS);
+			}
+
+			data += written;
+			size -= written;
+		}
+	}
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	Options options = parse_options(getenv("SUBMPLAYER_MOCK"));
+
+	const Time_us period = static_cast<Time_us>(1000000 / options.rate);
+
+	double position = std::min(options.start, options.duration);
+	bool paused = false;
+
+	Time_us last_time = get_monotonic_time();
+	Time_us next_status_time = last_time;
+	Time_us next_seek_time = last_time + static_cast<Time_us>(options.seek_every * 1000000);
+	Time_us next_pause_time = last_time + static_cast<Time_us>(options.pause_every * 1000000);
+	Time_us next_burst_time = last_time + static_cast<Time_us>(options.burst_every * 1000000);
+	Time_us pause_end_time = 0;
+
+	std::string input;
+	bool stdin_eof = false;
+
+	// Время получения незавершенной escape-последовательности
+	Time_us escape_time = 0;
+
+	std::string commands;
+	int commands_fd = -1;
+
+
+	write_string("MPlayer mock (submplayer)\n\n");
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-input") && i + 1 < argc)
+		{
+			i++;
+
+			if(!strncmp(argv[i], "file=", 5))
+			{
+				commands_fd = open(argv[i] + 5, O_RDONLY | O_NONBLOCK);
+				if(commands_fd < 0)
+					die(std::string("Unable to open commands file: ") + strerror(errno));
+			}
+		}
+		else if(argv[i][0] != '-')
+			write_string(std::string("Playing ") + argv[i] + ".\n");
+	}
+	write_string("Starting playback...\n");
+
+	while(position < options.duration)
+	{
+		Time_us cur_time = get_monotonic_time();
+
+		// Продвигаем позицию -->
+			if(!paused)
+				position += double(cur_time - last_time) / 1000000 * options.speed;
+
+			last_time = cur_time;
+		// Продвигаем позицию <--
+
+		// Автоматические события -->
+			if(options.seek_every && cur_time >= next_seek_time)
+			{
+				position += options.seek_step;
+				if(position >= options.duration)
+					position = options.start;
+
+				next_seek_time += static_cast<Time_us>(options.seek_every * 1000000);
+			}
+
+			if(paused && pause_end_time && cur_time >= pause_end_time)
+			{
+				paused = false;
+				pause_end_time = 0;
+			}
+
+			if(options.pause_every && cur_time >= next_pause_time)
+			{
+				if(!paused)
+				{
+					paused = true;
+					pause_end_time = cur_time + static_cast<Time_us>(options.pause_for * 1000000);
+					write_string("\n  =====  PAUSE  =====\r\n");
+				}
+
+				next_pause_time += static_cast<Time_us>(options.pause_every * 1000000);
+			}
+
+			if(options.burst_every && cur_time >= next_burst_time)
+			{
+				for(int i = 0; i < options.burst_size; i++)
+					print_status(position + i * 0.1);
+
+				next_burst_time += static_cast<Time_us>(options.burst_every * 1000000);
+			}
+		// Автоматические события <--
+
+		if(!paused && cur_time >= next_status_time)
+		{
+			print_status(position);
+
+			next_status_time += period;
+			if(next_status_time < cur_time)
+				next_status_time = cur_time + period;
+		}
+
+		// Ожидаем следующего события или команды -->
+		{
+			struct pollfd fds[2];
+			fds[0].fd = stdin_eof ? -1 : STDIN_FILENO;
+			fds[0].events = POLLIN;
+			fds[0].revents = 0;
+			fds[1].fd = commands_fd;
+			fds[1].events = POLLIN;
+			fds[1].revents = 0;
+
+			int timeout = paused ? 10 : static_cast<int>(
+				std::max<Time_us>(0, next_status_time - get_monotonic_time()) / 1000);
+
+			if(escape_time)
+				timeout = std::min(timeout, 10);
+
+			if(poll(fds, 2, timeout) < 0 && errno != EINTR)
+				die(std::string("Unable to poll input: ") + strerror(errno));
+
+			if(fds[0].revents)
+			{
+				char buf[64];
+				ssize_t size = read(STDIN_FILENO, buf, sizeof buf);
+
+				if(size > 0)
+					input.append(buf, size);
+				else if(!size || errno != EINTR)
+					stdin_eof = true;
+			}
+
+			if(fds[1].revents && !read_input(commands_fd, &commands))
+			{
+				close(commands_fd);
+				commands_fd = -1;
+			}
+		}
+		// Ожидаем следующего события или команды <--
+
+		// Обрабатываем команды slave-режима -->
+			for(size_t pos; (pos = commands.find('\n')) != std::string::npos; )
+			{
+				bool was_paused = paused;
+
+				if(!process_command(commands.substr(0, pos), options, &position, &paused))
+				{
+					write_string("\n\nExiting... (Quit)\n");
+					return EXIT_SUCCESS;
+				}
+
+				if(was_paused != paused)
+					pause_end_time = 0;
+
+				commands.erase(0, pos + 1);
+			}
+		// Обрабатываем команды slave-режима <--
+
+		// Обрабатываем команды -->
+			while(!input.empty())
+			{
+				const Seek_key* key = find_seek_key(input);
+
+				if(key)
+				{
+					position = std::max(0.0, std::min(position + key->seek / 1000.0, options.duration));
+					input.erase(0, strlen(key->value));
+					escape_time = 0;
+					continue;
+				}
+
+				// Стрелки могут прийти по частям, поэтому, прежде чем считать
+				// одиночный ESC (или начало последовательности) нажатием
+				// Escape, ждем продолжения последовательности.
+				if(input[0] == '\x1b' && input.size() < 4 && !stdin_eof)
+				{
+					if(!escape_time)
+						escape_time = get_monotonic_time();
+
+					if(get_monotonic_time() - escape_time < ESCAPE_TIMEOUT)
+						break;
+				}
+
+				escape_time = 0;
+
+				switch(input[0])
+				{
+					case 'q':
+					case '\x1b':
+						write_string("\n\nExiting... (Quit)\n");
+						return EXIT_SUCCESS;
+
+					case 'p':
+					case ' ':
+						paused = !paused;
+						pause_end_time = 0;
+						if(paused)
+							write_string("\n  =====  PAUSE  =====\r\n");
+						break;
+				}
+
+				input.erase(0, 1);
+			}
+		// Обрабатываем команды <--
+	}
+
+	write_string("\n\nExiting... (End of file)\n");
+
+	return EXIT_SUCCESS;
+}
+
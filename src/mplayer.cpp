@@ -20,10 +20,17 @@
 
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#include <deque>
 #include <memory>
 
 #include <boost/noncopyable.hpp>
@@ -31,14 +38,136 @@
 #include <boost/thread.hpp>
 
 #include <sigc++/connection.h>
+#include <sigc++/signal.h>
 #include <sigc++/slot.h>
 
+#include <glib.h>
+
 #include <glibmm/dispatcher.h>
+#include <glibmm/main.h>
 #include <glibmm/regex.h>
 
 #include <mlib/fs.hpp>
+#include <mlib/process.hpp>
+#include <mlib/seqlock.hpp>
 
+#include "latency_stats.hpp"
 #include "mplayer.hpp"
+#include "player_trace.hpp"
+#include "seek_keys.hpp"
+#include "terminal_writer.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Максимальное количество одинаковых идемпотентных команд, которые
+	/// могут одновременно ожидать записи в стандартный ввод MPlayer'а. Все
+	/// последующие повторы (как правило, порождаемые автоповтором клавиш,
+	/// пока MPlayer занят) отбрасываются.
+	const size_t MAX_PENDING_REPEATS = 1;
+
+	/// Команды, повторное выполнение которых ничего не меняет, и поэтому их
+	/// повторы можно отбрасывать. Переключатели (пауза, полноэкранный режим
+	/// и т. п.) сюда попадать не должны.
+	const char* const IDEMPOTENT_COMMANDS[] = {
+		"q",
+		"\x1b",
+		NULL
+	};
+
+	/// Максимальная длина строки вывода MPlayer'а.
+	const size_t MAX_LINE_SIZE = PIPE_BUF;
+
+	/// Максимальный объем вывода MPlayer'а, который читается за один вызов
+	/// обработчика в Main loop'е. Остальное дочитывается на следующих
+	/// итерациях, чтобы не задерживать обработку событий GTK.
+	const size_t MAX_MAIN_LOOP_READ_SIZE = 16 * PIPE_BUF;
+
+	/// Файловый дескриптор, через который MPlayer получает команды
+	/// (-input file=...).
+	const int COMMANDS_FD = 3;
+
+
+
+	/// Проверяет, задает ли пользователь в аргументах MPlayer'а свой файл,
+	/// из которого MPlayer читает команды (-input file=...).
+	bool	has_user_commands_file(const std::vector<std::string>& args);
+
+
+
+	bool has_user_commands_file(const std::vector<std::string>& args)
+	{
+		for(size_t i = 0; i + 1 < args.size(); i++)
+		{
+			if(args[i] != "-input" && args[i] != "--input")
+				continue;
+
+			// Значение опции - список подопций через ':'
+			const std::string& value = args[++i];
+
+			for(size_t pos = 0; pos != std::string::npos; )
+			{
+				if(!value.compare(pos, strlen("file="), "file="))
+					return true;
+
+				pos = value.find(':', pos);
+				if(pos != std::string::npos)
+					pos++;
+			}
+		}
+
+		return false;
+	}
+}
+
+
+
+// Playback_state -->
+	Playback_state::Playback_state(void)
+	:
+		offset(0),
+		offset_timestamp(0),
+		received(0),
+		timestamp(0),
+		emitted(0),
+		paused(false)
+	{
+	}
+
+
+
+	Time_ms Playback_state::get_offset_at(Time_us time) const
+	{
+		if(this->paused || time <= this->offset_timestamp)
+			return this->offset;
+		else
+			return this->offset + (time - this->offset_timestamp) / 1000;
+	}
+// Playback_state <--
+
+
+
+// Stdin_stats -->
+	Stdin_stats::Stdin_stats(void)
+	:
+		queue_depth(0),
+		max_queue_depth(0),
+		coalesced(0),
+		last_latency(0),
+		max_latency(0)
+	{
+	}
+// Stdin_stats <--
+
+
+
+std::string get_player_path(void)
+{
+	const char* path = getenv(PLAYER_ENV_NAME);
+	return path && *path ? path : "mplayer";
+}
 
 
 
@@ -46,6 +175,27 @@ namespace aux {
 
 class Mplayer_impl: public boost::noncopyable
 {
+	private:
+		/// Данные, ожидающие записи в стандартный ввод MPlayer'а.
+		struct Stdin_command
+		{
+			Stdin_command(const std::string& data);
+
+			/// Данные команды.
+			std::string	data;
+
+			/// Время постановки команды в очередь.
+			Time_us		time;
+
+			/// Количество объединенных в данной команде клавиш перемотки (0,
+			/// если команда не является перемоткой).
+			size_t		seeks;
+
+			/// Суммарная величина перемотки.
+			Time_ms		seek;
+		};
+
+
 	public:
 		Mplayer_impl(void);
 		~Mplayer_impl(void);
@@ -57,34 +207,137 @@ class Mplayer_impl: public boost::noncopyable
 		Glib::RefPtr<Glib::Regex>	offset_regex;
 
 
-		/// Блокирует доступ к:
-		///   current_time_offset
-		mutable
-		boost::mutex				mutex;
+		/// Текущее состояние воспроизведения. Изменяется только потоком,
+		/// осуществляющим работу с MPlayer'ом.
+		m::Seqlock<Playback_state>	state;
+
+		/// Последнее опубликованное в state состояние (используется только
+		/// потоком, осуществляющим работу с MPlayer'ом).
+		Playback_state				last_state;
+
+		/// Отличен от нуля, если offset_changed_signal уже был сгенерирован,
+		/// но еще не был обработан в Main loop'е. Позволяет не будить Main
+		/// loop на каждое изменение позиции, если он не успевает их
+		/// обрабатывать.
+		volatile gint				offset_changed_pending;
 
-		/// Текущая позиция в проигрываемом в данный момент файле.
-		Time_ms						current_time_offset;
+		/// Время получения самого старого из состояний, ожидающих обработки
+		/// в Main loop'е (записывается при установке offset_changed_pending
+		/// и читается до его сброса).
+		Time_us						pending_state_time;
 
 
 		/// Сигнал на изменения текущей позиции в проигрываемом файле.
 		Glib::Dispatcher			offset_changed_signal;
 
+		/// Время получения Main loop'ом последнего offset_changed_signal.
+		Time_us						notification_time;
+
+		/// Сигнал на изменения текущей позиции в проигрываемом файле, к
+		/// которому подключаются сторонние обработчики.
+		sigc::signal<void>			time_offset_changed_signal;
+
 		/// Сигнал на завершение работы mplayer'а.
 		Glib::Dispatcher			mplayer_quit_signal;
 
+		/// Сигнал на начало воспроизведения очередного файла.
+		Glib::Dispatcher			file_changed_signal;
+
+		/// Блокирует доступ к:
+		///   playing_file
+		mutable boost::mutex		playing_file_mutex;
+
+		/// Проигрываемый в данный момент файл.
+		std::string					playing_file;
+
+
+		/// Процесс MPlayer'а.
+		m::Process					mplayer_process;
 
 		/// Файловый дескриптор стандатного ввода MPlayer'а.
 		m::File_holder				mplayer_stdin;
 
+		/// Команды, ожидающие записи в стандартный ввод MPlayer'а.
+		std::deque<Stdin_command>	stdin_queue;
+
+		/// Количество уже записанных байт первой команды в stdin_queue.
+		size_t						stdin_queue_written;
+
+		/// Количество одинаковых идемпотентных команд в конце stdin_queue.
+		size_t						stdin_queue_repeats;
+
+		/// Обработчик готовности стандартного ввода MPlayer'а к записи.
+		sigc::connection			stdin_writable_connection;
+
+		/// Статистика записи в стандартный ввод MPlayer'а.
+		Stdin_stats					stdin_stats;
+
 		/// Файловый дескриптор стандатного вывода MPlayer'а.
 		m::File_holder				mplayer_stdout;
 
+		/// Файловый дескриптор pipe'а, через который MPlayer получает
+		/// команды.
+		m::File_holder				mplayer_commands;
+
+		/// Может ли MPlayer получать команды через mplayer_commands.
+		bool						commands_supported;
+
+		/// Данные последней незавершенной строки вывода MPlayer'а.
+		std::string					output;
+
+		/// Время чтения обрабатываемой в данный момент порции вывода
+		/// MPlayer'а.
+		Time_us						output_time;
+
+		/// Записывает трассу вывода MPlayer'а (если запись включена).
+		std::auto_ptr<
+			Player_trace_writer>	trace_writer;
+
+		/// Трасса, которая воспроизводится вместо запуска MPlayer'а.
+		std::auto_ptr<
+			Player_trace_reader>	trace_reader;
+
+		/// Передает вывод MPlayer'а в наш стандартный вывод (создается при
+		/// запуске MPlayer'а).
+		std::auto_ptr<
+			Terminal_writer>		terminal_writer;
+
+		/// Передается ли вывод MPlayer'а (стандартный и стандартный поток
+		/// ошибок) в терминал.
+		bool						terminal_output;
+
 		/// Поток, осуществляющий работу с MPlayer'ом.
 		std::auto_ptr<
 			boost::thread>			mplayer_thread;
 
+		/// Был ли MPlayer уже запущен.
+		bool						started;
+
+		/// Запущен ли вместо MPlayer'а его имитатор (mock_mplayer), который
+		/// сообщает в строках состояния время их вывода.
+		bool						mock_player;
+
+		/// Читается ли вывод MPlayer'а прямо в Main loop'е (без отдельного
+		/// потока).
+		bool						main_loop_io;
+
+		/// Обработчик готовности стандартного вывода MPlayer'а к чтению (при
+		/// чтении в Main loop'е).
+		sigc::connection			stdout_connection;
+
+		/// Обработчик завершения процесса MPlayer'а (при чтении в Main
+		/// loop'е).
+		sigc::connection			exit_connection;
+
 
 	public:
+		/// Возвращает true, если MPlayer'у можно отправлять команды.
+		bool				can_send_commands(void) const;
+
+		/// Подключает обработчик сигнала на начало воспроизведения
+		/// очередного файла.
+		sigc::connection	connect_file_changed_handler(const sigc::slot<void>& slot);
+
 		/// Подключает обработчик сигнала на закрытие MPlayer'а.
 		sigc::connection	connect_quit_handler(const sigc::slot<void>& slot);
 
@@ -92,19 +345,92 @@ class Mplayer_impl: public boost::noncopyable
 		/// проигрываемом файле.
 		sigc::connection	connect_time_offset_changed_handler(const sigc::slot<void>& slot);
 
+		/// Отключает передачу вывода MPlayer'а в терминал.
+		void				disable_terminal_output(void);
+
 		/// Возвращает текущую позицию в проигрываемом файле.
 		Time_ms				get_current_offset(void) const;
 
+		/// Возвращает время получения Main loop'ом последнего уведомления
+		/// об изменении позиции.
+		Time_us				get_notification_time(void) const;
+
+		/// Возвращает текущее состояние воспроизведения.
+		Playback_state		get_playback_state(void) const;
+
+		/// Возвращает путь к проигрываемому в данный момент файлу.
+		std::string			get_playing_file(void) const;
+
+		/// Возвращает статистику записи в стандартный ввод MPlayer'а.
+		Stdin_stats			get_stdin_stats(void) const;
+
+		/// Отправляет MPlayer'у команду.
+		void				send_command(const std::string& command) throw(m::Exception);
+
 		/// Запускает MPlayer.
 		void				start(const std::vector<std::string>& args) throw(m::Exception);
 
-		/// Записывает данные в стандартный поток ввода MPlayer'а.
-		void				write_to_stdio(const void* data, size_t size) throw(m::Exception);
+		/// Ставит данные в очередь на запись в стандартный поток ввода
+		/// MPlayer'а.
+		bool				write_to_stdio(const void* data, size_t size) throw(m::Exception);
 
 	private:
+		/// Записывает в стандартный ввод MPlayer'а столько ожидающих записи
+		/// команд, сколько он может принять без блокирования.
+		void				flush_stdin_queue(void) throw(m::Exception);
+
+		/// Проверяет, прочитал ли MPlayer все, что было записано в его
+		/// стандартный ввод.
+		bool				is_stdin_drained(void) const;
+
+		/// Удаляет из очереди первую команду, записанную в MPlayer.
+		void				pop_stdin_command(void);
+
+		/// Обработчик готовности стандартного ввода MPlayer'а к записи.
+		bool				on_stdin_writable_cb(Glib::IOCondition condition);
+
+		/// Обработчик завершения процесса MPlayer'а (при чтении в Main
+		/// loop'е).
+		bool				on_exit_cb(Glib::IOCondition condition);
+
+		/// Обработчик offset_changed_signal.
+		void				on_offset_changed_cb(void);
+
+		/// Обработчик готовности стандартного вывода MPlayer'а к чтению (при
+		/// чтении в Main loop'е).
+		bool				on_stdout_cb(Glib::IOCondition condition);
+
+		/// Обрабатывает все имеющиеся в данный момент данные из
+		/// стандартного вывода MPlayer'а в Main loop'е.
+		/// @param exited - завершился ли уже процесс MPlayer'а.
+		/// @return - false, если чтение вывода MPlayer'а завершено.
+		bool				process_main_loop_output(bool exited);
+
+		/// Обрабатывает очередную порцию вывода MPlayer'а.
+		void				process_output(const char* data, size_t size) throw(m::Exception);
+
 		/// Обрабатывает полученную от MPlayer'а логическую строку.
 		void				process_string(const std::string& string);
 
+		/// Публикует новое состояние воспроизведения и, если необходимо,
+		/// уведомляет об этом Main loop.
+		void				publish_state(const Playback_state& state);
+
+		/// Читает и обрабатывает все имеющиеся в данный момент данные из
+		/// стандартного вывода MPlayer'а, но не более max_size байт (0 - без
+		/// ограничения).
+		/// @return - false, если достигнут конец файла.
+		bool				read_available_output(size_t max_size = 0) throw(m::Exception);
+
+		/// Читает и обрабатывает вывод MPlayer'а до его завершения.
+		void				read_output(void) throw(m::Exception);
+
+		/// Обрабатывает трассу вывода MPlayer'а вместо его вывода.
+		void				replay_trace(void) throw(m::Exception);
+
+		/// Запускает процесс MPlayer'а.
+		void				spawn(const std::vector<std::string>& args) throw(m::Exception);
+
 
 	public:
 		/// Поток, осуществляющий работу с MPlayer'ом.
@@ -117,7 +443,30 @@ Mplayer_impl::Mplayer_impl(void)
 :
 	offset_regex(Glib::Regex::create(
 		"^A:\\s*(\\d+\\.\\d+)\\s+V:\\s*\\d+\\.\\d+\\s+")),
-	current_time_offset(0)
+	offset_changed_pending(0),
+	pending_state_time(0),
+	notification_time(0),
+	stdin_queue_written(0),
+	stdin_queue_repeats(0),
+	commands_supported(false),
+	output_time(0),
+	terminal_output(true),
+	started(false),
+	mock_player(false),
+	main_loop_io(false)
+{
+	this->offset_changed_signal.connect(
+		sigc::mem_fun(*this, &Mplayer_impl::on_offset_changed_cb));
+}
+
+
+
+Mplayer_impl::Stdin_command::Stdin_command(const std::string& data)
+:
+	data(data),
+	time(m::get_monotonic_time()),
+	seeks(0),
+	seek(0)
 {
 }
 
@@ -125,12 +474,31 @@ Mplayer_impl::Mplayer_impl(void)
 
 Mplayer_impl::~Mplayer_impl(void)
 {
+	this->stdin_writable_connection.disconnect();
+	this->stdout_connection.disconnect();
+	this->exit_connection.disconnect();
+
 	if(this->mplayer_thread.get())
 		this->mplayer_thread->join();
 }
 
 
 
+bool Mplayer_impl::can_send_commands(void) const
+{
+	// При воспроизведении трассы команды просто отбрасываются
+	return this->trace_reader.get() || this->commands_supported;
+}
+
+
+
+sigc::connection Mplayer_impl::connect_file_changed_handler(const sigc::slot<void>& slot)
+{
+	return this->file_changed_signal.connect(slot);
+}
+
+
+
 sigc::connection Mplayer_impl::connect_quit_handler(const sigc::slot<void>& slot)
 {
 	return this->mplayer_quit_signal.connect(slot);
@@ -140,15 +508,251 @@ sigc::connection Mplayer_impl::connect_quit_handler(const sigc::slot<void>& slot
 
 sigc::connection Mplayer_impl::connect_time_offset_changed_handler(const sigc::slot<void>& slot)
 {
-	return this->offset_changed_signal.connect(slot);
+	return this->time_offset_changed_signal.connect(slot);
+}
+
+
+
+void Mplayer_impl::disable_terminal_output(void)
+{
+	this->terminal_output = false;
 }
 
 
 
 Time_ms Mplayer_impl::get_current_offset(void) const
 {
-	boost::mutex::scoped_lock lock(this->mutex);
-	return this->current_time_offset;
+	return this->state.load().offset;
+}
+
+
+
+Time_us Mplayer_impl::get_notification_time(void) const
+{
+	return this->notification_time;
+}
+
+
+
+Playback_state Mplayer_impl::get_playback_state(void) const
+{
+	return this->state.load();
+}
+
+
+
+std::string Mplayer_impl::get_playing_file(void) const
+{
+	boost::mutex::scoped_lock lock(this->playing_file_mutex);
+	return this->playing_file;
+}
+
+
+
+Stdin_stats Mplayer_impl::get_stdin_stats(void) const
+{
+	Stdin_stats stats = this->stdin_stats;
+	stats.queue_depth = this->stdin_queue.size();
+	return stats;
+}
+
+
+
+void Mplayer_impl::send_command(const std::string& command) throw(m::Exception)
+{
+	// При воспроизведении трассы передавать команды некому
+	if(this->trace_reader.get())
+		return;
+
+	if(!this->started)
+		M_THROW(_("MPlayer is not started."));
+
+	if(!this->commands_supported)
+		M_THROW(_("MPlayer reads its commands from the file specified by the user's -input file=... option."));
+
+	std::string data = command + "\n";
+
+	MLIB_D(_C("Sending command '%1' to MPlayer...", command));
+
+	// Команды короче PIPE_BUF записываются атомарно, а pipe может
+	// переполниться, только если MPlayer перестал читать команды.
+	// Генерирует m::Exception
+	if(m::fs::unix_write(this->mplayer_commands.get(), data.data(), data.size(), true) != static_cast<ssize_t>(data.size()))
+		M_THROW(_("MPlayer doesn't read its commands."));
+}
+
+
+
+void Mplayer_impl::flush_stdin_queue(void) throw(m::Exception)
+{
+	if(this->stdin_queue.empty())
+		return;
+
+	TRACE_SPAN("write_stdin");
+
+	while(!this->stdin_queue.empty())
+	{
+		// Несколько клавиш перемотки, накопившихся, пока MPlayer был занят,
+		// передаем одной командой перемотки на их суммарную величину.
+		// MPlayer читает стандартный ввод и файл команд независимо друг от
+		// друга, поэтому команда отправляется, только если он уже прочитал
+		// все предшествующие ей клавиши - иначе она может быть выполнена
+		// раньше них, и клавиши перемотки записываются как есть.
+		// -->
+			if(
+				this->stdin_queue.front().seeks > 1 && !this->stdin_queue_written &&
+				this->commands_supported && this->is_stdin_drained()
+			)
+			{
+				const Stdin_command& command = this->stdin_queue.front();
+
+				// Форматируем величину перемотки без использования чисел с
+				// плавающей точкой, т. к. их формат зависит от текущей локали.
+				char seek_command[64];
+				snprintf(seek_command, sizeof seek_command, "seek %s%lld.%03lld 0",
+					command.seek < 0 ? "-" : "",
+					static_cast<long long>(llabs(command.seek) / 1000),
+					static_cast<long long>(llabs(command.seek) % 1000));
+
+				MLIB_D(_C("Merging %1 MPlayer seek keys into one seek.", command.seeks));
+
+				// Генерирует m::Exception
+				this->send_command(seek_command);
+
+				this->stdin_stats.coalesced += command.seeks - 1;
+				this->pop_stdin_command();
+				continue;
+			}
+		// <--
+
+		// Записываем все ожидающие команды до ближайшей объединенной
+		// перемотки одним вызовом write() -->
+			std::string data;
+			size_t written;
+			bool full;
+
+			M_FOR_CONST_IT(this->stdin_queue, it)
+			{
+				if(it != this->stdin_queue.begin() && it->seeks > 1 && this->commands_supported)
+					break;
+
+				data += it->data;
+			}
+
+			data.erase(0, this->stdin_queue_written);
+
+			// Генерирует m::Exception
+			written = m::fs::unix_write(this->mplayer_stdin.get(), data.data(), data.size(), true);
+			full = written < data.size();
+		// Записываем все ожидающие команды до ближайшей объединенной
+		// перемотки одним вызовом write() <--
+
+		// Удаляем из очереди записанные команды -->
+			written += this->stdin_queue_written;
+
+			while(!this->stdin_queue.empty() && written >= this->stdin_queue.front().data.size())
+			{
+				written -= this->stdin_queue.front().data.size();
+				this->pop_stdin_command();
+			}
+
+			this->stdin_queue_written = written;
+		// Удаляем из очереди записанные команды <--
+
+		if(full)
+			break;
+	}
+
+	this->stdin_queue_repeats = std::min(this->stdin_queue_repeats, this->stdin_queue.size());
+
+	// Если MPlayer не может принять все данные сразу, то дописываем их, когда
+	// он будет к этому готов.
+	if(!this->stdin_queue.empty() && !this->stdin_writable_connection.connected())
+	{
+		MLIB_D(_C("MPlayer's stdin is full, %1 commands are waiting.", this->stdin_queue.size()));
+
+		this->stdin_writable_connection = Glib::signal_io().connect(
+			sigc::mem_fun(*this, &Mplayer_impl::on_stdin_writable_cb),
+			this->mplayer_stdin.get(), Glib::IO_OUT | Glib::IO_ERR | Glib::IO_HUP
+		);
+	}
+}
+
+
+
+void Mplayer_impl::pop_stdin_command(void)
+{
+	Time_us latency = m::get_monotonic_time() - this->stdin_queue.front().time;
+
+	this->stdin_stats.last_latency = latency;
+	this->stdin_stats.max_latency = std::max(this->stdin_stats.max_latency, latency);
+
+	this->stdin_queue.pop_front();
+}
+
+
+
+bool Mplayer_impl::is_stdin_drained(void) const
+{
+	int size;
+
+	if(ioctl(this->mplayer_stdin.get(), FIONREAD, &size))
+	{
+		MLIB_D(_C("Unable to get MPlayer's stdin pipe size: %1.", EE(errno)));
+		return false;
+	}
+
+	return !size;
+}
+
+
+
+bool Mplayer_impl::on_stdin_writable_cb(Glib::IOCondition condition)
+{
+	try
+	{
+		this->flush_stdin_queue();
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_SW(__("Unable to write data to the mplayer stdio: %1.", EE(e)));
+		this->stdin_queue.clear();
+		this->stdin_queue_written = 0;
+		this->stdin_queue_repeats = 0;
+	}
+
+	if(this->stdin_queue.empty())
+	{
+		MLIB_D(_C("MPlayer's stdin queue has been flushed (latency: %1 us).", this->stdin_stats.last_latency));
+		return false;
+	}
+	else
+		return true;
+}
+
+
+
+bool Mplayer_impl::on_exit_cb(Glib::IOCondition condition)
+{
+	return this->process_main_loop_output(true);
+}
+
+
+
+void Mplayer_impl::on_offset_changed_cb(void)
+{
+	TRACE_SPAN("offset_changed");
+
+	this->notification_time = m::get_monotonic_time();
+
+	// Измеряем задержку от самого старого из объединенных состояний, иначе
+	// время их ожидания в очереди не будет учтено.
+	record_latency(LATENCY_DISPATCH, this->notification_time - this->pending_state_time);
+
+	// Сбрасываем флаг до того, как обработчики получат состояние: если
+	// после этого оно изменится, то будет сгенерирован новый сигнал.
+	g_atomic_int_set(&this->offset_changed_pending, 0);
+	this->time_offset_changed_signal();
 }
 
 
@@ -156,6 +760,7 @@ Time_ms Mplayer_impl::get_current_offset(void) const
 void Mplayer_impl::process_string(const std::string& string)
 {
 	Time_ms offset;
+	Playback_state state = this->last_state;
 
 
 	Glib::StringArrayHandle matches = this->offset_regex->split(string);
@@ -163,6 +768,36 @@ void Mplayer_impl::process_string(const std::string& string)
 	if(matches.size() < 2)
 	{
 		MLIB_D(_C("Gotten non-time-offset MPlayer output string '%1'.", string));
+
+		if(string.find("=====  PAUSE  =====") != std::string::npos)
+		{
+			MLIB_D("MPlayer has been paused.");
+
+			state.paused = true;
+			state.received = this->output_time;
+			state.timestamp = m::get_monotonic_time();
+			state.emitted = state.timestamp;
+			this->publish_state(state);
+		}
+		// MPlayer сообщает о начале воспроизведения каждого файла строкой
+		// "Playing <путь к файлу>."
+		else if(
+			string.size() > strlen("Playing .") && !string.compare(0, strlen("Playing "), "Playing ") &&
+			string[string.size() - 1] == '.'
+		)
+		{
+			std::string file = L2U(string.substr(strlen("Playing "), string.size() - strlen("Playing .")));
+
+			MLIB_D(_C("MPlayer has started playing '%1'.", file));
+
+			{
+				boost::mutex::scoped_lock lock(this->playing_file_mutex);
+				this->playing_file = file;
+			}
+
+			this->file_changed_signal();
+		}
+
 		return;
 	}
 
@@ -178,91 +813,316 @@ void Mplayer_impl::process_string(const std::string& string)
 	MLIB_D(_C("Gotten cur time offset: %1.", offset));
 
 
+	state.offset = offset;
+	state.received = this->output_time;
+	state.timestamp = m::get_monotonic_time();
+	state.emitted = state.timestamp;
+	state.paused = false;
+
+	// Если MPlayer повторно сообщает ту же позицию, то она была получена
+	// раньше.
+	if(offset != this->last_state.offset || this->last_state.paused || !this->last_state.offset_timestamp)
+		state.offset_timestamp = state.timestamp;
+
+	// Имитатор MPlayer'а сообщает время вывода строки -->
+	if(this->mock_player)
 	{
-		bool changed;
+		size_t pos = string.rfind(" T:");
 
+		if(pos != std::string::npos)
 		{
-			boost::mutex::scoped_lock lock(this->mutex);
-			changed = offset != this->current_time_offset;
-			this->current_time_offset = offset;
-		}
+			Time_us emitted = strtoll(string.c_str() + pos + 3, NULL, 10);
 
-		if(changed)
-			this->offset_changed_signal();
+			if(emitted > 0 && emitted <= state.timestamp)
+				state.emitted = emitted;
+		}
 	}
+	// Имитатор MPlayer'а сообщает время вывода строки <--
+
+	record_latency(LATENCY_PARSE, state.timestamp - state.received);
+	this->publish_state(state);
 }
 
 
 
-void Mplayer_impl::start(const std::vector<std::string>& args) throw(m::Exception)
+void Mplayer_impl::publish_state(const Playback_state& state)
 {
-	if(this->mplayer_thread.get())
-		M_THROW(_("MPlayer is already started."));
+	bool changed =
+		state.offset != this->last_state.offset ||
+		state.paused != this->last_state.paused;
+
+	// Время получения позиции публикуем всегда, чтобы по нему можно было
+	// вычислять текущую позицию между выводами MPlayer'а.
+	this->last_state = state;
+	this->state.store(state);
+
+	// При чтении в Main loop'е уведомление отправляется после обработки
+	// всей прочитанной порции вывода.
+	if(changed && g_atomic_int_compare_and_exchange(&this->offset_changed_pending, 0, 1))
+	{
+		this->pending_state_time = state.timestamp;
+
+		if(!this->main_loop_io)
+			this->offset_changed_signal();
+	}
+}
 
 
+
+void Mplayer_impl::spawn(const std::vector<std::string>& args) throw(m::Exception)
+{
+	long flags;
 	m::File_holder child_stdin;
 	m::File_holder child_stdout;
+	m::File_holder child_commands;
+	m::File_holder child_stderr;
+
+	// MPlayer читает команды только из одного файла, поэтому, если
+	// пользователь задал свой (например, FIFO для LIRC), отправлять команды
+	// мы не сможем.
+	this->commands_supported = !has_user_commands_file(args);
+
+	if(!this->commands_supported)
+		MLIB_SW(_("MPlayer's -input file=... option is specified, so subtitle replay and seeking to search results are disabled."));
 
 	// Создаем средства коммуникации между MPlayer'ом и нашей программой -->
 	{
 		// Генерирует m::Exception
-		std::pair<int, int> pipe_fds = m::unix_pipe();
+		std::pair<int, int> pipe_fds = m::unix_pipe(O_CLOEXEC);
 		this->mplayer_stdin.set(pipe_fds.second);
 		child_stdin.set(pipe_fds.first);
+
+		// Запись в стандартный ввод MPlayer'а никогда не должна блокировать
+		// Main loop.
+		if(
+			( flags = fcntl(this->mplayer_stdin.get(), F_GETFL) ) == -1 ||
+			fcntl(this->mplayer_stdin.get(), F_SETFL, flags | O_NONBLOCK) == -1
+		)
+			M_THROW(__("Can't set flags for a pipe: %1.", EE(errno)));
 	}
 	{
 		// Генерирует m::Exception
-		std::pair<int, int> pipe_fds = m::unix_pipe();
+		std::pair<int, int> pipe_fds = m::unix_pipe(O_CLOEXEC);
 		this->mplayer_stdout.set(pipe_fds.first);
 		child_stdout.set(pipe_fds.second);
+
+		// Весь вывод, имеющийся на данный момент, вычитывается без
+		// блокирования.
+		if(
+			( flags = fcntl(this->mplayer_stdout.get(), F_GETFL) ) == -1 ||
+			fcntl(this->mplayer_stdout.get(), F_SETFL, flags | O_NONBLOCK) == -1
+		)
+			M_THROW(__("Can't set flags for a pipe: %1.", EE(errno)));
+	}
+	if(this->commands_supported)
+	{
+		// Генерирует m::Exception
+		std::pair<int, int> pipe_fds = m::unix_pipe(O_CLOEXEC);
+		this->mplayer_commands.set(pipe_fds.second);
+		child_commands.set(pipe_fds.first);
+
+		if(
+			( flags = fcntl(this->mplayer_commands.get(), F_GETFL) ) == -1 ||
+			fcntl(this->mplayer_commands.get(), F_SETFL, flags | O_NONBLOCK) == -1
+		)
+			M_THROW(__("Can't set flags for a pipe: %1.", EE(errno)));
 	}
 	// Создаем средства коммуникации между MPlayer'ом и нашей программой <--
 
-	if(m::unix_fork())
+	// Запускаем MPlayer -->
+		this->mplayer_process.redirect(child_stdin.get(), STDIN_FILENO);
+		this->mplayer_process.redirect(child_stdout.get(), STDOUT_FILENO);
+		if(this->commands_supported)
+			this->mplayer_process.redirect(child_commands.get(), COMMANDS_FD);
+
+		if(!this->terminal_output)
+		{
+			try
+			{
+				child_stderr.set(m::fs::unix_open("/dev/null", O_WRONLY | O_CLOEXEC));
+				this->mplayer_process.redirect(child_stderr.get(), STDERR_FILENO);
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_SW(__("Can't redirect MPlayer's stderr: %1.", EE(e)));
+			}
+		}
+
+		try
+		{
+		#ifdef DEBUG_MODE
+			Time_us start_time = m::get_monotonic_time();
+		#endif
+
+			std::vector<std::string> mplayer_args;
+
+			if(this->commands_supported)
+			{
+				mplayer_args.push_back("-input");
+				mplayer_args.push_back(_C("file=/dev/fd/%1", COMMANDS_FD));
+			}
+
+			mplayer_args.insert(mplayer_args.end(), args.begin(), args.end());
+
+			this->mplayer_process.spawn(get_player_path(), mplayer_args);
+
+			MLIB_D(_C("MPlayer has been spawned in %1 us.", m::get_monotonic_time() - start_time));
+		}
+		catch(m::Exception& e)
+		{
+			M_THROW(__("Starting MPlayer failed: %1.", EE(e)));
+		}
+	// Запускаем MPlayer <--
+}
+
+
+
+void Mplayer_impl::start(const std::vector<std::string>& args) throw(m::Exception)
+{
+	if(this->started)
+		M_THROW(_("MPlayer is already started."));
+
+	// Время вывода строк состояния сообщает только имитатор MPlayer'а,
+	// поэтому не тратим время на его поиск в выводе настоящего MPlayer'а.
 	{
-		// Родительский процесс
+		std::string player_path = get_player_path();
+		size_t name_pos = player_path.rfind('/');
 
-		this->mplayer_thread = std::auto_ptr<boost::thread>(
-			new boost::thread(boost::ref(*this))
-		);
+		this->mock_player = player_path.substr(
+			name_pos == std::string::npos ? 0 : name_pos + 1) == "mock_mplayer";
+	}
+
+	if(const char* replay_path = getenv(REPLAY_ENV_NAME))
+	{
+		MLIB_D(_C("Replaying player trace '%1' instead of starting MPlayer...", replay_path));
+
+		// Генерирует m::Exception
+		this->trace_reader.reset(new Player_trace_reader(L2U(replay_path)));
 	}
 	else
 	{
-		// Дочерний процесс
+		// Генерирует m::Exception
+		this->spawn(args);
 
-		try
+		if(const char* record_path = getenv(RECORD_ENV_NAME))
 		{
-			// Генерирует m::Exception
-			m::unix_dup(child_stdin.get(), STDIN_FILENO);
-			child_stdin.reset();
-
-			// Генерирует m::Exception
-			m::unix_dup(child_stdout.get(), STDOUT_FILENO);
-			child_stdout.reset();
+			MLIB_D(_C("Recording MPlayer output to '%1'...", record_path));
 
-			// Закрываем все открытые файловые дескрипторы
 			// Генерирует m::Exception
-			m::close_all_fds();
-
-			// Генерирует m::Sys_exception
-			m::unix_execvp("mplayer", args);
+			this->trace_writer.reset(new Player_trace_writer(L2U(record_path)));
 		}
-		catch(m::Sys_exception& e)
+
+		if(const char* io_mode = getenv(IO_MODE_ENV_NAME))
 		{
-			MLIB_W(__("Starting MPlayer failed: %1.", EE(e)));
+			if(!strcmp(io_mode, "main-loop"))
+				this->main_loop_io = true;
+			else if(strcmp(io_mode, "thread"))
+				M_THROW(__("Invalid %1 value: '%2'.", IO_MODE_ENV_NAME, io_mode));
 		}
-		catch(m::Exception& e)
+
+		// При чтении в Main loop'е отдельный поток для записи в терминал не
+		// нужен: все, что было прочитано за один вызов обработчика,
+		// записывается без блокирования сразу после его обработки.
+		this->terminal_writer.reset(new Terminal_writer(STDOUT_FILENO, !this->main_loop_io));
+	}
+
+	this->started = true;
+
+	if(this->main_loop_io)
+	{
+		MLIB_D("Reading MPlayer output in the main loop.");
+
+		this->stdout_connection = Glib::signal_io().connect(
+			sigc::mem_fun(*this, &Mplayer_impl::on_stdout_cb),
+			this->mplayer_stdout.get(), Glib::IO_IN | Glib::IO_ERR | Glib::IO_HUP
+		);
+
+		if(this->mplayer_process.get_pidfd() >= 0)
 		{
-			MLIB_W(__("Starting MPlayer failed. %1", EE(e)));
+			this->exit_connection = Glib::signal_io().connect(
+				sigc::mem_fun(*this, &Mplayer_impl::on_exit_cb),
+				this->mplayer_process.get_pidfd(), Glib::IO_IN
+			);
 		}
 	}
+	else
+	{
+		this->mplayer_thread = std::auto_ptr<boost::thread>(
+			new boost::thread(boost::ref(*this))
+		);
+	}
 }
 
 
 
-void Mplayer_impl::write_to_stdio(const void* data, size_t size) throw(m::Exception)
+bool Mplayer_impl::write_to_stdio(const void* data, size_t size) throw(m::Exception)
 {
-	m::fs::unix_write(this->mplayer_stdin.get(), data, size);
+	// При воспроизведении трассы передавать команды некому
+	if(this->trace_reader.get())
+		return true;
+
+	std::string command(static_cast<const char*>(data), size);
+	const Seek_key* seek_key = find_seek_key(command);
+
+	if(seek_key && strlen(seek_key->value) != command.size())
+		seek_key = NULL;
+
+	// Объединяем перемотку с перемоткой, которую MPlayer еще не успел
+	// прочитать.
+	if(
+		seek_key && !this->stdin_queue.empty() && this->stdin_queue.back().seeks &&
+		!( this->stdin_queue.size() == 1 && this->stdin_queue_written )
+	)
+	{
+		Stdin_command& last = this->stdin_queue.back();
+
+		last.data += command;
+		last.seeks++;
+		last.seek += seek_key->seek;
+
+		MLIB_D(_C("Merging MPlayer seek command (%1 commands are waiting).", this->stdin_queue.size()));
+		return true;
+	}
+
+	// Отбрасываем повторы идемпотентных команд, которые MPlayer еще не
+	// успел прочитать -->
+	{
+		bool idempotent = false;
+
+		for(const char* const* it = IDEMPOTENT_COMMANDS; *it && !idempotent; it++)
+			idempotent = command == *it;
+
+		if(idempotent && !this->stdin_queue.empty() && this->stdin_queue.back().data == command)
+		{
+			if(this->stdin_queue_repeats >= MAX_PENDING_REPEATS)
+			{
+				this->stdin_stats.coalesced++;
+				MLIB_D(_C("Coalescing repeated MPlayer command (%1 commands are waiting).", this->stdin_queue.size()));
+				return false;
+			}
+
+			this->stdin_queue_repeats++;
+		}
+		else
+			this->stdin_queue_repeats = idempotent ? 1 : 0;
+	}
+	// Отбрасываем повторы идемпотентных команд, которые MPlayer еще не
+	// успел прочитать <--
+
+	this->stdin_queue.push_back(Stdin_command(command));
+
+	if(seek_key)
+	{
+		this->stdin_queue.back().seeks = 1;
+		this->stdin_queue.back().seek = seek_key->seek;
+	}
+
+	this->stdin_stats.max_queue_depth = std::max(this->stdin_stats.max_queue_depth, this->stdin_queue.size());
+
+	// Генерирует m::Exception
+	this->flush_stdin_queue();
+
+	return true;
 }
 
 
@@ -271,97 +1131,246 @@ void Mplayer_impl::operator()(void)
 {
 	try
 	{
-		long flags;
-		int read_fd = this->mplayer_stdout.get();
+		if(this->trace_reader.get())
+			this->replay_trace();
+		else
+			this->read_output();
 
-		char byte;
-		char buf[PIPE_BUF];
-		ssize_t readed_bytes;
-		std::string output;
+		this->mplayer_quit_signal();
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_W(__("Error while reading MPlayer output: %1.", EE(e)));
+	}
+}
+
+
+
+bool Mplayer_impl::on_stdout_cb(Glib::IOCondition condition)
+{
+	return this->process_main_loop_output(false);
+}
 
 
-		if( ( flags = fcntl(read_fd, F_GETFL) ) == -1 )
-			MLIB_E(__("Can't get flags for a pipe: %1.", EE(errno)));
 
-		// Ждем, пока MPlayer выдаст какие-либо данные
-		while(m::fs::unix_read(read_fd, &byte, sizeof byte))
+bool Mplayer_impl::process_main_loop_output(bool exited)
+{
+	bool eof = true;
+
+	try
+	{
+		// После завершения MPlayer'а дочитываем весь оставшийся вывод.
+		eof = !this->read_available_output(exited ? 0 : MAX_MAIN_LOOP_READ_SIZE) || exited;
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_W(__("Error while reading MPlayer output: %1.", EE(e)));
+	}
+
+	this->terminal_writer->flush();
+
+	// Все строки состояния из прочитанной порции вывода порождают не более
+	// одного уведомления.
+	if(g_atomic_int_get(&this->offset_changed_pending))
+		this->on_offset_changed_cb();
+
+	if(!eof)
+		return true;
+
+	this->stdout_connection.disconnect();
+	this->exit_connection.disconnect();
+
+	if(this->mplayer_process.wait(false))
+		MLIB_D(_C("MPlayer exited with status %1.", this->mplayer_process.get_status()));
+
+	// Обработчики могут уничтожить этот объект, поэтому вызываем их уже
+	// после возврата в Main loop.
+	this->mplayer_quit_signal();
+
+	return false;
+}
+
+
+
+void Mplayer_impl::process_output(const char* data, size_t size) throw(m::Exception)
+{
+	size_t start_pos = 0;
+
+	this->output.append(data, size);
+	data = this->output.data();
+	size = this->output.size();
+
+	for(size_t i = 0; i < size; i++)
+	{
+		switch(data[i])
+		{
+			// В зависимости от типа терминала MPlayer по разному
+			// разделяет строки + прибавляет различные управляющие
+			// символы.
+			case '\r':
+			case '\n':
+				if(start_pos != i)
+					this->process_string(std::string(data + start_pos, data + i));
+				start_pos = i + 1;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	// Вырезаем обработанные данные
+	if(start_pos)
+		this->output.erase(0, start_pos);
+
+	if(this->output.size() > MAX_LINE_SIZE)
+		M_THROW(__("invalid output - no any line delimiter over %1 bytes", this->output.size()));
+}
+
+
+
+bool Mplayer_impl::read_available_output(size_t max_size) throw(m::Exception)
+{
+	int read_fd = this->mplayer_stdout.get();
+
+	char buf[PIPE_BUF];
+	ssize_t readed_bytes;
+	size_t total_size = 0;
+
+	TRACE_SPAN("read_output");
+
+#ifndef DEVELOP_MODE
+	// Количество байт, которые уже были переданы в стандартный вывод без
+	// копирования.
+	size_t passed_bytes = this->terminal_output ? this->terminal_writer->tee(read_fd) : 0;
+#endif
+
+	while( (readed_bytes = m::fs::unix_read(read_fd, buf, sizeof buf, true)) )
+	{
+		this->output_time = m::get_monotonic_time();
+
+	#ifndef DEVELOP_MODE
+		size_t skip_bytes = std::min<size_t>(passed_bytes, readed_bytes);
+		passed_bytes -= skip_bytes;
+
+		if(this->terminal_output && static_cast<size_t>(readed_bytes) > skip_bytes)
+			this->terminal_writer->write(buf + skip_bytes, readed_bytes - skip_bytes);
+	#endif
+
+		if(this->trace_writer.get())
 		{
-		#ifndef DEVELOP_MODE
 			try
 			{
-				m::fs::unix_write(STDOUT_FILENO, &byte, sizeof byte);
+				this->trace_writer->write(this->output_time, buf, readed_bytes);
 			}
 			catch(m::Exception& e)
 			{
-				MLIB_W(__("Can't write data to stdout: %1.", EE(e)));
+				MLIB_SW(EE(e));
+				this->trace_writer.reset();
 			}
-		#endif
-			output += byte;
-
-			// Получаем все данные, которые есть на данный момент -->
-				if(fcntl(read_fd, F_SETFL, flags | O_NONBLOCK) == -1)
-					MLIB_E(__("Can't set flags for a pipe: %1.", strerror(errno)));
-
-				while( (readed_bytes = m::fs::unix_read(read_fd, buf, sizeof buf, true)) )
-				{
-					#ifndef DEVELOP_MODE
-						try
-						{
-							m::fs::unix_write(STDOUT_FILENO, buf, readed_bytes);
-						}
-						catch(m::Exception& e)
-						{
-							MLIB_W(__("Can't write data to stdout: %1.", EE(e)));
-						}
-					#endif
-					output.append(buf, readed_bytes);
-				}
-
-				if(fcntl(read_fd, F_SETFL, flags) == -1)
-					MLIB_E(__("Can't set flags for a pipe: %1.", strerror(errno)));
-			// Получаем все данные, которые есть на данный момент <--
-
-			// Построчно обрабатываем полученные данные -->
+		}
+
+		this->process_output(buf, readed_bytes);
+
+		total_size += readed_bytes;
+		if(max_size && total_size >= max_size)
+			return true;
+	}
+
+	// m::fs::unix_read() сбрасывает errno в 0 при достижении конца файла
+	return errno != 0;
+}
+
+
+
+void Mplayer_impl::read_output(void) throw(m::Exception)
+{
+	int read_fd = this->mplayer_stdout.get();
+	bool eof = false;
+
+	while(!eof)
+	{
+		// Завершился ли процесс MPlayer'а.
+		bool exited = false;
+
+		// Ждем, пока MPlayer выдаст какие-либо данные или завершится -->
+		{
+			struct pollfd poll_fds[2];
+			nfds_t poll_fds_num = 1;
+
+			poll_fds[0].fd = read_fd;
+			poll_fds[0].events = POLLIN;
+
+			if(this->mplayer_process.get_pidfd() >= 0)
+			{
+				poll_fds[1].fd = this->mplayer_process.get_pidfd();
+				poll_fds[1].events = POLLIN;
+				poll_fds_num++;
+			}
+
+			while(poll(poll_fds, poll_fds_num, -1) < 0)
 			{
-				const char* data = output.data();
-				size_t size = output.size();
-				size_t start_pos = 0;
-
-				for(size_t i = 0; i < size; i++)
-				{
-					switch(data[i])
-					{
-						// В зависимости от типа терминала MPlayer по разному
-						// разделяет строки + прибавляет различные управляющие
-						// символы.
-						case '\r':
-						case '\n':
-							if(start_pos != i)
-								this->process_string(std::string(data + start_pos, data + i));
-							start_pos = i + 1;
-							break;
-
-						default:
-							break;
-					}
-				}
-
-				// Вырезаем обработанные данные
-				if(start_pos)
-					output.erase(0, start_pos);
+				if(errno != EINTR)
+					M_THROW(__("can't poll a pipe: %1", EE(errno)));
 			}
-			// Построчно обрабатываем полученные данные <--
 
-			if(output.size() > sizeof buf)
-				M_THROW(__("invalid output - no any line delimiter over %1 bytes", output.size()));
+			// Если MPlayer завершился, то все, что он успел вывести, уже
+			// находится в pipe'е - дочитываем это и завершаем работу, не
+			// дожидаясь закрытия pipe'а (он может остаться открытым в
+			// порожденных MPlayer'ом процессах).
+			exited = poll_fds_num > 1 && poll_fds[1].revents;
 		}
+		// Ждем, пока MPlayer выдаст какие-либо данные или завершится <--
 
-		this->mplayer_quit_signal();
+		eof = !this->read_available_output() || exited;
 	}
-	catch(m::Exception& e)
+
+	if(this->mplayer_process.wait(false))
+		MLIB_D(_C("MPlayer exited with status %1.", this->mplayer_process.get_status()));
+}
+
+
+
+void Mplayer_impl::replay_trace(void) throw(m::Exception)
+{
+	double speed = 1;
+	Time_us start_time = m::get_monotonic_time();
+
+	Time_us time;
+	std::string data;
+	size_t records = 0;
+
+
+	if(const char* speed_string = getenv(REPLAY_SPEED_ENV_NAME))
 	{
-		MLIB_W(__("Error while reading MPlayer output: %1.", EE(e)));
+		char* end;
+		speed = strtod(speed_string, &end);
+
+		if(!*speed_string || *end || speed < 0)
+			M_THROW(__("Invalid %1 value: '%2'", REPLAY_SPEED_ENV_NAME, speed_string));
 	}
+
+	while(this->trace_reader->read(&time, &data))
+	{
+		// Выдерживаем интервалы между порциями данных так, как они были
+		// получены от MPlayer'а.
+		if(speed)
+		{
+			Time_us delay = start_time + static_cast<Time_us>(time / speed) - m::get_monotonic_time();
+
+			if(delay > 0)
+				usleep(delay);
+		}
+
+		this->output_time = m::get_monotonic_time();
+		this->process_output(data.data(), data.size());
+		records++;
+	}
+
+	// Вызывается из потока, осуществляющего работу с MPlayer'ом, во время
+	// работы Main loop'а, поэтому выводим только отладочное сообщение.
+	MLIB_D(_C("Player trace has been replayed: %1 records in %2 us.",
+		records, m::get_monotonic_time() - start_time));
 }
 
 }
@@ -377,6 +1386,20 @@ void Mplayer_impl::operator()(void)
 
 
 
+	bool Mplayer::can_send_commands(void) const
+	{
+		return this->impl->can_send_commands();
+	}
+
+
+
+	sigc::connection Mplayer::connect_file_changed_handler(const sigc::slot<void>& slot)
+	{
+		return this->impl->connect_file_changed_handler(slot);
+	}
+
+
+
 	sigc::connection Mplayer::connect_quit_handler(const sigc::slot<void>& slot)
 	{
 		return this->impl->connect_quit_handler(slot);
@@ -391,6 +1414,13 @@ void Mplayer_impl::operator()(void)
 
 
 
+	void Mplayer::disable_terminal_output(void)
+	{
+		this->impl->disable_terminal_output();
+	}
+
+
+
 	Time_ms Mplayer::get_current_offset(void) const
 	{
 		return this->impl->get_current_offset();
@@ -398,6 +1428,27 @@ void Mplayer_impl::operator()(void)
 
 
 
+	Time_us Mplayer::get_notification_time(void) const
+	{
+		return this->impl->get_notification_time();
+	}
+
+
+
+	Playback_state Mplayer::get_playback_state(void) const
+	{
+		return this->impl->get_playback_state();
+	}
+
+
+
+	std::string Mplayer::get_playing_file(void) const
+	{
+		return this->impl->get_playing_file();
+	}
+
+
+
 	void Mplayer::start(const std::vector<std::string>& args) throw(m::Exception)
 	{
 		this->impl->start(args);
@@ -405,9 +1456,23 @@ void Mplayer_impl::operator()(void)
 
 
 
-	void Mplayer::write_to_stdio(const void* data, size_t size) throw(m::Exception)
+	Stdin_stats Mplayer::get_stdin_stats(void) const
+	{
+		return this->impl->get_stdin_stats();
+	}
+
+
+
+	void Mplayer::send_command(const std::string& command) throw(m::Exception)
+	{
+		this->impl->send_command(command);
+	}
+
+
+
+	bool Mplayer::write_to_stdio(const void* data, size_t size) throw(m::Exception)
 	{
-		this->impl->write_to_stdio(data, size);
+		return this->impl->write_to_stdio(data, size);
 	}
 
 // Mplayer <--
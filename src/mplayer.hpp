@@ -31,6 +31,82 @@
 
 	namespace aux { class Mplayer_impl; }
 
+
+	/// Переменная окружения, задающая путь к исполняемому файлу плеера
+	/// (например, к имитатору MPlayer'а mock_mplayer).
+	#define PLAYER_ENV_NAME "SUBMPLAYER_PLAYER"
+
+	/// Переменная окружения, задающая способ чтения вывода плеера: "thread"
+	/// (по умолчанию) - отдельным потоком, "main-loop" - прямо в Main loop'е,
+	/// без дополнительного потока и межпоточной синхронизации.
+	#define IO_MODE_ENV_NAME "SUBMPLAYER_IO"
+
+
+	/// Состояние воспроизведения, о котором сообщает MPlayer.
+	struct Playback_state
+	{
+		Playback_state(void);
+
+		/// Возвращает позицию, интерполированную на момент time (по
+		/// монотонным часам).
+		Time_ms	get_offset_at(Time_us time) const;
+
+		/// Текущая позиция в проигрываемом файле.
+		Time_ms	offset;
+
+		/// Время (по монотонным часам), в которое MPlayer впервые сообщил
+		/// текущую позицию. MPlayer выводит позицию с точностью до 0.1
+		/// секунды, поэтому точнее всего интерполировать ее от момента ее
+		/// изменения, а не от момента получения последней строки состояния.
+		Time_us	offset_timestamp;
+
+		/// Время (по монотонным часам), в которое были прочитаны данные,
+		/// содержащие позицию.
+		Time_us	received;
+
+		/// Время (по монотонным часам), в которое была получена позиция.
+		Time_us	timestamp;
+
+		/// Время (по монотонным часам), в которое плеер вывел позицию.
+		/// Сообщается только имитатором MPlayer'а, для настоящего MPlayer'а
+		/// равно timestamp.
+		Time_us	emitted;
+
+		/// Находится ли MPlayer в режиме паузы.
+		bool	paused;
+	};
+
+
+	/// Статистика записи данных в стандартный ввод MPlayer'а.
+	struct Stdin_stats
+	{
+		Stdin_stats(void);
+
+		/// Количество команд, ожидающих записи в данный момент.
+		size_t	queue_depth;
+
+		/// Максимальное количество команд, когда-либо ожидавших записи.
+		size_t	max_queue_depth;
+
+		/// Количество команд, отброшенных как повторы уже ожидающих записи
+		/// идемпотентных команд или объединенных с ожидающей записи
+		/// перемоткой.
+		size_t	coalesced;
+
+		/// Время от постановки в очередь до записи последней записанной
+		/// команды.
+		Time_us	last_latency;
+
+		/// Максимальное время от постановки в очередь до записи команды.
+		Time_us	max_latency;
+	};
+
+
+	/// Возвращает путь к исполняемому файлу плеера: значение переменной
+	/// окружения PLAYER_ENV_NAME или "mplayer", если она не задана.
+	std::string	get_player_path(void);
+
+
 	/// Представляет из себя запущенную копию MPlayer'а, за которой мы
 	/// наблюдаем.
 	class Mplayer: public boost::noncopyable
@@ -48,21 +124,76 @@
 
 
 		public:
+			/// Возвращает true, если MPlayer'у можно отправлять команды с
+			/// помощью send_command() (этого нельзя делать, если пользователь
+			/// задал в аргументах MPlayer'а свою опцию -input file=...).
+			/// Имеет смысл только после вызова start().
+			bool				can_send_commands(void) const;
+
+			/// Подключает обработчик сигнала на начало воспроизведения
+			/// MPlayer'ом очередного файла (при воспроизведении нескольких
+			/// файлов одним процессом MPlayer'а).
+			sigc::connection	connect_file_changed_handler(const sigc::slot<void>& slot);
+
 			/// Подключает обработчик сигнала на закрытие MPlayer'а.
 			sigc::connection	connect_quit_handler(const sigc::slot<void>& slot);
 
 			/// Подключает обработчик сигнала на изменения текущей позиции в
 			/// проигрываемом файле.
+			///
+			/// Сигналы объединяются: пока обработчик не вызван, новые изменения
+			/// не порождают новых сигналов, поэтому обработчик должен сам
+			/// получать самое последнее состояние.
 			sigc::connection	connect_time_offset_changed_handler(const sigc::slot<void>& slot);
 
+			/// Отключает передачу вывода MPlayer'а (стандартного вывода и
+			/// стандартного потока ошибок) в терминал - для терминального
+			/// интерфейса, который сам управляет содержимым экрана. Должна
+			/// вызываться до start().
+			void				disable_terminal_output(void);
+
 			/// Возвращает текущую позицию в проигрываемом файле.
 			Time_ms				get_current_offset(void) const;
 
+			/// Возвращает время (по монотонным часам), в которое Main loop
+			/// получил последнее уведомление об изменении позиции.
+			Time_us				get_notification_time(void) const;
+
+			/// Возвращает текущее состояние воспроизведения.
+			Playback_state		get_playback_state(void) const;
+
+			/// Возвращает путь к проигрываемому в данный момент файлу (в том
+			/// виде, в котором о нем сообщил MPlayer).
+			std::string			get_playing_file(void) const;
+
+			/// Возвращает статистику записи в стандартный ввод MPlayer'а.
+			Stdin_stats			get_stdin_stats(void) const;
+
+			/// Отправляет MPlayer'у команду (в формате slave-режима, например
+			/// "pause" или "seek 10 2"). Команды передаются через отдельный
+			/// pipe, не смешиваясь с нажатиями клавиш, которые передаются
+			/// через стандартный ввод. Никогда не блокируется.
+			void				send_command(const std::string& command) throw(m::Exception);
+
 			/// Запускает Mplayer.
 			void				start(const std::vector<std::string>& args) throw(m::Exception);
 
-			/// Записывает данные в стандартный поток ввода MPlayer'а.
-			void				write_to_stdio(const void* data, size_t size) throw(m::Exception);
+			/// Ставит данные в очередь на запись в стандартный поток ввода
+			/// MPlayer'а. Никогда не блокируется: если MPlayer не успевает
+			/// читать свой стандартный ввод, данные будут записаны из Main
+			/// loop'а, когда это станет возможным.
+			///
+			/// Повторы идемпотентных команд (например, выхода), которые еще
+			/// ожидают записи, отбрасываются. Перемотки, которые еще ожидают
+			/// записи, объединяются в одну перемотку на суммарную величину,
+			/// если к моменту ее отправки MPlayer уже прочитал все
+			/// предшествующие ей клавиши (иначе клавиши перемотки
+			/// записываются как есть). Переключатели (например, пауза)
+			/// никогда не отбрасываются.
+			///
+			/// @return - false, если данные являются повтором идемпотентной
+			/// команды, которая еще ожидает записи, и поэтому были отброшены.
+			bool				write_to_stdio(const void* data, size_t size) throw(m::Exception);
 	};
 
 #endif
@@ -0,0 +1,130 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <stdint.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "player_trace.hpp"
+
+
+
+namespace
+{
+	/// Заголовок файла трассы.
+	const char PLAYER_TRACE_MAGIC[] = "SUBMPLAYER-TRACE-1\n";
+
+	/// Максимальный размер одной записи трассы.
+	const uint32_t MAX_RECORD_SIZE = 1024 * 1024;
+}
+
+
+
+// Player_trace_writer -->
+	Player_trace_writer::Player_trace_writer(const std::string& path) throw(m::Exception)
+	:
+		path(path),
+		start_time(m::get_monotonic_time())
+	{
+		this->file.open(U2L(path).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!this->file.is_open())
+			M_THROW(__("Unable to create trace file '%1': %2.", path, EE(errno)));
+
+		this->file.write(PLAYER_TRACE_MAGIC, strlen(PLAYER_TRACE_MAGIC));
+	}
+
+
+
+	Player_trace_writer::~Player_trace_writer(void)
+	{
+		this->file.close();
+
+		if(this->file.fail())
+			MLIB_SW(__("Error while writing trace file '%1'.", this->path));
+	}
+
+
+
+	void Player_trace_writer::write(Time_us time, const char* data, size_t size) throw(m::Exception)
+	{
+		int64_t record_time = time - this->start_time;
+		uint32_t record_size = size;
+
+		this->file.write(reinterpret_cast<const char*>(&record_time), sizeof record_time);
+		this->file.write(reinterpret_cast<const char*>(&record_size), sizeof record_size);
+		this->file.write(data, size);
+
+		if(!this->file.good())
+			M_THROW(__("Error while writing trace file '%1': %2.", this->path, EE(errno)));
+	}
+// Player_trace_writer <--
+
+
+
+// Player_trace_reader -->
+	Player_trace_reader::Player_trace_reader(const std::string& path) throw(m::Exception)
+	:
+		path(path)
+	{
+		char magic[sizeof PLAYER_TRACE_MAGIC - 1];
+
+		this->file.open(U2L(path).c_str(), std::ios::in | std::ios::binary);
+		if(!this->file.is_open())
+			M_THROW(__("Unable to open trace file '%1': %2.", path, EE(errno)));
+
+		this->file.read(magic, sizeof magic);
+
+		if(this->file.fail() || memcmp(magic, PLAYER_TRACE_MAGIC, sizeof magic))
+			M_THROW(__("File '%1' is not a submplayer trace file.", path));
+	}
+
+
+
+	bool Player_trace_reader::read(Time_us* time, std::string* data) throw(m::Exception)
+	{
+		int64_t record_time;
+		uint32_t record_size;
+
+		this->file.read(reinterpret_cast<char*>(&record_time), sizeof record_time);
+
+		if(this->file.eof() && !this->file.gcount())
+			return false;
+
+		this->file.read(reinterpret_cast<char*>(&record_size), sizeof record_size);
+
+		if(this->file.fail() || record_size > MAX_RECORD_SIZE)
+			M_THROW(__("Trace file '%1' is corrupted.", this->path));
+
+		data->resize(record_size);
+
+		if(record_size)
+			this->file.read(&(*data)[0], record_size);
+
+		if(this->file.fail())
+			M_THROW(__("Trace file '%1' is corrupted.", this->path));
+
+		*time = record_time;
+
+		return true;
+	}
+// Player_trace_reader <--
+
@@ -0,0 +1,98 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_PLAYER_TRACE
+	#define HEADER_PLAYER_TRACE
+
+	#include <fstream>
+	#include <string>
+
+	#include <boost/noncopyable.hpp>
+
+
+	/// Переменная окружения, задающая путь к файлу, в который записывается
+	/// трасса вывода плеера.
+	#define RECORD_ENV_NAME "SUBMPLAYER_RECORD"
+
+	/// Переменная окружения, задающая путь к файлу с трассой, которая
+	/// воспроизводится вместо запуска плеера.
+	#define REPLAY_ENV_NAME "SUBMPLAYER_REPLAY"
+
+	/// Переменная окружения, задающая скорость воспроизведения трассы (1 -
+	/// в реальном времени, 0 - так быстро, как это возможно).
+	#define REPLAY_SPEED_ENV_NAME "SUBMPLAYER_REPLAY_SPEED"
+
+
+	/// Записывает трассу вывода плеера.
+	///
+	/// Трасса - это бинарный файл, содержащий заголовок, после которого идут
+	/// записи вида: время получения данных (в микросекундах по монотонным
+	/// часам от начала записи трассы, int64), размер данных (uint32), данные.
+	/// Все числа записываются в порядке байт текущей машины.
+	class Player_trace_writer: public boost::noncopyable
+	{
+		public:
+			Player_trace_writer(const std::string& path) throw(m::Exception);
+			~Player_trace_writer(void);
+
+
+		private:
+			/// Путь к файлу трассы.
+			std::string		path;
+
+			/// Файл трассы.
+			std::ofstream	file;
+
+			/// Время начала записи трассы.
+			Time_us			start_time;
+
+
+		public:
+			/// Записывает данные, полученные от плеера в момент времени time
+			/// (по монотонным часам).
+			void	write(Time_us time, const char* data, size_t size) throw(m::Exception);
+	};
+
+
+	/// Читает трассу вывода плеера, записанную Player_trace_writer.
+	class Player_trace_reader: public boost::noncopyable
+	{
+		public:
+			Player_trace_reader(const std::string& path) throw(m::Exception);
+
+
+		private:
+			/// Путь к файлу трассы.
+			std::string		path;
+
+			/// Файл трассы.
+			std::ifstream	file;
+
+
+		public:
+			/// Читает очередную запись трассы.
+			/// @param time - время получения данных от начала записи трассы.
+			/// @return - false, если записей больше нет.
+			bool	read(Time_us* time, std::string* data) throw(m::Exception);
+	};
+
+#endif
+
@@ -0,0 +1,270 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <mlib/fs.hpp>
+
+#include "playlist.hpp"
+#include "subtitles.hpp"
+#include "trace.hpp"
+
+
+
+Playlist::Playlist(const std::vector<std::string>& files)
+:
+	files(files),
+	current(0),
+	states(files.size(), NOT_LOADED),
+	subtitles(files.size()),
+	stop(false)
+{
+	this->thread.reset(new boost::thread(
+		boost::bind(&Playlist::loader_thread, this)));
+}
+
+
+
+Playlist::~Playlist(void)
+{
+	{
+		boost::mutex::scoped_lock lock(this->mutex);
+		this->stop = true;
+	}
+
+	this->state_cond.notify_all();
+	this->thread->join();
+}
+
+
+
+sigc::connection Playlist::connect_loaded_handler(const sigc::slot<void>& slot)
+{
+	return this->loaded_signal.connect(slot);
+}
+
+
+
+size_t Playlist::find(const std::string& file_path, size_t next_id) const
+{
+	size_t id = std::find(this->files.begin(), this->files.end(), file_path) - this->files.begin();
+
+	if(id < this->size())
+		return id;
+
+	try
+	{
+		m::fs::Stat file_stat = m::fs::unix_stat(file_path);
+
+		for(id = 0; id < this->size(); id++)
+		{
+			try
+			{
+				m::fs::Stat stat = m::fs::unix_stat(this->files[id]);
+
+				if(stat.dev == file_stat.dev && stat.ino == file_stat.ino)
+					return id;
+			}
+			catch(m::Sys_exception&)
+			{
+			}
+		}
+	}
+	catch(m::Sys_exception& e)
+	{
+		MLIB_D(_C("Unable to stat '%1': %2.", file_path, EE(e)));
+	}
+
+	MLIB_D(_C("'%1' is not found in the playlist, assuming it is file %2.", file_path, next_id));
+	return std::min(next_id, this->size());
+}
+
+
+
+const std::string& Playlist::get_file(size_t id) const
+{
+	return this->files.at(id);
+}
+
+
+
+bool Playlist::get_subtitles(size_t id, std::vector<Subtitles>* subtitles)
+{
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	if(this->states.at(id) != LOADED)
+	{
+		MLIB_D(_C("Subtitles for '%1' are not loaded yet.", this->files[id]));
+		this->queue_load(id, true);
+		return false;
+	}
+
+	// Субтитры копируются, а не отдаются: к файлу можно вернуться, пока он
+	// остается соседним с проигрываемым.
+	*subtitles = this->subtitles[id];
+
+	return true;
+}
+
+
+
+bool Playlist::is_kept(size_t id) const
+{
+	return id + 1 >= this->current && id <= this->current + 1;
+}
+
+
+
+void Playlist::load(const std::string& file_path, std::vector<Subtitles>* subtitles)
+{
+	TRACE_SPAN("Playlist::load");
+
+	try
+	{
+		load_subtitles(find_subtitles(file_path)).swap(*subtitles);
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_SW(EE(e));
+	}
+
+	MLIB_D(_C("%1 subtitles have been loaded for '%2'.", subtitles->size(), file_path));
+}
+
+
+
+void Playlist::loader_thread(void)
+{
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	while(true)
+	{
+		while(!this->stop && this->queue.empty())
+			this->state_cond.wait(lock);
+
+		if(this->stop)
+			break;
+
+		size_t id = this->queue.front();
+		this->queue.pop_front();
+
+		// Субтитры уже были загружены или загрузка больше не нужна
+		if(this->states[id] != QUEUED)
+			continue;
+
+		this->states[id] = LOADING;
+
+		{
+			std::vector<Subtitles> loaded;
+
+			lock.unlock();
+			this->load(this->files[id], &loaded);
+			lock.lock();
+
+			// Пока субтитры загружались, проигрываемый файл мог смениться
+			if(this->is_kept(id))
+			{
+				this->subtitles[id].swap(loaded);
+				this->states[id] = LOADED;
+			}
+			else
+				this->states[id] = NOT_LOADED;
+		}
+
+		if(this->states[id] == LOADED)
+			this->loaded_signal();
+	}
+}
+
+
+
+void Playlist::queue_load(size_t id, bool urgent)
+{
+	switch(this->states[id])
+	{
+		case NOT_LOADED:
+			this->states[id] = QUEUED;
+			break;
+
+		// Запись, оставшаяся в очереди, будет пропущена
+		case QUEUED:
+			if(!urgent)
+				return;
+			break;
+
+		default:
+			return;
+	}
+
+	MLIB_D(_C("Queueing subtitles for '%1' to load...", this->files[id]));
+
+	if(urgent)
+		this->queue.push_front(id);
+	else
+		this->queue.push_back(id);
+
+	this->state_cond.notify_all();
+}
+
+
+
+void Playlist::set_current(size_t id)
+{
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	this->current = id;
+
+	for(size_t i = 0; i < this->size(); i++)
+	{
+		if(this->is_kept(i))
+			continue;
+
+		switch(this->states[i])
+		{
+			case LOADED:
+				std::vector<Subtitles>().swap(this->subtitles[i]);
+				this->states[i] = NOT_LOADED;
+				break;
+
+			case QUEUED:
+				this->states[i] = NOT_LOADED;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	if(id > 0)
+		this->queue_load(id - 1, false);
+
+	if(id + 1 < this->size())
+		this->queue_load(id + 1, false);
+}
+
+
+
+size_t Playlist::size(void) const
+{
+	return this->files.size();
+}
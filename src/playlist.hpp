@@ -0,0 +1,164 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_PLAYLIST
+	#define HEADER_PLAYLIST
+
+	#include <deque>
+	#include <string>
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/scoped_ptr.hpp>
+	#include <boost/thread.hpp>
+	#include <boost/thread/condition.hpp>
+
+	#include <glibmm/dispatcher.h>
+
+	#include <sigc++/connection.h>
+
+	#include "subtitles.hpp"
+
+
+	/// Список проигрываемых файлов.
+	///
+	/// Все файлы проигрываются одним процессом MPlayer'а, а субтитры
+	/// соседних с проигрываемым файлов ищутся и загружаются отдельным
+	/// потоком и хранятся, пока файл остается соседним, поэтому переход к
+	/// предыдущему или следующему файлу не требует ни перезапуска MPlayer'а,
+	/// ни ожидания загрузки субтитров. Субтитры остальных файлов
+	/// загружаются тем же потоком по запросу - Main loop никогда не
+	/// блокируется на их загрузке.
+	///
+	/// Все методы, кроме find(), get_file() и size(), должны вызываться из
+	/// Main loop'а.
+	class Playlist: public boost::noncopyable
+	{
+		private:
+			/// Состояние загрузки субтитров одного файла.
+			enum Load_state {
+				/// Субтитры не загружены.
+				NOT_LOADED,
+
+				/// Субтитры ожидают загрузки.
+				QUEUED,
+
+				/// Субтитры загружаются.
+				LOADING,
+
+				/// Субтитры загружены.
+				LOADED
+			};
+
+
+		public:
+			Playlist(const std::vector<std::string>& files);
+			~Playlist(void);
+
+
+		private:
+			/// Проигрываемые файлы.
+			std::vector<std::string>				files;
+
+
+			/// Блокирует доступ к:
+			///   current
+			///   states
+			///   subtitles
+			///   queue
+			///   stop
+			boost::mutex							mutex;
+
+			/// Сигнализирует потоку загрузки о появлении файлов в очереди и
+			/// о необходимости завершить работу.
+			boost::condition						state_cond;
+
+			/// Номер проигрываемого файла.
+			size_t									current;
+
+			/// Состояние загрузки субтитров каждого файла.
+			std::vector<Load_state>					states;
+
+			/// Загруженные субтитры каждого файла.
+			std::vector< std::vector<Subtitles> >	subtitles;
+
+			/// Файлы, субтитры которых ожидают загрузки.
+			std::deque<size_t>						queue;
+
+			/// Должен ли поток загрузки завершить свою работу.
+			bool									stop;
+
+
+			/// Сигнал на окончание загрузки субтитров очередного файла.
+			Glib::Dispatcher						loaded_signal;
+
+			/// Поток, осуществляющий загрузку субтитров.
+			boost::scoped_ptr<
+				boost::thread>						thread;
+
+
+		public:
+			/// Подключает обработчик сигнала на окончание загрузки субтитров
+			/// очередного файла.
+			sigc::connection	connect_loaded_handler(const sigc::slot<void>& slot);
+
+			/// Возвращает номер файла file_path в списке. Файлы сравниваются
+			/// по устройству и inode, так как MPlayer может сообщить путь не в
+			/// том виде, в котором он был задан. Если такого файла в списке
+			/// нет, то возвращает next_id (номер файла, который MPlayer должен
+			/// проигрывать следующим) или size(), если next_id выходит за
+			/// пределы списка.
+			size_t				find(const std::string& file_path, size_t next_id) const;
+
+			/// Возвращает путь к файлу id.
+			const std::string&	get_file(size_t id) const;
+
+			/// Копирует в subtitles субтитры файла id, если они уже
+			/// загружены. Иначе ставит их в начало очереди на загрузку и
+			/// возвращает false - по окончании загрузки будет послан сигнал
+			/// (см. connect_loaded_handler()).
+			bool				get_subtitles(size_t id, std::vector<Subtitles>* subtitles);
+
+			/// Сообщает, что проигрывается файл id: ставит в очередь на
+			/// загрузку субтитры соседних с ним файлов и освобождает субтитры
+			/// файлов, не являющихся ни им, ни соседними с ним.
+			void				set_current(size_t id);
+
+			/// Возвращает количество файлов в списке.
+			size_t				size(void) const;
+
+		private:
+			/// Проверяет, нужно ли хранить субтитры файла id (является ли он
+			/// проигрываемым или соседним с ним).
+			bool				is_kept(size_t id) const;
+
+			/// Ищет и загружает субтитры для файла file_path.
+			static void			load(const std::string& file_path, std::vector<Subtitles>* subtitles);
+
+			/// Поток, осуществляющий загрузку субтитров.
+			void				loader_thread(void);
+
+			/// Ставит субтитры файла id в очередь на загрузку (в ее начало,
+			/// если urgent). Вызывается при заблокированном mutex.
+			void				queue_load(size_t id, bool urgent);
+	};
+
+#endif
@@ -0,0 +1,292 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <mlib/fs.hpp>
+
+#include "prefetcher.hpp"
+#include "startup_report.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Ограничение на суммарный объем загружаемых данных по умолчанию.
+	const off_t	DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+	/// Объем данных от начала видеофайла, который загружается в кэш.
+	const off_t	VIDEO_HEAD_SIZE = 32 * 1024 * 1024;
+
+	/// Размер порции, которыми запрашивается загрузка данных. Загрузка
+	/// порциями позволяет быстро прервать ее при завершении программы и не
+	/// занимает очередь запросов устройства одним огромным запросом.
+	const off_t	CHUNK_SIZE = 1024 * 1024;
+
+
+	/// Возвращает ограничение на суммарный объем загружаемых данных.
+	off_t	get_budget(void);
+
+
+
+	off_t get_budget(void)
+	{
+		const char* value = getenv(PREFETCH_ENV_NAME);
+
+		if(!value)
+			return DEFAULT_BUDGET;
+
+		char* end;
+		long long budget = strtoll(value, &end, 10);
+
+		if(!*value || *end || budget < 0)
+		{
+			MLIB_SW(__("Invalid %1 value: '%2'.", PREFETCH_ENV_NAME, value));
+			return DEFAULT_BUDGET;
+		}
+
+		return budget;
+	}
+}
+
+
+
+Prefetcher::Prefetcher(void)
+:
+	budget(get_budget()),
+	stop(false)
+{
+	this->thread.reset(new boost::thread(
+		boost::bind(&Prefetcher::prefetch_thread, this)));
+}
+
+
+
+Prefetcher::~Prefetcher(void)
+{
+	{
+		boost::mutex::scoped_lock lock(this->mutex);
+		this->stop = true;
+	}
+
+	this->queue_cond.notify_all();
+	this->thread->join();
+}
+
+
+
+void Prefetcher::add_file(const std::string& path)
+{
+	{
+		boost::mutex::scoped_lock lock(this->mutex);
+		this->queue.push_front(Request(path, 0));
+	}
+
+	this->queue_cond.notify_all();
+}
+
+
+
+void Prefetcher::add_video(const std::string& path)
+{
+	{
+		boost::mutex::scoped_lock lock(this->mutex);
+		this->queue.push_back(Request(path, VIDEO_HEAD_SIZE));
+	}
+
+	this->queue_cond.notify_all();
+}
+
+
+
+off_t Prefetcher::get_resident_size(int fd, off_t size)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	if(!size)
+		return 0;
+
+	void* addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if(addr == MAP_FAILED)
+	{
+		MLIB_D(_C("Can't mmap a file to get its page cache residency: %1.", EE(errno)));
+		return 0;
+	}
+
+	std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+	off_t resident_size = 0;
+
+	if(mincore(addr, size, &pages[0]))
+		MLIB_D(_C("Can't get page cache residency of a file: %1.", EE(errno)));
+	else
+	{
+		for(size_t i = 0; i < pages.size(); i++)
+			if(pages[i] & 1)
+				resident_size += page_size;
+
+		resident_size = std::min(resident_size, size);
+	}
+
+	munmap(addr, size);
+
+	return resident_size;
+}
+
+
+
+bool Prefetcher::is_enabled(void)
+{
+	return get_budget() > 0;
+}
+
+
+
+void Prefetcher::prefetch(const std::string& path, off_t max_size)
+{
+	TRACE_SPAN("Prefetcher::prefetch");
+
+	off_t size;
+	off_t resident_size;
+	Time_us start_time = m::get_monotonic_time();
+	m::File_holder file;
+
+	try
+	{
+		file.set(m::fs::unix_open(path, O_RDONLY));
+		m::fs::Stat stat = m::fs::unix_fstat(file.get());
+
+		// Видео может быть и устройством, и каналом - их загрузить
+		// заранее нельзя.
+		if(!S_ISREG(stat.mode))
+			return;
+
+		size = stat.size;
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_D(_C("Can't prefetch '%1': %2.", path, EE(e)));
+		return;
+	}
+
+	if(max_size)
+		size = std::min(size, max_size);
+	size = std::min(size, this->budget);
+
+	if(!size)
+		return;
+
+	this->budget -= size;
+	resident_size = this->get_resident_size(file.get(), size);
+
+	// Запрашиваем загрузку данных порциями -->
+		for(off_t offset = 0; offset < size; offset += CHUNK_SIZE)
+		{
+			{
+				boost::mutex::scoped_lock lock(this->mutex);
+
+				if(this->stop)
+					break;
+
+				// Субтитры нужны раньше видео, поэтому запросы на их
+				// загрузку, поступившие во время загрузки видео,
+				// выполняются между его порциями.
+				while(max_size && !this->queue.empty() && !this->queue.front().second)
+				{
+					Request request = this->queue.front();
+					this->queue.pop_front();
+
+					lock.unlock();
+					this->prefetch(request.first, request.second);
+					lock.lock();
+				}
+			}
+
+			off_t chunk_size = std::min(CHUNK_SIZE, size - offset);
+
+			// readahead() не поддерживается некоторыми файловыми системами -
+			// в этом случае ограничиваемся подсказкой, обработка которой
+			// ядром асинхронна.
+			if(readahead(file.get(), offset, chunk_size))
+			{
+				if(errno != EINVAL)
+				{
+					MLIB_D(_C("Can't prefetch '%1': %2.", path, EE(errno)));
+					break;
+				}
+
+				if( (errno = posix_fadvise(file.get(), offset, size - offset, POSIX_FADV_WILLNEED)) )
+					MLIB_D(_C("Can't prefetch '%1': %2.", path, EE(errno)));
+
+				break;
+			}
+		}
+	// Запрашиваем загрузку данных порциями <--
+
+	Time_us duration = m::get_monotonic_time() - start_time;
+
+	MLIB_D(_C("Prefetched %1 bytes of '%2' in %3 us (%4 bytes were already in the page cache).",
+		size, path, duration, resident_size));
+
+	if(getenv(STARTUP_REPORT_ENV_NAME))
+	{
+		std::cerr
+			<< "Prefetch: " << U2L(path) << ": " << size / 1024 << " KiB in " << duration << " us, "
+			<< resident_size / 1024 << " KiB were already resident." << std::endl;
+	}
+}
+
+
+
+void Prefetcher::prefetch_thread(void)
+{
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	while(true)
+	{
+		while(!this->stop && this->queue.empty())
+			this->queue_cond.wait(lock);
+
+		if(this->stop)
+			break;
+
+		Request request = this->queue.front();
+		this->queue.pop_front();
+
+		lock.unlock();
+		this->prefetch(request.first, request.second);
+		lock.lock();
+	}
+}
+
@@ -0,0 +1,120 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_PREFETCHER
+	#define HEADER_PREFETCHER
+
+	#include <sys/types.h>
+
+	#include <deque>
+	#include <string>
+	#include <utility>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/scoped_ptr.hpp>
+	#include <boost/thread.hpp>
+	#include <boost/thread/condition.hpp>
+
+
+	/// Переменная окружения, задающая ограничение (в байтах) на суммарный
+	/// объем данных, который может быть предварительно загружен в страничный
+	/// кэш. 0 отключает предварительную загрузку.
+	#define PREFETCH_ENV_NAME "SUBMPLAYER_PREFETCH"
+
+
+	/// Предварительно загружает файлы в страничный кэш.
+	///
+	/// Используется для того, чтобы чтение субтитров и первые секунды
+	/// проигрывания видео не ждали медленного (например, сетевого)
+	/// хранилища: пока разбираются аргументы, ищутся субтитры и запускается
+	/// MPlayer, отдельный поток уже запрашивает у ядра нужные данные.
+	///
+	/// Перед загрузкой каждого файла с помощью mincore() определяется, какая
+	/// его часть уже находилась в кэше. Результаты выводятся в отладочный
+	/// журнал, а при установленной переменной окружения
+	/// STARTUP_REPORT_ENV_NAME - и в стандартный поток ошибок.
+	class Prefetcher: public boost::noncopyable
+	{
+		public:
+			Prefetcher(void);
+			~Prefetcher(void);
+
+
+		private:
+			/// Файл, ожидающий загрузки, и максимальный объем загружаемых
+			/// данных от его начала.
+			typedef std::pair<std::string, off_t> Request;
+
+
+		private:
+			/// Объем данных, который еще может быть загружен (используется
+			/// только потоком загрузки).
+			off_t					budget;
+
+
+			/// Блокирует доступ к:
+			///   queue
+			///   stop
+			boost::mutex			mutex;
+
+			/// Сигнализирует о появлении новых запросов или о необходимости
+			/// завершить работу.
+			boost::condition		queue_cond;
+
+			/// Файлы, ожидающие загрузки.
+			std::deque<Request>		queue;
+
+			/// Должен ли поток загрузки завершить свою работу.
+			bool					stop;
+
+
+			/// Поток, осуществляющий загрузку.
+			boost::scoped_ptr<
+				boost::thread>		thread;
+
+
+		public:
+			/// Ставит в очередь загрузку файла целиком. Такие файлы
+			/// (субтитры) нужны раньше видео, поэтому ставятся в начало
+			/// очереди, а если видео уже загружается - загружаются между
+			/// его порциями.
+			void		add_file(const std::string& path);
+
+			/// Ставит в очередь загрузку начала видеофайла.
+			void		add_video(const std::string& path);
+
+			/// Возвращает true, если предварительная загрузка не отключена
+			/// пользователем.
+			static bool	is_enabled(void);
+
+		private:
+			/// Загружает не более max_size байт от начала файла path.
+			void		prefetch(const std::string& path, off_t max_size);
+
+			/// Поток, осуществляющий загрузку.
+			void		prefetch_thread(void);
+
+			/// Возвращает количество байт файла fd, находящихся в страничном
+			/// кэше, среди первых size байт.
+			static off_t	get_resident_size(int fd, off_t size);
+	};
+
+#endif
@@ -0,0 +1,657 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <glib.h>
+
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include <boost/bind.hpp>
+
+#include <sigc++/functors/mem_fun.h>
+
+#include <mlib/misc.hpp>
+
+#include "search_index.hpp"
+#include "subtitles.hpp"
+
+
+
+namespace
+{
+	/// Количество символов, для которых хранятся коды (Основная
+	/// многоязычная плоскость Unicode).
+	const size_t ALPHABET_SIZE = 0x10000;
+
+	/// Количество возможных значений первого кода триграммы.
+	const size_t BUCKETS_NUM = 256;
+
+	/// Максимальное количество результатов одного поиска.
+	const size_t MAX_RESULTS = 500;
+
+	/// Код всех символов, которым не назначен собственный код (коды 1 -
+	/// OTHER_CODE - 1 назначаются самым частым символам, а 0 завершает
+	/// субтитр).
+	const unsigned char OTHER_CODE = 255;
+
+	/// Размер триграммы.
+	const size_t TRIGRAM_SIZE = 3;
+
+
+	/// Сравнивает размеры списков субтитров триграмм.
+	bool		compare_list_sizes(const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b);
+
+	/// Возвращает триграмму, начинающуюся с data.
+	uint32_t	get_trigram(const char* data);
+
+	/// Аналог std::lower_bound(), который сначала ищет границу диапазона
+	/// шагами, удваивающимися от begin. Быстрее std::lower_bound(), если
+	/// искомый элемент находится близко к begin.
+	std::vector<uint32_t>::const_iterator	gallop(
+		std::vector<uint32_t>::const_iterator begin,
+		std::vector<uint32_t>::const_iterator end, uint32_t value);
+
+
+
+	bool compare_list_sizes(const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b)
+	{
+		return a.second - a.first < b.second - b.first;
+	}
+
+
+
+	uint32_t get_trigram(const char* data)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		return uint32_t(bytes[0]) << 16 | uint32_t(bytes[1]) << 8 | bytes[2];
+	}
+
+
+
+	std::vector<uint32_t>::const_iterator gallop(
+		std::vector<uint32_t>::const_iterator begin,
+		std::vector<uint32_t>::const_iterator end, uint32_t value)
+	{
+		size_t step = 1;
+
+		while(step < size_t(end - begin) && begin[step] < value)
+		{
+			begin += step;
+			step *= 2;
+		}
+
+		return std::lower_bound(begin, begin + std::min(step, size_t(end - begin)), value);
+	}
+}
+
+
+
+Search_result::Search_result(size_t track_id, size_t cue_id)
+:
+	track_id(track_id),
+	cue_id(cue_id)
+{
+}
+
+
+
+Search_index::Search_index(const std::vector<Subtitles>& subtitles)
+:
+	subtitles(subtitles),
+	stop(false),
+	ready(false),
+	last_truncated(false)
+{
+	// Должен быть вызван раньше сторонних обработчиков
+	this->built_signal.connect(
+		sigc::mem_fun(*this, &Search_index::on_built_cb));
+
+	this->thread.reset(new boost::thread(
+		boost::bind(&Search_index::build_thread, this)));
+}
+
+
+
+Search_index::~Search_index(void)
+{
+	this->stop = true;
+
+	if(this->thread->joinable())
+		this->thread->join();
+}
+
+
+
+void Search_index::build_thread(void)
+{
+	Time_us start_time = m::get_monotonic_time();
+
+	// Нормализуем тексты субтитров -->
+	{
+		uint32_t doc_id = 0;
+
+		M_FOR_CONST_IT(this->subtitles, track_it)
+		{
+			const Subtitles::Storage& cues = track_it->get();
+
+			this->track_starts.push_back(doc_id);
+
+			M_FOR_CONST_IT(cues, cue_it)
+			{
+				if(this->stop)
+					return;
+
+				this->text_offsets.push_back(this->texts.size());
+				this->texts += normalize(cue_it->text);
+				this->texts += '\0';
+				doc_id++;
+			}
+		}
+
+		this->track_starts.push_back(doc_id);
+		this->text_offsets.push_back(this->texts.size());
+	}
+	// Нормализуем тексты субтитров <--
+
+	if(this->stop)
+		return;
+
+	this->encode_texts();
+
+	// Строим списки субтитров триграмм -->
+	{
+		// Триграммы раскладываются по первому коду и сортируются по
+		// частям, чтобы построение индекса можно было быстро прервать.
+		std::vector<size_t> buckets(BUCKETS_NUM + 1, 0);
+
+		// Старшие 32 бита - триграмма, младшие - номер субтитра
+		std::vector<uint64_t> keys;
+
+		// Последняя триграмма субтитра заканчивается нулевым кодом, чтобы
+		// любые два символа текста были началом какой-либо триграммы (см.
+		// find_prefix()).
+
+		// Считаем триграммы -->
+			for(uint32_t doc_id = 0; doc_id + 1 < this->code_offsets.size(); doc_id++)
+			{
+				const char* codes = this->codes.data() + this->code_offsets[doc_id];
+				size_t size = this->code_offsets[doc_id + 1] - this->code_offsets[doc_id];
+
+				for(size_t pos = 0; pos + TRIGRAM_SIZE <= size; pos++)
+					buckets[static_cast<unsigned char>(codes[pos]) + 1]++;
+			}
+
+			for(size_t bucket_id = 1; bucket_id <= BUCKETS_NUM; bucket_id++)
+				buckets[bucket_id] += buckets[bucket_id - 1];
+		// Считаем триграммы <--
+
+		// Раскладываем триграммы -->
+		{
+			std::vector<size_t> positions(buckets.begin(), buckets.end() - 1);
+
+			keys.resize(buckets.back());
+
+			for(uint32_t doc_id = 0; doc_id + 1 < this->code_offsets.size(); doc_id++)
+			{
+				const char* codes = this->codes.data() + this->code_offsets[doc_id];
+				size_t size = this->code_offsets[doc_id + 1] - this->code_offsets[doc_id];
+
+				for(size_t pos = 0; pos + TRIGRAM_SIZE <= size; pos++)
+				{
+					keys[ positions[static_cast<unsigned char>(codes[pos])]++ ] =
+						uint64_t(get_trigram(codes + pos)) << 32 | doc_id;
+				}
+			}
+		}
+		// Раскладываем триграммы <--
+
+		this->postings.reserve(keys.size());
+
+		for(size_t bucket_id = 0; bucket_id < BUCKETS_NUM; bucket_id++)
+		{
+			if(this->stop)
+				return;
+
+			std::vector<uint64_t>::iterator begin = keys.begin() + buckets[bucket_id];
+			std::vector<uint64_t>::iterator end = keys.begin() + buckets[bucket_id + 1];
+
+			std::sort(begin, end);
+			end = std::unique(begin, end);
+
+			for(std::vector<uint64_t>::const_iterator it = begin; it != end; it++)
+			{
+				uint32_t trigram = *it >> 32;
+
+				if(this->trigrams.empty() || this->trigrams.back() != trigram)
+				{
+					this->trigrams.push_back(trigram);
+					this->postings_offsets.push_back(this->postings.size());
+				}
+
+				this->postings.push_back(static_cast<uint32_t>(*it));
+			}
+		}
+
+		this->postings_offsets.push_back(this->postings.size());
+	}
+	// Строим списки субтитров триграмм <--
+
+	MLIB_D(_C("Search index of %1 subtitles (%2 trigrams, %3 postings) has been built in %4 us.",
+		this->track_starts.back(), this->trigrams.size(), this->postings.size(),
+		m::get_monotonic_time() - start_time));
+
+	this->built_signal();
+}
+
+
+
+sigc::connection Search_index::connect_ready_handler(const sigc::slot<void>& slot)
+{
+	return this->built_signal.connect(slot);
+}
+
+
+
+void Search_index::encode(const char* text, size_t size, std::string* codes) const
+{
+	const char* end = text + size;
+
+	for(const char* it = text; it < end; it = g_utf8_next_char(it))
+	{
+		gunichar unicode_char = g_utf8_get_char(it);
+		*codes += unicode_char < ALPHABET_SIZE ? this->alphabet[unicode_char] : OTHER_CODE;
+	}
+}
+
+
+
+void Search_index::encode_texts(void)
+{
+	// Количество вхождений и символ
+	typedef std::pair<size_t, gunichar> Char_count;
+	std::vector<Char_count> chars;
+
+	// Считаем символы -->
+	{
+		std::vector<size_t> counts(ALPHABET_SIZE, 0);
+		const char* end = this->texts.data() + this->texts.size();
+
+		for(const char* it = this->texts.data(); it < end; it = g_utf8_next_char(it))
+		{
+			gunichar unicode_char = g_utf8_get_char(it);
+
+			if(unicode_char < ALPHABET_SIZE)
+				counts[unicode_char]++;
+		}
+
+		// Нулевые байты завершают субтитры
+		for(gunichar unicode_char = 1; unicode_char < ALPHABET_SIZE; unicode_char++)
+			if(counts[unicode_char])
+				chars.push_back(Char_count(counts[unicode_char], unicode_char));
+
+		std::sort(chars.begin(), chars.end(), std::greater<Char_count>());
+	}
+	// Считаем символы <--
+
+	// Назначаем коды самым частым символам -->
+		this->alphabet.assign(ALPHABET_SIZE, OTHER_CODE);
+
+		for(size_t id = 0; id < chars.size() && id + 1 < OTHER_CODE; id++)
+			this->alphabet[chars[id].second] = id + 1;
+	// Назначаем коды самым частым символам <--
+
+	// Переводим тексты в коды -->
+		this->codes.reserve(this->texts.size());
+
+		for(size_t doc_id = 0; doc_id + 1 < this->text_offsets.size(); doc_id++)
+		{
+			this->code_offsets.push_back(this->codes.size());
+			this->encode(this->texts.data() + this->text_offsets[doc_id],
+				this->text_offsets[doc_id + 1] - this->text_offsets[doc_id] - 1, &this->codes);
+			this->codes += '\0';
+		}
+
+		this->code_offsets.push_back(this->codes.size());
+	// Переводим тексты в коды <--
+}
+
+
+
+void Search_index::filter(const std::string& query, const std::vector<uint32_t>& candidates, std::vector<uint32_t>* results) const
+{
+	M_FOR_CONST_IT(candidates, it)
+	{
+		if(this->matches(*it, query))
+		{
+			results->push_back(*it);
+
+			if(results->size() > MAX_RESULTS)
+				break;
+		}
+	}
+}
+
+
+
+void Search_index::find(const std::string& query, const std::string& codes, std::vector<uint32_t>* results) const
+{
+	// Начало и конец списка субтитров триграммы в postings
+	typedef std::pair<size_t, size_t> List;
+	std::vector<List> lists;
+
+	// Получаем списки субтитров триграмм запроса -->
+		for(size_t pos = 0; pos + TRIGRAM_SIZE <= codes.size(); pos++)
+		{
+			uint32_t trigram = get_trigram(codes.data() + pos);
+			std::vector<uint32_t>::const_iterator it = std::lower_bound(
+				this->trigrams.begin(), this->trigrams.end(), trigram);
+
+			// Триграмма не встречается ни в одном субтитре
+			if(it == this->trigrams.end() || *it != trigram)
+				return;
+
+			size_t id = it - this->trigrams.begin();
+			lists.push_back(List(this->postings_offsets[id], this->postings_offsets[id + 1]));
+		}
+
+		// Самые короткие списки отсеивают больше всего субтитров
+		std::sort(lists.begin(), lists.end(), compare_list_sizes);
+	// Получаем списки субтитров триграмм запроса <--
+
+	// Запрос из одной триграммы содержится во всех ее субтитрах, если
+	// только в нем нет символов с общим кодом.
+	bool exact = lists.size() == 1 && codes.find(OTHER_CODE) == std::string::npos;
+
+	// Пересекаем списки -->
+		std::vector<uint32_t>::const_iterator postings = this->postings.begin();
+
+		for(size_t id = lists.front().first; id < lists.front().second; id++)
+		{
+			uint32_t doc_id = this->postings[id];
+			bool found = true;
+
+			for(size_t list_id = 1; list_id < lists.size(); list_id++)
+			{
+				List& list = lists[list_id];
+
+				// Субтитры перебираются по возрастанию, поэтому уже
+				// пройденную часть списка можно отбросить.
+				list.first = gallop(postings + list.first, postings + list.second, doc_id) - postings;
+
+				// Больше ни один субтитр не содержит все триграммы
+				if(list.first == list.second)
+					return;
+
+				if(this->postings[list.first] != doc_id)
+				{
+					found = false;
+					break;
+				}
+			}
+
+			// Наличие всех триграмм еще не означает, что они идут подряд
+			if(found && (exact || this->matches(doc_id, query)))
+			{
+				results->push_back(doc_id);
+
+				if(results->size() > MAX_RESULTS)
+					break;
+			}
+		}
+	// Пересекаем списки <--
+}
+
+
+
+void Search_index::find_prefix(const std::string& query, const std::string& codes, std::vector<uint32_t>* results) const
+{
+	// Номер субтитра и номер списка, из которого он взят
+	typedef std::pair<uint32_t, size_t> Head;
+
+	std::priority_queue< Head, std::vector<Head>, std::greater<Head> > heads;
+	std::vector<size_t> positions;
+	std::vector<size_t> ends;
+
+	// Получаем списки субтитров триграмм, начинающихся с codes -->
+	{
+		uint32_t first = get_trigram((codes + '\0').data());
+
+		std::vector<uint32_t>::const_iterator begin = std::lower_bound(
+			this->trigrams.begin(), this->trigrams.end(), first);
+		std::vector<uint32_t>::const_iterator end = std::lower_bound(
+			begin, this->trigrams.end(), first + BUCKETS_NUM);
+
+		for(std::vector<uint32_t>::const_iterator it = begin; it != end; it++)
+		{
+			size_t id = it - this->trigrams.begin();
+
+			heads.push(Head(this->postings[this->postings_offsets[id]], positions.size()));
+			positions.push_back(this->postings_offsets[id]);
+			ends.push_back(this->postings_offsets[id + 1]);
+		}
+	}
+	// Получаем списки субтитров триграмм, начинающихся с codes <--
+
+	bool exact = codes.find(OTHER_CODE) == std::string::npos;
+
+	// Объединяем списки -->
+		while(!heads.empty() && results->size() <= MAX_RESULTS)
+		{
+			Head head = heads.top();
+			heads.pop();
+
+			if(
+				(results->empty() || results->back() != head.first) &&
+				(exact || this->matches(head.first, query))
+			)
+				results->push_back(head.first);
+
+			size_t& pos = positions[head.second];
+
+			if(++pos < ends[head.second])
+				heads.push(Head(this->postings[pos], head.second));
+		}
+	// Объединяем списки <--
+}
+
+
+
+bool Search_index::is_ready(void) const
+{
+	return this->ready;
+}
+
+
+
+bool Search_index::matches(uint32_t doc_id, const std::string& query) const
+{
+	const char* text = this->texts.data() + this->text_offsets[doc_id];
+	size_t size = this->text_offsets[doc_id + 1] - this->text_offsets[doc_id] - 1;
+
+	return memmem(text, size, query.data(), query.size()) != NULL;
+}
+
+
+
+std::string Search_index::normalize(const std::string& text)
+{
+	std::string normalized;
+
+	// Разложение отделяет диакритические знаки от букв
+	gchar* decomposed = g_utf8_normalize(text.data(), text.size(), G_NORMALIZE_NFD);
+
+	// Текст не является корректной UTF-8 строкой
+	if(!decomposed)
+		return normalized;
+
+	normalized.reserve(text.size());
+
+	// Пробельные символы в начале отбрасываются
+	bool space = true;
+
+	for(const gchar* it = decomposed; *it; it = g_utf8_next_char(it))
+	{
+		gunichar unicode_char = g_utf8_get_char(it);
+
+		switch(g_unichar_type(unicode_char))
+		{
+			case G_UNICODE_NON_SPACING_MARK:
+			case G_UNICODE_COMBINING_MARK:
+			case G_UNICODE_ENCLOSING_MARK:
+				continue;
+
+			default:
+				break;
+		}
+
+		if(g_unichar_isspace(unicode_char))
+		{
+			if(!space)
+				normalized += ' ';
+
+			space = true;
+		}
+		else
+		{
+			gchar buf[6];
+			normalized.append(buf, g_unichar_to_utf8(g_unichar_tolower(unicode_char), buf));
+			space = false;
+		}
+	}
+
+	g_free(decomposed);
+
+	if(space && !normalized.empty())
+		normalized.resize(normalized.size() - 1);
+
+	return normalized;
+}
+
+
+
+void Search_index::on_built_cb(void)
+{
+	this->ready = true;
+}
+
+
+
+void Search_index::scan(const std::string& query, std::vector<uint32_t>* results) const
+{
+	const char* data = this->texts.data();
+	const char* end = data + this->texts.size();
+	const char* pos = data;
+
+	while(
+		results->size() <= MAX_RESULTS &&
+		( pos = static_cast<const char*>(memmem(pos, end - pos, query.data(), query.size())) )
+	)
+	{
+		uint32_t doc_id = std::upper_bound(
+			this->text_offsets.begin(), this->text_offsets.end(), uint32_t(pos - data)
+		) - this->text_offsets.begin() - 1;
+
+		results->push_back(doc_id);
+
+		// Переходим к следующему субтитру
+		pos = data + this->text_offsets[doc_id + 1];
+	}
+}
+
+
+
+bool Search_index::search(const std::string& query, std::vector<Search_result>* results)
+{
+	std::string normalized = normalize(query);
+	std::vector<uint32_t> docs;
+
+	results->clear();
+
+	if(!this->ready)
+		return false;
+
+	// Ищем субтитры -->
+		if(normalized.empty())
+		{
+			// Пустой запрос ничего не находит
+		}
+		else if(
+			!this->last_query.empty() && !this->last_truncated &&
+			normalized.find(this->last_query) != std::string::npos
+		)
+		{
+			// Все субтитры, содержащие новый запрос, содержат и
+			// предыдущий.
+			this->filter(normalized, this->last_results, &docs);
+		}
+		else
+		{
+			std::string codes;
+			this->encode(normalized.data(), normalized.size(), &codes);
+
+			if(codes.size() == 1)
+				this->scan(normalized, &docs);
+			else if(codes.size() < TRIGRAM_SIZE)
+				this->find_prefix(normalized, codes, &docs);
+			else
+				this->find(normalized, codes, &docs);
+		}
+
+		this->last_truncated = docs.size() > MAX_RESULTS;
+		if(this->last_truncated)
+			docs.resize(MAX_RESULTS);
+
+		this->last_query.swap(normalized);
+		this->last_results.swap(docs);
+	// Ищем субтитры <--
+
+	// Переводим сквозные номера субтитров в номера дорожек и субтитров в
+	// них -->
+		results->reserve(this->last_results.size());
+
+		M_FOR_CONST_IT(this->last_results, it)
+		{
+			size_t track_id = std::upper_bound(
+				this->track_starts.begin(), this->track_starts.end(), *it
+			) - this->track_starts.begin() - 1;
+
+			results->push_back(Search_result(track_id, *it - this->track_starts[track_id]));
+		}
+	// Переводим сквозные номера субтитров в номера дорожек и субтитров в
+	// них <--
+
+	return true;
+}
+
+
+
+void Search_index::wait(void)
+{
+	if(this->thread->joinable())
+		this->thread->join();
+
+	if(!this->stop)
+		this->ready = true;
+}
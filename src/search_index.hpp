@@ -0,0 +1,203 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_SEARCH_INDEX
+	#define HEADER_SEARCH_INDEX
+
+	#include <stdint.h>
+
+	#include <string>
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/scoped_ptr.hpp>
+	#include <boost/thread.hpp>
+
+	#include <glibmm/dispatcher.h>
+
+	#include <sigc++/connection.h>
+
+	class Subtitles;
+
+
+	/// Субтитр, найденный Search_index.
+	struct Search_result
+	{
+		Search_result(size_t track_id, size_t cue_id);
+
+		/// Номер дорожки.
+		size_t	track_id;
+
+		/// Номер субтитра в дорожке.
+		size_t	cue_id;
+	};
+
+
+	/// Полнотекстовый индекс по всем дорожкам субтитров.
+	///
+	/// Индекс строится в отдельном потоке сразу после создания. Тексты всех
+	/// субтитров приводятся к нижнему регистру, из них удаляются
+	/// диакритические знаки, а пробельные символы заменяются одним пробелом.
+	/// Нормализованные тексты хранятся подряд в одной строке.
+	///
+	/// Каждому из самых частых символов текстов назначается однобайтовый
+	/// код (остальные символы получают общий код), и для каждой
+	/// последовательности из трех кодов (триграммы) хранится
+	/// отсортированный список субтитров, в которых она встречается. Коды
+	/// нужны для того, чтобы триграмма состояла из трех символов, а не из
+	/// трех байт UTF-8, которые для кириллицы почти ничего не отсеивают.
+	///
+	/// При поиске списки всех триграмм запроса пересекаются, начиная с самого
+	/// короткого, и оставшиеся субтитры проверяются на вхождение запроса
+	/// целиком. Запросы из двух символов ищутся по спискам всех триграмм,
+	/// начинающихся с них, а из одного - простым перебором текстов. Если
+	/// новый запрос содержит в себе предыдущий (пользователь дописал
+	/// символ), то проверяются только результаты предыдущего запроса.
+	///
+	/// Субтитры не копируются и должны существовать, пока существует индекс.
+	class Search_index: public boost::noncopyable
+	{
+		public:
+			Search_index(const std::vector<Subtitles>& subtitles);
+			~Search_index(void);
+
+
+		private:
+			/// Индексируемые субтитры.
+			const std::vector<Subtitles>&	subtitles;
+
+			/// Номер первого субтитра каждой дорожки в сквозной нумерации
+			/// субтитров всех дорожек (и общее количество субтитров в
+			/// конце).
+			std::vector<uint32_t>			track_starts;
+
+			/// Нормализованные тексты всех субтитров (каждый завершается
+			/// нулевым байтом, чтобы триграммы и совпадения не выходили за
+			/// границы субтитра).
+			std::string						texts;
+
+			/// Смещение текста каждого субтитра в texts (и размер texts в
+			/// конце).
+			std::vector<uint32_t>			text_offsets;
+
+			/// Код каждого символа из Основной многоязычной плоскости
+			/// Unicode.
+			std::vector<unsigned char>		alphabet;
+
+			/// Тексты всех субтитров в виде кодов символов (каждый также
+			/// завершается нулевым байтом).
+			std::string						codes;
+
+			/// Смещение кодов каждого субтитра в codes (и размер codes в
+			/// конце).
+			std::vector<uint32_t>			code_offsets;
+
+			/// Отсортированные триграммы.
+			std::vector<uint32_t>			trigrams;
+
+			/// Смещение списка субтитров каждой триграммы в postings (и
+			/// размер postings в конце).
+			std::vector<uint32_t>			postings_offsets;
+
+			/// Списки субтитров триграмм.
+			std::vector<uint32_t>			postings;
+
+
+			/// Должен ли поток построения индекса прервать свою работу.
+			volatile bool					stop;
+
+			/// Поток, строящий индекс.
+			boost::scoped_ptr<
+				boost::thread>				thread;
+
+			/// Сигнал на окончание построения индекса.
+			Glib::Dispatcher				built_signal;
+
+			/// Построен ли индекс (используется только Main loop'ом).
+			bool							ready;
+
+
+			/// Нормализованный предыдущий запрос.
+			std::string						last_query;
+
+			/// Результаты предыдущего запроса (в сквозной нумерации).
+			std::vector<uint32_t>			last_results;
+
+			/// Были ли результаты предыдущего запроса ограничены
+			/// максимальным количеством результатов.
+			bool							last_truncated;
+
+
+		public:
+			/// Подключает обработчик сигнала на окончание построения индекса.
+			sigc::connection	connect_ready_handler(const sigc::slot<void>& slot);
+
+			/// Возвращает true, если индекс уже построен.
+			bool				is_ready(void) const;
+
+			/// Приводит текст к виду, в котором он хранится в индексе.
+			static std::string	normalize(const std::string& text);
+
+			/// Ищет субтитры, текст которых содержит query, и записывает их
+			/// в results в порядке следования дорожек и субтитров (количество
+			/// результатов ограничено).
+			/// @return - false, если индекс еще не построен.
+			bool				search(const std::string& query, std::vector<Search_result>* results);
+
+			/// Дожидается окончания построения индекса (для использования
+			/// без Main loop'а).
+			void				wait(void);
+
+		private:
+			/// Поток, строящий индекс.
+			void				build_thread(void);
+
+			/// Дописывает в codes коды символов нормализованного текста
+			/// text размером size байт.
+			void				encode(const char* text, size_t size, std::string* codes) const;
+
+			/// Назначает коды символам texts и переводит в них тексты.
+			void				encode_texts(void);
+
+			/// Ищет субтитры, содержащие query, среди candidates.
+			void				filter(const std::string& query, const std::vector<uint32_t>& candidates, std::vector<uint32_t>* results) const;
+
+			/// Ищет субтитры, содержащие query (codes - его коды), среди
+			/// всех субтитров.
+			void				find(const std::string& query, const std::string& codes, std::vector<uint32_t>* results) const;
+
+			/// Ищет субтитры, содержащие query из двух символов (codes - его
+			/// коды), объединяя списки субтитров всех триграмм, начинающихся
+			/// с них.
+			void				find_prefix(const std::string& query, const std::string& codes, std::vector<uint32_t>* results) const;
+
+			/// Возвращает true, если субтитр doc_id содержит query.
+			bool				matches(uint32_t doc_id, const std::string& query) const;
+
+			/// Обработчик сигнала на окончание построения индекса.
+			void				on_built_cb(void);
+
+			/// Ищет query из одного символа в texts, не используя
+			/// триграммы.
+			void				scan(const std::string& query, std::vector<uint32_t>* results) const;
+	};
+
+#endif
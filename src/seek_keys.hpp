@@ -0,0 +1,65 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+/// Таблица клавиш перемотки MPlayer'а. Используется как SubMPlayer'ом, так
+/// и имитатором MPlayer'а, поэтому не зависит от остальных заголовочных
+/// файлов проекта.
+
+
+#ifndef HEADER_SEEK_KEYS
+	#define HEADER_SEEK_KEYS
+
+	#include <cstring>
+
+	#include <string>
+
+	/// Перемотка, которую MPlayer (при настройках по умолчанию) выполняет по
+	/// получении определенных последовательностей байт.
+	const struct Seek_key
+	{
+		const char*	value;
+
+		/// Величина перемотки в миллисекундах.
+		long		seek;
+	} SEEK_KEYS[] = {
+		{ "\x1b\x5b\x44"			,	-10 * 1000		},	// Left
+		{ "\x1b\x5b\x43"			,	10 * 1000		},	// Right
+		{ "\x1b\x5b\x42"			,	-60 * 1000		},	// Down
+		{ "\x1b\x5b\x41"			,	60 * 1000		},	// Up
+		{ "\x1b\x5b\x36\x7e"		,	-600 * 1000		},	// Page Down
+		{ "\x1b\x5b\x35\x7e"		,	600 * 1000		},	// Page Up
+		{ NULL						,	0				}
+	};
+
+
+	/// Возвращает команду перемотки, с которой начинается keys (начиная с
+	/// позиции pos), или NULL, если такой нет.
+	inline
+	const Seek_key* find_seek_key(const std::string& keys, size_t pos = 0)
+	{
+		for(const Seek_key* key = SEEK_KEYS; key->value; key++)
+			if(!keys.compare(pos, strlen(key->value), key->value))
+				return key;
+
+		return NULL;
+	}
+
+#endif
@@ -0,0 +1,129 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <cstdlib>
+
+#include <iomanip>
+#include <iostream>
+
+#include "startup_report.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Имена этапов.
+	const char* const STARTUP_PHASE_NAMES[STARTUP_PHASES_NUM] = {
+		"args",
+		"scan",
+		"parse",
+		"gtk_init",
+		"player_spawn",
+		"window",
+		"parse_wait",
+		"tracks"
+	};
+
+
+	/// Время начала запуска программы.
+	Time_us	START_TIME = 0;
+
+	/// Время окончания запуска программы.
+	Time_us	FINISH_TIME = 0;
+
+	/// Время начала каждого из этапов.
+	Time_us	PHASE_BEGIN_TIMES[STARTUP_PHASES_NUM];
+
+	/// Время окончания каждого из этапов.
+	Time_us	PHASE_END_TIMES[STARTUP_PHASES_NUM];
+}
+
+
+
+void dump_startup_report(std::ostream& stream)
+{
+	Time_us sequential_time = 0;
+
+	stream << "Startup phases (us from start, duration):" << std::endl;
+
+	for(int phase = 0; phase < STARTUP_PHASES_NUM; phase++)
+	{
+		if(!PHASE_END_TIMES[phase])
+			continue;
+
+		Time_us duration = PHASE_END_TIMES[phase] - PHASE_BEGIN_TIMES[phase];
+
+		// Ожидание - это не работа, а следствие ее распараллеливания
+		if(phase != STARTUP_PARSE_WAIT)
+			sequential_time += duration;
+
+		stream
+			<< std::setw(14) << std::left << STARTUP_PHASE_NAMES[phase]
+			<< std::right
+			<< std::setw(10) << PHASE_BEGIN_TIMES[phase] - START_TIME
+			<< std::setw(10) << duration
+			<< std::endl;
+	}
+
+	stream << "Sequential time of all phases: " << sequential_time << " us" << std::endl;
+
+	if(FINISH_TIME)
+		stream << "First highlight: " << FINISH_TIME - START_TIME << " us" << std::endl;
+}
+
+
+
+void init_startup_report(void)
+{
+	START_TIME = m::get_monotonic_time();
+}
+
+
+
+void startup_finished(void)
+{
+	if(FINISH_TIME)
+		return;
+
+	FINISH_TIME = m::get_monotonic_time();
+	TRACE_INSTANT("first_highlight");
+
+	if(getenv(STARTUP_REPORT_ENV_NAME))
+		dump_startup_report(std::cerr);
+}
+
+
+
+void startup_phase_begin(Startup_phase phase)
+{
+	PHASE_BEGIN_TIMES[phase] = m::get_monotonic_time();
+}
+
+
+
+void startup_phase_end(Startup_phase phase)
+{
+	PHASE_END_TIMES[phase] = m::get_monotonic_time();
+
+	if(TRACE_ENABLED)
+		trace_span(STARTUP_PHASE_NAMES[phase], PHASE_BEGIN_TIMES[phase], PHASE_END_TIMES[phase]);
+}
@@ -0,0 +1,84 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_STARTUP_REPORT
+	#define HEADER_STARTUP_REPORT
+
+	#include <ostream>
+
+
+	/// Переменная окружения, при установке которой по окончании запуска
+	/// программы (при первом выделении субтитра) в стандартный поток ошибок
+	/// выводится отчет о продолжительности этапов запуска.
+	#define STARTUP_REPORT_ENV_NAME "SUBMPLAYER_STARTUP_REPORT"
+
+
+	/// Этапы запуска программы. Каждый этап также записывается в трассу
+	/// выполнения (см. trace.hpp).
+	enum Startup_phase
+	{
+		/// Разбор аргументов командной строки.
+		STARTUP_ARGS,
+
+		/// Поиск файлов субтитров.
+		STARTUP_SCAN,
+
+		/// Загрузка субтитров (выполняется отдельным потоком).
+		STARTUP_PARSE,
+
+		/// Инициализация GTK.
+		STARTUP_GTK_INIT,
+
+		/// Запуск MPlayer'а.
+		STARTUP_PLAYER_SPAWN,
+
+		/// Создание главного окна.
+		STARTUP_WINDOW,
+
+		/// Ожидание окончания загрузки субтитров.
+		STARTUP_PARSE_WAIT,
+
+		/// Создание дорожек субтитров в главном окне.
+		STARTUP_TRACKS,
+
+		STARTUP_PHASES_NUM
+	};
+
+
+	/// Выводит отчет о продолжительности этапов запуска.
+	void	dump_startup_report(std::ostream& stream);
+
+	/// Отмечает начало запуска программы. Должна вызываться первой.
+	void	init_startup_report(void);
+
+	/// Отмечает окончание запуска программы (первое выделение субтитра) и,
+	/// если задана переменная окружения STARTUP_REPORT_ENV_NAME, выводит
+	/// отчет. Повторные вызовы игнорируются.
+	void	startup_finished(void);
+
+	/// Отмечает начало этапа. Может вызываться из любого потока, но каждый
+	/// этап должен выполняться только одним потоком.
+	void	startup_phase_begin(Startup_phase phase);
+
+	/// Отмечает окончание этапа.
+	void	startup_phase_end(Startup_phase phase);
+
+#endif
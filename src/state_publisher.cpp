@@ -0,0 +1,135 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+
+#include <mlib/misc.hpp>
+
+#include "mplayer.hpp"
+#include "state_publisher.hpp"
+
+
+
+State_publisher::State_publisher(const std::string& name) throw(m::Exception)
+:
+	name(name),
+	segment(NULL)
+{
+	m::File_holder fd;
+
+	memset(&this->state, 0, sizeof this->state);
+
+	// Создаем сегмент -->
+		// Сегмент, оставшийся от завершившейся аварийно копии программы,
+		// создаем заново, чтобы читатели, подключенные к нему, не получали
+		// устаревшее состояние.
+		shm_unlink(name.c_str());
+
+		fd.set(shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644));
+
+		if(fd.get() < 0)
+			M_THROW(__("Can't create shared memory segment '%1': %2.", name, EE(errno)));
+
+		if(ftruncate(fd.get(), sizeof *this->segment))
+		{
+			int saved_errno = errno;
+			shm_unlink(name.c_str());
+			M_THROW(__("Can't resize shared memory segment '%1': %2.", name, EE(saved_errno)));
+		}
+
+		void* address = mmap(NULL, sizeof *this->segment, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+
+		if(address == MAP_FAILED)
+		{
+			int saved_errno = errno;
+			shm_unlink(name.c_str());
+			M_THROW(__("Can't map shared memory segment '%1': %2.", name, EE(saved_errno)));
+		}
+
+		this->segment = static_cast<struct submplayer_state_segment*>(address);
+	// Создаем сегмент <--
+
+	// Инициализируем сегмент. Признак инициализации записывается
+	// последним: до этого читатели не могут подключиться к сегменту.
+	// -->
+		this->segment->version = SUBMPLAYER_STATE_VERSION;
+		this->store();
+		__sync_synchronize();
+		this->segment->magic = SUBMPLAYER_STATE_MAGIC;
+	// <--
+
+	MLIB_D(_C("Publishing playback state in shared memory segment '%1'.", name));
+}
+
+
+
+State_publisher::~State_publisher(void)
+{
+	munmap(this->segment, sizeof *this->segment);
+	shm_unlink(this->name.c_str());
+}
+
+
+
+void State_publisher::publish(const Playback_state& state, const size_t* started_by, size_t tracks_num)
+{
+	tracks_num = std::min<size_t>(tracks_num, SUBMPLAYER_STATE_MAX_TRACKS);
+
+	this->state.paused = state.paused;
+	this->state.offset = state.offset;
+	this->state.timestamp = state.offset_timestamp;
+	this->state.tracks_num = tracks_num;
+
+	for(size_t track_id = 0; track_id < tracks_num; track_id++)
+		this->state.cues[track_id] = int64_t(started_by[track_id]) - 1;
+
+	this->store();
+}
+
+
+
+void State_publisher::store(void)
+{
+	struct submplayer_state_segment* segment = this->segment;
+
+	segment->sequence++;
+	__sync_synchronize();
+	memcpy(&segment->state, &this->state, sizeof this->state);
+	__sync_synchronize();
+	segment->sequence++;
+}
+
+
+
+void State_publisher::tracks_changed(void)
+{
+	this->state.generation++;
+	this->state.tracks_num = 0;
+	this->store();
+}
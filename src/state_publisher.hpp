@@ -0,0 +1,83 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_STATE_PUBLISHER
+	#define HEADER_STATE_PUBLISHER
+
+	#include <string>
+
+	#include <boost/noncopyable.hpp>
+
+	#include "submplayer_state.h"
+
+	struct Playback_state;
+
+
+	/// Переменная окружения, задающая имя сегмента разделяемой памяти (см.
+	/// shm_open()), в котором публикуется состояние воспроизведения. Если
+	/// она не задана, то состояние не публикуется.
+	#define SHM_ENV_NAME "SUBMPLAYER_SHM"
+
+
+	/// Публикует текущую позицию воспроизведения и текущий субтитр каждой
+	/// дорожки в сегменте разделяемой памяти POSIX для сторонних программ.
+	///
+	/// Формат сегмента и функции для его чтения описаны в
+	/// submplayer_state.h. Состояние защищено seqlock'ом (тем же протоколом,
+	/// что и m::Seqlock), поэтому читатели никогда не задерживают
+	/// публикацию, а публикация не выполняет системных вызовов.
+	class State_publisher: public boost::noncopyable
+	{
+		public:
+			/// @param name - имя сегмента. Существующий сегмент с таким
+			/// именем заменяется.
+			State_publisher(const std::string& name) throw(m::Exception);
+
+			/// Удаляет сегмент.
+			~State_publisher(void);
+
+
+		private:
+			/// Имя сегмента.
+			std::string							name;
+
+			/// Отображенный в память сегмент.
+			struct submplayer_state_segment*	segment;
+
+			/// Последнее опубликованное состояние.
+			struct submplayer_state				state;
+
+
+		public:
+			/// Публикует состояние воспроизведения.
+			/// @param started_by - количество субтитров каждой из tracks_num
+			/// дорожек, появившихся не позже state.offset (см. Timeline).
+			void	publish(const Playback_state& state, const size_t* started_by, size_t tracks_num);
+
+			/// Сообщает о смене дорожек субтитров.
+			void	tracks_changed(void);
+
+		private:
+			/// Копирует this->state в сегмент.
+			void	store(void);
+	};
+
+#endif
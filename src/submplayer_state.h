@@ -0,0 +1,215 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+/// Библиотека для чтения состояния воспроизведения, которое SubMPlayer
+/// публикует в сегменте разделяемой памяти POSIX (см. переменную окружения
+/// SUBMPLAYER_SHM).
+///
+/// Состоит только из этого заголовочного файла и может использоваться как
+/// из C, так и из C++. Чтение не выполняет ни одного системного вызова и
+/// никак не нагружает SubMPlayer, поэтому опрашивать состояние можно с
+/// любой частотой:
+///
+///     const struct submplayer_state_segment* segment = submplayer_state_open("/submplayer");
+///     struct submplayer_state state;
+///
+///     if(segment && !submplayer_state_read(segment, &state))
+///         printf("%lld ms\n", (long long) state.offset);
+
+
+#ifndef HEADER_SUBMPLAYER_STATE
+	#define HEADER_SUBMPLAYER_STATE
+
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <stdint.h>
+	#include <string.h>
+	#include <unistd.h>
+
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+
+	/// Признак инициализированного сегмента.
+	#define SUBMPLAYER_STATE_MAGIC 0x53554253
+
+	/// Версия формата сегмента.
+	#define SUBMPLAYER_STATE_VERSION 1
+
+	/// Максимальное количество дорожек, о которых публикуется информация.
+	#define SUBMPLAYER_STATE_MAX_TRACKS 16
+
+	/// Количество попыток получить согласованную копию состояния, после
+	/// которого submplayer_state_read() сообщает об ошибке (например, если
+	/// SubMPlayer завершился посреди записи).
+	#define SUBMPLAYER_STATE_MAX_RETRIES 1000000
+
+
+	/// Состояние воспроизведения.
+	struct submplayer_state
+	{
+		/// Увеличивается при каждой смене дорожек субтитров (при переходе
+		/// к следующему файлу), т. к. номера субтитров в cues после этого
+		/// относятся к другим дорожкам.
+		uint32_t	generation;
+
+		/// Находится ли MPlayer в режиме паузы.
+		uint32_t	paused;
+
+		/// Текущая позиция в проигрываемом файле (мс).
+		int64_t		offset;
+
+		/// Время (по CLOCK_MONOTONIC, мкс), которому соответствует offset.
+		/// Если MPlayer не находится в режиме паузы, то позицию на момент
+		/// now можно получить как offset + (now - timestamp) / 1000.
+		int64_t		timestamp;
+
+		/// Количество дорожек субтитров.
+		uint32_t	tracks_num;
+
+		uint32_t	reserved;
+
+		/// Номер последнего появившегося к offset субтитра каждой дорожки
+		/// или -1, если ни одного субтитра еще не появилось.
+		int64_t		cues[SUBMPLAYER_STATE_MAX_TRACKS];
+	};
+
+
+	/// Содержимое сегмента разделяемой памяти.
+	///
+	/// state защищено seqlock'ом: перед изменением state SubMPlayer делает
+	/// sequence нечетным, а после изменения - снова четным.
+	struct submplayer_state_segment
+	{
+		/// SUBMPLAYER_STATE_MAGIC, если сегмент инициализирован.
+		volatile uint32_t		magic;
+
+		/// SUBMPLAYER_STATE_VERSION.
+		uint32_t				version;
+
+		/// Счетчик изменений state.
+		volatile uint32_t		sequence;
+
+		uint32_t				reserved;
+
+		struct submplayer_state	state;
+	};
+
+
+
+	/// Подключается к сегменту name, опубликованному SubMPlayer'ом.
+	/// @return - сегмент или NULL в случае ошибки (причина - в errno;
+	/// EAGAIN означает, что сегмент еще не инициализирован, EPROTO - что
+	/// он имеет неподдерживаемую версию).
+	static inline const struct submplayer_state_segment* submplayer_state_open(const char* name)
+	{
+		struct stat info;
+		void* address;
+		const struct submplayer_state_segment* segment;
+		int saved_errno;
+
+		int fd = shm_open(name, O_RDONLY, 0);
+		if(fd < 0)
+			return NULL;
+
+		if(fstat(fd, &info))
+			goto error;
+
+		if((size_t) info.st_size < sizeof(struct submplayer_state_segment))
+		{
+			errno = EAGAIN;
+			goto error;
+		}
+
+		address = mmap(NULL, sizeof(struct submplayer_state_segment), PROT_READ, MAP_SHARED, fd, 0);
+		if(address == MAP_FAILED)
+			goto error;
+
+		close(fd);
+		segment = (const struct submplayer_state_segment*) address;
+
+		if(segment->magic != SUBMPLAYER_STATE_MAGIC || segment->version != SUBMPLAYER_STATE_VERSION)
+		{
+			errno = segment->magic != SUBMPLAYER_STATE_MAGIC ? EAGAIN : EPROTO;
+			saved_errno = errno;
+			munmap(address, sizeof(struct submplayer_state_segment));
+			errno = saved_errno;
+			return NULL;
+		}
+
+		__sync_synchronize();
+
+		return segment;
+
+	error:
+		saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return NULL;
+	}
+
+
+
+	/// Отключается от сегмента.
+	static inline void submplayer_state_close(const struct submplayer_state_segment* segment)
+	{
+		munmap((void*) segment, sizeof(struct submplayer_state_segment));
+	}
+
+
+
+	/// Копирует текущее состояние в state.
+	/// @return - 0 или -1, если получить согласованную копию не удалось
+	/// (errno = EAGAIN).
+	static inline int submplayer_state_read(const struct submplayer_state_segment* segment, struct submplayer_state* state)
+	{
+		uint32_t sequence;
+		int retries;
+
+		for(retries = 0; retries < SUBMPLAYER_STATE_MAX_RETRIES; retries++)
+		{
+			sequence = segment->sequence;
+
+			// Писатель изменяет состояние
+			if(sequence & 1)
+				continue;
+
+			__sync_synchronize();
+			memcpy(state, (const void*) &segment->state, sizeof *state);
+			__sync_synchronize();
+
+			if(sequence == segment->sequence)
+				return 0;
+		}
+
+		errno = EAGAIN;
+		return -1;
+	}
+
+
+	#ifdef __cplusplus
+	}
+	#endif
+
+#endif
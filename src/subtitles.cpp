@@ -26,10 +26,15 @@
 #include <functional>
 #include <vector>
 
+#include <boost/filesystem.hpp>
+
 #include <glibmm/convert.h>
 #include <glibmm/regex.h>
 
+#include <mlib/fs.hpp>
+
 #include "subtitles.hpp"
+#include "trace.hpp"
 
 
 
@@ -62,9 +67,9 @@ namespace
 
 
 
-Subtitles::Subtitle::Subtitle(Time_ms time, const std::string& text)
+Subtitles::Subtitle::Subtitle(Time_ms time, Time_ms end_time, const std::string& text)
 :
-	time(time), text(text)
+	time(time), end_time(end_time), text(text)
 {
 }
 
@@ -73,12 +78,19 @@ Subtitles::Subtitle::Subtitle(Time_ms time, const std::string& text)
 #ifdef DEVELOP_MODE
 	void Subtitles::Subtitle::dump(void) const
 	{
-		MLIB_D(_C("%1: '%2'", time, text));
+		MLIB_D(_C("%1 - %2: '%3'", time, end_time, text));
 	}
 #endif
 
 
 
+void Subtitles::add(const Subtitle& subtitle)
+{
+	this->subtitles.push_back(subtitle);
+}
+
+
+
 const Subtitles::Storage& Subtitles::get(void) const
 {
 	return this->subtitles;
@@ -88,7 +100,10 @@ const Subtitles::Storage& Subtitles::get(void) const
 
 void Subtitles::load(const std::string& file_path) throw(m::Exception)
 {
+	TRACE_SPAN("Subtitles::load");
+
 	Time_ms time = 0;
+	Time_ms end_time = 0;
 	std::string text;
 	Glib::ustring line;
 	size_t line_num = 1;
@@ -100,7 +115,7 @@ void Subtitles::load(const std::string& file_path) throw(m::Exception)
 	Glib::RefPtr<Glib::Regex> empty_line_regex = Glib::Regex::create("^\\s*$");
 	Glib::RefPtr<Glib::Regex> id_regex = Glib::Regex::create("^\\s*\\d+\\s*$");
 	Glib::RefPtr<Glib::Regex> time_regex = Glib::Regex::create(
-		"^\\s*(\\d{1,2}):(\\d{1,2}):(\\d{1,2}),(\\d{1,3})\\s+-{1,2}>\\s+\\d{1,2}:\\d{1,2}:\\d{1,2},\\d{1,3}\\s*$"
+		"^\\s*(\\d{1,2}):(\\d{1,2}):(\\d{1,2}),(\\d{1,3})\\s+-{1,2}>\\s+(\\d{1,2}):(\\d{1,2}):(\\d{1,2}),(\\d{1,3})\\s*$"
 	);
 
 
@@ -215,25 +230,32 @@ void Subtitles::load(const std::string& file_path) throw(m::Exception)
 				{
 					Glib::StringArrayHandle matches = time_regex->split(line);
 
-					if(matches.size() < 5)
+					if(matches.size() < 9)
 						M_THROW(__("invalid line %1 ('%2')", line_num, line));
 					else
 					{
-						Time_ms hours = boost::lexical_cast<int>(matches.data()[1]);
-						Time_ms minutes = boost::lexical_cast<int>(matches.data()[2]);
-						Time_ms seconds = boost::lexical_cast<int>(matches.data()[3]);
-						Time_ms mseconds = boost::lexical_cast<int>(matches.data()[4]);
-
-						if(
-							hours < 0 ||
-							minutes < 0 || minutes > 59 ||
-							seconds < 0 || seconds > 59 ||
-							mseconds < 0 || mseconds > 999
-						)
-							M_THROW(__("invalid line %1 ('%2')", line_num, line));
+						// Время появления и время исчезновения субтитра
+						Time_ms times[2];
 
+						for(size_t i = 0; i < 2; i++)
+						{
+							Time_ms hours = boost::lexical_cast<int>(matches.data()[i * 4 + 1]);
+							Time_ms minutes = boost::lexical_cast<int>(matches.data()[i * 4 + 2]);
+							Time_ms seconds = boost::lexical_cast<int>(matches.data()[i * 4 + 3]);
+							Time_ms mseconds = boost::lexical_cast<int>(matches.data()[i * 4 + 4]);
+
+							if(
+								hours < 0 ||
+								minutes < 0 || minutes > 59 ||
+								seconds < 0 || seconds > 59 ||
+								mseconds < 0 || mseconds > 999
+							)
+								M_THROW(__("invalid line %1 ('%2')", line_num, line));
+
+							times[i] = ( (hours * 60 + minutes) * 60 + seconds ) * 1000 + mseconds;
+						}
 
-						Time_ms gotten_time = ( (hours * 60 + minutes) * 60 + seconds ) * 1000 + mseconds;
+						Time_ms gotten_time = times[0];
 
 						if(gotten_time < time)
 						{
@@ -244,6 +266,8 @@ void Subtitles::load(const std::string& file_path) throw(m::Exception)
 						}
 						else
 							time = gotten_time;
+
+						end_time = std::max(time, times[1]);
 					}
 
 					state = GET_TEXT;
@@ -256,7 +280,7 @@ void Subtitles::load(const std::string& file_path) throw(m::Exception)
 					{
 						if(!text.empty())
 						{
-							this->subtitles.push_back(Subtitle(time, text));
+							this->subtitles.push_back(Subtitle(time, end_time, text));
 							text = "";
 						}
 
@@ -299,3 +323,70 @@ void Subtitles::load(const std::string& file_path) throw(m::Exception)
 	}
 #endif
 
+
+
+std::vector<std::string> find_subtitles(const std::string& file_path) throw(m::Exception)
+{
+	std::vector<std::string> subtitles_paths;
+
+	MLIB_D(_C("Finding subtitles for '%1'...", file_path));
+
+	Path file_dir_path = Path(file_path).dirname();
+	Glib::ustring play_name = m::fs::strip_extension(Path(file_path).basename()).uppercase();
+
+	try
+	{
+		for(
+			fs::directory_iterator it(U2L(file_dir_path.string()));
+			it != fs::directory_iterator(); it++
+		)
+		{
+			Glib::ustring file_name = L2U( Path(it->path()).basename() );
+			MLIB_D(_C("Gotten file: '%1'.", file_name));
+
+			if(!m::fs::check_extension(file_name, "srt"))
+				continue;
+
+			file_name = m::fs::strip_extension(file_name);
+
+			if(file_name.size() >= play_name.size() && file_name.substr(0, play_name.size()).uppercase() == play_name)
+			{
+				MLIB_D("This file is subtitles file for our playing file.");
+				subtitles_paths.push_back(L2U( it->path().string() ));
+			}
+		}
+	}
+	catch(fs::filesystem_error& e)
+	{
+		M_THROW(__("Error while reading directory '%1': %2.", file_dir_path, EE(errno)));
+	}
+
+	return subtitles_paths;
+}
+
+
+
+std::vector<Subtitles> load_subtitles(const std::vector<std::string>& paths)
+{
+	std::vector<Subtitles> subtitles;
+
+	M_FOR_CONST_IT(paths, it)
+	{
+		subtitles.push_back(Subtitles());
+
+		try
+		{
+			subtitles.back().load(*it);
+		#ifdef DEVELOP_MODE
+			subtitles.back().dump();
+		#endif
+		}
+		catch(m::Exception& e)
+		{
+			MLIB_SW(__("Error while reading subtitles file '%1': %2.", *it, EE(e)));
+			subtitles.pop_back();
+		}
+	}
+
+	return subtitles;
+}
@@ -23,6 +23,7 @@
 	#define HEADER_SUBTITLES
 
 
+	#include <string>
 	#include <vector>
 
 
@@ -34,11 +35,16 @@
 			class Subtitle
 			{
 				public:
-					Subtitle(Time_ms time, const std::string& text);
+					Subtitle(Time_ms time, Time_ms end_time, const std::string& text);
 
 
 				public:
+					/// Время появления субтитра.
 					Time_ms		time;
+
+					/// Время исчезновения субтитра.
+					Time_ms		end_time;
+
 					std::string	text;
 
 
@@ -56,6 +62,9 @@
 
 
 		public:
+			/// Добавляет субтитр в конец списка.
+			void			add(const Subtitle& subtitle);
+
 			/// Возвращает контейнер с субтитрами.
 			const Storage&	get(void) const;
 
@@ -67,5 +76,15 @@
 	#endif
 	};
 
+
+	/// Возвращает пути к файлам субтитров, соответствующих проигрываемому
+	/// файлу file_path (*.srt из той же директории, имена которых начинаются
+	/// с имени проигрываемого файла).
+	std::vector<std::string>	find_subtitles(const std::string& file_path) throw(m::Exception);
+
+	/// Загружает субтитры из файлов paths. Файлы, которые не удалось
+	/// загрузить, пропускаются с предупреждением.
+	std::vector<Subtitles>		load_subtitles(const std::vector<std::string>& paths);
+
 #endif
 
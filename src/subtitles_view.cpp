@@ -0,0 +1,663 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <glib.h>
+
+#include <pango/pango-font.h>
+#include <pango/pango-utils.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+
+#include <glibmm/main.h>
+
+#include <gdkmm/window.h>
+
+#include <gtkmm/clipboard.h>
+#include <gtkmm/imagemenuitem.h>
+#include <gtkmm/stock.h>
+#include <gtkmm/style.h>
+
+#include <sigc++/adaptors/retype_return.h>
+#include <sigc++/functors/mem_fun.h>
+
+#include "latency_stats.hpp"
+#include "subtitles.hpp"
+#include "subtitles_view.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Отступ текста от левого края.
+	const int		LEFT_MARGIN = 3;
+
+	/// Количество субтитров до и после видимой области, разметка которых
+	/// сохраняется в кэше.
+	const size_t	CACHE_MARGIN = 50;
+
+	/// Количество субтитров до и после текущего, текст которых
+	/// анализируется сразу при выборе текущего субтитра.
+	const size_t	ANALYZE_MARGIN = 500;
+
+	/// Максимальное время работы idle-обработчика, анализирующего текст
+	/// субтитров, за один вызов.
+	const Time_us	ANALYZE_SLICE = 4000;
+
+	/// Через какое количество субтитров idle-обработчик проверяет, не
+	/// истекло ли отведенное ему время.
+	const size_t	ANALYZE_CHECK_INTERVAL = 64;
+}
+
+
+
+// Text_stats -->
+	Subtitles_view::Text_stats::Text_stats(void)
+	:
+		chars(-1),
+		lines(1)
+	{
+	}
+// Text_stats <--
+
+
+
+// Heights -->
+	Subtitles_view::Heights::Heights(void)
+	:
+		tree(1)
+	{
+	}
+
+
+
+	size_t Subtitles_view::Heights::find(int offset) const
+	{
+		size_t size = this->size();
+		size_t step = 1;
+		size_t id = 0;
+
+		if(offset < 0)
+			return 0;
+
+		while(step * 2 <= size)
+			step *= 2;
+
+		// Спускаемся по дереву, находя наибольшее количество субтитров,
+		// суммарная высота которых не превышает offset.
+		for(; step; step /= 2)
+		{
+			if(id + step <= size && this->tree[id + step] <= offset)
+			{
+				id += step;
+				offset -= this->tree[id];
+			}
+		}
+
+		return id;
+	}
+
+
+
+	int Subtitles_view::Heights::get(size_t id) const
+	{
+		return this->heights[id];
+	}
+
+
+
+	int Subtitles_view::Heights::get_offset(size_t id) const
+	{
+		int offset = 0;
+
+		for(; id; id -= id & -id)
+			offset += this->tree[id];
+
+		return offset;
+	}
+
+
+
+	int Subtitles_view::Heights::get_total(void) const
+	{
+		return this->get_offset(this->size());
+	}
+
+
+
+	void Subtitles_view::Heights::reset(const std::vector<int>& heights)
+	{
+		size_t size = heights.size();
+
+		this->heights = heights;
+		this->tree.assign(size + 1, 0);
+
+		// Строим дерево за линейное время
+		for(size_t id = 1; id <= size; id++)
+		{
+			this->tree[id] += heights[id - 1];
+
+			size_t parent = id + (id & -id);
+			if(parent <= size)
+				this->tree[parent] += this->tree[id];
+		}
+	}
+
+
+
+	void Subtitles_view::Heights::set(size_t id, int height)
+	{
+		int delta = height - this->heights[id];
+
+		if(!delta)
+			return;
+
+		this->heights[id] = height;
+
+		for(id++; id < this->tree.size(); id += id & -id)
+			this->tree[id] += delta;
+	}
+
+
+
+	size_t Subtitles_view::Heights::size(void) const
+	{
+		return this->heights.size();
+	}
+// Heights <--
+
+
+
+// Subtitles_view -->
+	Subtitles_view::Subtitles_view(const Subtitles& subtitles, Gtk::Adjustment& adjustment)
+	:
+		subtitles(subtitles),
+		stats(subtitles.get().size()),
+		analyze_pos(0),
+		cur_id(0),
+		adjustment(adjustment),
+		highlight_mode(get_highlight_mode()),
+		selected_id(std::string::npos),
+		wrap_width(0),
+		char_width(1),
+		line_height(1)
+	{
+		this->set_flags(Gtk::CAN_FOCUS);
+		this->add_events(Gdk::SCROLL_MASK | Gdk::BUTTON_PRESS_MASK);
+
+		// Контекстное меню -->
+		{
+			Gtk::MenuItem* item = Gtk::manage( new Gtk::ImageMenuItem(Gtk::Stock::COPY) );
+			item->signal_activate().connect(
+				sigc::hide_return(sigc::mem_fun(*this, &Subtitles_view::copy_selection)) );
+			this->popup_menu.append(*item);
+			this->popup_menu.show_all();
+		}
+		// Контекстное меню <--
+
+		this->signal_button_press_event().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_button_press_event_cb) );
+		this->signal_expose_event().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_expose_event_cb) );
+		this->signal_scroll_event().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_scroll_event_cb) );
+		this->signal_size_allocate().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_size_allocate_cb) );
+		this->signal_style_changed().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_style_changed_cb) );
+		this->adjustment.signal_value_changed().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_adjustment_value_changed_cb) );
+
+		this->reset_layout();
+
+		// Анализ текста выполняется с более низким приоритетом, чем
+		// перерисовка и обработка событий.
+		this->analyze_connection = Glib::signal_idle().connect(
+			sigc::mem_fun(*this, &Subtitles_view::on_analyze_cb) );
+	}
+
+
+
+	void Subtitles_view::analyze(size_t id)
+	{
+		Text_stats& stats = this->stats[id];
+
+		if(stats.chars >= 0)
+			return;
+
+		const std::string& text = this->subtitles.get()[id].text;
+		stats.chars = g_utf8_strlen(text.c_str(), -1);
+		stats.lines = std::count(text.begin(), text.end(), '\n') + 1;
+
+		if(this->wrap_width > 0 && !this->measured[id])
+			this->heights.set(id, this->estimate_height(id));
+	}
+
+
+
+	bool Subtitles_view::copy_selection(void)
+	{
+		if(this->selected_id == std::string::npos)
+			return false;
+
+		Gtk::Clipboard::get()->set_text(this->subtitles.get()[this->selected_id].text);
+
+		return true;
+	}
+
+
+
+	void Subtitles_view::drop_layouts(size_t first, size_t last)
+	{
+		first = first > CACHE_MARGIN ? first - CACHE_MARGIN : 0;
+		last += CACHE_MARGIN;
+
+		std::map<size_t, Glib::RefPtr<Pango::Layout> >::iterator it = this->layouts.begin();
+
+		while(it != this->layouts.end())
+		{
+			if(
+				(it->first < first || it->first >= last) &&
+				it->first != this->cur_id && it->first != this->selected_id
+			)
+				this->layouts.erase(it++);
+			else
+				++it;
+		}
+	}
+
+
+
+	Subtitles_view::Highlight_mode Subtitles_view::get_highlight_mode(void)
+	{
+		const char* value = getenv(HIGHLIGHT_ENV_NAME);
+
+		if(!value || !strcmp(value, "background"))
+			return HIGHLIGHT_BACKGROUND;
+		else if(!strcmp(value, "font"))
+			return HIGHLIGHT_FONT;
+		else
+		{
+			MLIB_SW(__("Invalid %1 value: '%2'.", HIGHLIGHT_ENV_NAME, value));
+			return HIGHLIGHT_BACKGROUND;
+		}
+	}
+
+
+
+	int Subtitles_view::estimate_height(size_t id) const
+	{
+		const Text_stats& stats = this->stats[id];
+
+		if(stats.chars < 0)
+			return this->line_height;
+
+		int lines = (stats.chars * this->char_width + this->wrap_width - 1) / this->wrap_width;
+		return std::max(lines, stats.lines) * this->line_height;
+	}
+
+
+
+	Glib::RefPtr<Pango::Layout> Subtitles_view::get_layout(size_t id)
+	{
+		Glib::RefPtr<Pango::Layout>& layout = this->layouts[id];
+
+		if(!layout)
+		{
+			layout = this->create_pango_layout(this->subtitles.get()[id].text);
+			layout->set_font_description(
+				id == this->cur_id && this->highlight_mode == HIGHLIGHT_FONT
+					? this->current_font : this->font );
+			layout->set_wrap(Pango::WRAP_WORD);
+			layout->set_width(this->wrap_width * PANGO_SCALE);
+		}
+
+		if(!this->measured[id])
+		{
+			int width, height;
+			layout->get_pixel_size(width, height);
+
+			this->heights.set(id, height);
+			this->measured[id] = true;
+		}
+
+		return layout;
+	}
+
+
+
+	bool Subtitles_view::on_analyze_cb(void)
+	{
+		TRACE_SPAN("Subtitles_view::analyze");
+
+		Time_us deadline = m::get_monotonic_time() + ANALYZE_SLICE;
+		size_t size = this->stats.size();
+
+		// Запоминаем, какой субтитр находится вверху видимой области, чтобы
+		// уточнение высот субтитров над ним не сдвинуло изображение.
+		int top = static_cast<int>(this->adjustment.get_value());
+		size_t anchor = this->heights.find(top);
+		int anchor_shift = top - this->heights.get_offset(anchor);
+
+		while(this->analyze_pos < size)
+		{
+			this->analyze(this->analyze_pos++);
+
+			if(
+				!(this->analyze_pos % ANALYZE_CHECK_INTERVAL) &&
+				m::get_monotonic_time() >= deadline
+			)
+				break;
+		}
+
+		this->update_adjustment();
+		this->adjustment.set_value(std::min(
+			static_cast<double>(this->heights.get_offset(anchor) + anchor_shift),
+			this->adjustment.get_upper() - this->adjustment.get_page_size()
+		));
+
+		return this->analyze_pos < size;
+	}
+
+
+
+	void Subtitles_view::on_adjustment_value_changed_cb(void)
+	{
+		this->queue_draw();
+	}
+
+
+
+	bool Subtitles_view::on_button_press_event_cb(GdkEventButton* event)
+	{
+		if(event->type != GDK_BUTTON_PRESS || ( event->button != 1 && event->button != 3 ))
+			return false;
+
+		this->grab_focus();
+
+		// Субтитр под указателем -->
+		{
+			size_t id = this->heights.find(static_cast<int>(this->adjustment.get_value() + event->y));
+
+			if(id >= this->stats.size())
+				id = std::string::npos;
+
+			this->select(id);
+		}
+		// Субтитр под указателем <--
+
+		if(event->button == 3 && this->selected_id != std::string::npos)
+			this->popup_menu.popup(event->button, event->time);
+
+		return true;
+	}
+
+
+
+	bool Subtitles_view::on_expose_event_cb(GdkEventExpose* event)
+	{
+		Time_us start_time = m::get_monotonic_time();
+		Glib::RefPtr<Gdk::Window> window = this->get_window();
+		Glib::RefPtr<Gtk::Style> style = this->get_style();
+		Gtk::Allocation allocation = this->get_allocation();
+
+		window->draw_rectangle(
+			style->get_base_gc(this->get_state()), true,
+			0, 0, allocation.get_width(), allocation.get_height()
+		);
+
+		if(this->wrap_width <= 0 || this->stats.empty())
+			return true;
+
+		int total_height = this->heights.get_total();
+		int top = static_cast<int>(this->adjustment.get_value());
+		size_t first = this->heights.find(top);
+		size_t id = first;
+
+		// Разметка субтитров, начиная с first, не меняет положение самого
+		// first, поэтому прокрутка во время отрисовки не сбивается.
+		for(
+			int y = this->heights.get_offset(first) - top;
+			id < this->stats.size() && y < allocation.get_height();
+			id++
+		)
+		{
+			Glib::RefPtr<Pango::Layout> layout = this->get_layout(id);
+			Gtk::StateType state = this->get_state();
+
+			// Текущий субтитр выделяется цветом выделенного текста, а
+			// выделенный пользователем - цветом выделенного текста в
+			// виджете без фокуса ввода.
+			if(id == this->cur_id && this->highlight_mode == HIGHLIGHT_BACKGROUND)
+				state = Gtk::STATE_SELECTED;
+			else if(id == this->selected_id)
+				state = Gtk::STATE_ACTIVE;
+
+			if(state != this->get_state())
+			{
+				window->draw_rectangle(
+					style->get_base_gc(state), true,
+					0, y, allocation.get_width(), this->heights.get(id)
+				);
+			}
+
+			window->draw_layout(style->get_text_gc(state), LEFT_MARGIN, y, layout);
+			y += this->heights.get(id);
+		}
+
+		this->drop_layouts(first, id);
+
+		if(this->heights.get_total() != total_height)
+			this->update_adjustment();
+
+		record_latency(LATENCY_REDRAW, m::get_monotonic_time() - start_time);
+
+		return true;
+	}
+
+
+
+	bool Subtitles_view::on_scroll_event_cb(GdkEventScroll* event)
+	{
+		double step = 3 * this->line_height;
+		double max_value = this->adjustment.get_upper() - this->adjustment.get_page_size();
+		double value = this->adjustment.get_value();
+
+		switch(event->direction)
+		{
+			case GDK_SCROLL_UP:
+				value -= step;
+				break;
+
+			case GDK_SCROLL_DOWN:
+				value += step;
+				break;
+
+			default:
+				return false;
+		}
+
+		this->adjustment.set_value(std::max(0.0, std::min(value, max_value)));
+
+		return true;
+	}
+
+
+
+	void Subtitles_view::on_size_allocate_cb(Gtk::Allocation& allocation)
+	{
+		if(allocation.get_width() - LEFT_MARGIN != this->wrap_width)
+			this->reset_layout();
+
+		this->set_current(this->cur_id);
+	}
+
+
+
+	void Subtitles_view::on_style_changed_cb(const Glib::RefPtr<Gtk::Style>& previous_style)
+	{
+		this->reset_layout();
+		this->set_current(this->cur_id);
+	}
+
+
+
+	void Subtitles_view::reset_layout(void)
+	{
+		// Шрифты -->
+			this->font = this->get_style()->get_font();
+
+			this->current_font = this->font;
+			this->current_font.set_size(static_cast<int>(this->font.get_size() * PANGO_SCALE_X_LARGE));
+		#if PANGO_VERSION_CHECK(1, 24, 0)
+			this->current_font.set_weight(static_cast<Pango::Weight>(PANGO_WEIGHT_MEDIUM));
+		#else
+			this->current_font.set_weight(static_cast<Pango::Weight>(
+				(PANGO_WEIGHT_NORMAL + PANGO_WEIGHT_SEMIBOLD) / 2 ));
+		#endif
+		// Шрифты <--
+
+		// Метрики -->
+		{
+			Pango::FontMetrics metrics = this->get_pango_context()->get_metrics(this->font);
+
+			this->char_width = std::max(1, metrics.get_approximate_char_width() / PANGO_SCALE);
+			this->line_height = std::max(1,
+				(metrics.get_ascent() + metrics.get_descent()) / PANGO_SCALE);
+			this->wrap_width = this->get_allocation().get_width() - LEFT_MARGIN;
+		}
+		// Метрики <--
+
+		// Оценочные высоты -->
+		{
+			std::vector<int> heights(this->stats.size());
+
+			if(this->wrap_width > 0)
+			{
+				for(size_t id = 0; id < heights.size(); id++)
+					heights[id] = this->estimate_height(id);
+			}
+
+			this->heights.reset(heights);
+			this->measured.assign(heights.size(), false);
+			this->layouts.clear();
+		}
+		// Оценочные высоты <--
+
+		this->update_adjustment();
+		this->queue_draw();
+	}
+
+
+
+	void Subtitles_view::select(size_t id)
+	{
+		if(id == this->selected_id)
+			return;
+
+		this->selected_id = id;
+
+		if(id != std::string::npos)
+			Gtk::Clipboard::get(GDK_SELECTION_PRIMARY)->set_text(this->subtitles.get()[id].text);
+
+		this->queue_draw();
+	}
+
+
+
+	void Subtitles_view::set_current(size_t id)
+	{
+		if(id >= this->stats.size())
+			return;
+
+		// Если текущим стал еще не проанализированный субтитр, то
+		// анализируем субтитры вокруг него, не дожидаясь idle-обработчика.
+		if(this->stats[id].chars < 0)
+		{
+			size_t end = std::min(id + ANALYZE_MARGIN, this->stats.size());
+
+			for(size_t i = id > ANALYZE_MARGIN ? id - ANALYZE_MARGIN : 0; i < end; i++)
+				this->analyze(i);
+		}
+
+		// Текущий субтитр отображается другим шрифтом - разметку старого и
+		// нового текущих субтитров необходимо обновить.
+		if(this->highlight_mode == HIGHLIGHT_FONT)
+		{
+			this->layouts.erase(this->cur_id);
+			this->measured[this->cur_id] = false;
+
+			this->layouts.erase(id);
+			this->measured[id] = false;
+		}
+
+		this->cur_id = id;
+
+		if(this->wrap_width <= 0)
+			return;
+
+		// Размечаем субтитры, которые окажутся в видимой области, до того,
+		// как вычислять позицию прокрутки, чтобы она не сбилась при
+		// отрисовке. При выделении фоном они, как правило, уже размечены, и
+		// это сводится к нескольким обращениям к кэшу.
+		// -->
+		{
+			int page_height = this->get_allocation().get_height();
+			int covered = 0;
+
+			for(size_t i = id + 1; i-- > 0 && covered < page_height; )
+			{
+				this->get_layout(i);
+				covered += this->heights.get(i);
+			}
+		}
+		// <--
+
+		this->update_adjustment();
+		this->adjustment.set_value(std::max(0,
+			this->heights.get_offset(id + 1) - static_cast<int>(this->adjustment.get_page_size()) ));
+		this->queue_draw();
+	}
+
+
+
+	void Subtitles_view::update_adjustment(void)
+	{
+		GtkAdjustment* adjustment = this->adjustment.gobj();
+		int page_height = std::max(1, this->get_allocation().get_height());
+		int total_height = this->heights.get_total();
+
+		adjustment->lower = 0;
+		adjustment->upper = std::max(total_height, page_height);
+		adjustment->page_size = page_height;
+		adjustment->step_increment = this->line_height;
+		adjustment->page_increment = page_height * 0.9;
+
+		this->adjustment.changed();
+
+		if(adjustment->value > adjustment->upper - adjustment->page_size)
+			this->adjustment.set_value(adjustment->upper - adjustment->page_size);
+	}
+// Subtitles_view <--
+
@@ -0,0 +1,269 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_SUBTITLES_VIEW
+	#define HEADER_SUBTITLES_VIEW
+
+	#include <map>
+	#include <string>
+	#include <vector>
+
+	#include <gtkmm/adjustment.h>
+	#include <gtkmm/drawingarea.h>
+	#include <gtkmm/menu.h>
+
+	#include <pangomm/fontdescription.h>
+	#include <pangomm/layout.h>
+
+	#include <sigc++/connection.h>
+
+	class Subtitles;
+
+
+	/// Переменная окружения, задающая способ выделения текущего субтитра
+	/// (см. Subtitles_view::Highlight_mode): "background" (по умолчанию) или
+	/// "font".
+	#define HIGHLIGHT_ENV_NAME "SUBMPLAYER_HIGHLIGHT"
+
+
+	/// Список субтитров одной дорожки.
+	///
+	/// В отличие от Gtk::TextView, размечает и хранит разметку
+	/// (Pango::Layout) только тех субтитров, которые находятся в видимой
+	/// области или рядом с ней. Для остальных субтитров высота оценивается
+	/// по количеству символов, а позиция каждого субтитра в списке
+	/// вычисляется по префиксным суммам высот (дерево Фенвика), которые
+	/// уточняются по мере разметки субтитров. Поэтому время создания списка
+	/// и занимаемая им память почти не зависят от количества субтитров.
+	///
+	/// Текст субтитров не копируется, а анализируется (для оценки высоты)
+	/// постепенно: субтитры рядом с текущим - сразу, остальные - порциями
+	/// в idle-обработчике, не занимающими Main loop дольше нескольких
+	/// миллисекунд. До анализа высота субтитра считается равной одной
+	/// строке.
+	///
+	/// Прокрутка осуществляется через adjustment, который обычно
+	/// подключается к Gtk::VScrollbar.
+	///
+	/// Щелчком мыши можно выделить субтитр - его текст становится
+	/// первичным выделением X (PRIMARY) и копируется в буфер обмена
+	/// пунктом контекстного меню или методом copy_selection().
+	class Subtitles_view: public Gtk::DrawingArea
+	{
+		public:
+			/// Способ выделения текущего субтитра.
+			enum Highlight_mode {
+				/// Цветом фона. Не меняет размеры субтитров, поэтому смена
+				/// текущего субтитра не требует ни разметки, ни пересчета
+				/// высот, а позиция прокрутки вычисляется сразу точно.
+				HIGHLIGHT_BACKGROUND,
+
+				/// Увеличенным шрифтом. Старый и новый текущие субтитры
+				/// размечаются заново при каждой смене.
+				HIGHLIGHT_FONT
+			};
+
+
+		private:
+			/// Характеристики текста субтитра, по которым оценивается его
+			/// высота.
+			struct Text_stats
+			{
+				Text_stats(void);
+
+				/// Количество символов в тексте или -1, если текст еще не
+				/// проанализирован.
+				int	chars;
+
+				/// Количество строк в тексте без учета переносов.
+				int	lines;
+			};
+
+			/// Префиксные суммы высот субтитров.
+			class Heights
+			{
+				public:
+					Heights(void);
+
+
+				private:
+					/// Высота каждого субтитра.
+					std::vector<int>	heights;
+
+					/// Дерево Фенвика по heights (элемент 0 не используется).
+					std::vector<int>	tree;
+
+
+				public:
+					/// Возвращает номер субтитра, в который попадает точка с
+					/// координатой offset, или size(), если offset находится
+					/// за концом списка.
+					size_t	find(int offset) const;
+
+					/// Возвращает высоту субтитра id.
+					int		get(size_t id) const;
+
+					/// Возвращает суммарную высоту субтитров, предшествующих
+					/// субтитру id.
+					int		get_offset(size_t id) const;
+
+					/// Возвращает суммарную высоту всех субтитров.
+					int		get_total(void) const;
+
+					/// Заменяет высоты всех субтитров.
+					void	reset(const std::vector<int>& heights);
+
+					/// Задает высоту субтитра id.
+					void	set(size_t id, int height);
+
+					/// Возвращает количество субтитров.
+					size_t	size(void) const;
+			};
+
+
+		public:
+			/// subtitles должны существовать все время существования списка.
+			Subtitles_view(const Subtitles& subtitles, Gtk::Adjustment& adjustment);
+
+
+		private:
+			/// Субтитры.
+			const Subtitles&			subtitles;
+
+			/// Характеристики текста каждого субтитра.
+			std::vector<Text_stats>		stats;
+
+			/// Субтитр, с которого idle-обработчик продолжит анализ текста.
+			size_t						analyze_pos;
+
+			/// Idle-обработчик, анализирующий текст субтитров.
+			sigc::connection			analyze_connection;
+
+			/// Текущий субтитр.
+			size_t						cur_id;
+
+			/// Adjustment, задающий прокрутку списка.
+			Gtk::Adjustment&			adjustment;
+
+			/// Способ выделения текущего субтитра.
+			Highlight_mode				highlight_mode;
+
+			/// Субтитр, выделенный пользователем, или std::string::npos.
+			size_t						selected_id;
+
+			/// Контекстное меню.
+			Gtk::Menu					popup_menu;
+
+
+			/// Шрифт субтитров.
+			Pango::FontDescription		font;
+
+			/// Шрифт текущего субтитра (в режиме HIGHLIGHT_FONT).
+			Pango::FontDescription		current_font;
+
+			/// Ширина, по которой переносятся строки.
+			int							wrap_width;
+
+			/// Средняя ширина символа.
+			int							char_width;
+
+			/// Высота строки.
+			int							line_height;
+
+
+			/// Высоты субтитров: оценочные или, для размеченных субтитров,
+			/// точные.
+			Heights						heights;
+
+			/// Для каких субтитров высота в heights точная.
+			std::vector<bool>			measured;
+
+			/// Разметка субтитров, находящихся в видимой области или рядом с
+			/// ней.
+			std::map<size_t,
+				Glib::RefPtr<Pango::Layout> >	layouts;
+
+
+		public:
+			/// Копирует текст выделенного пользователем субтитра в буфер
+			/// обмена.
+			/// @return - false, если ни один субтитр не выделен.
+			bool	copy_selection(void);
+
+			/// Делает субтитр id текущим и прокручивает список так, чтобы он
+			/// находился внизу видимой области.
+			void	set_current(size_t id);
+
+		private:
+			/// Анализирует текст субтитра id, если он еще не
+			/// проанализирован, и уточняет оценку его высоты.
+			void	analyze(size_t id);
+
+			/// Возвращает способ выделения, заданный переменной окружения
+			/// HIGHLIGHT_ENV_NAME.
+			static Highlight_mode	get_highlight_mode(void);
+
+			/// Удаляет из кэша разметку субтитров, находящихся далеко от
+			/// субтитров [first, last).
+			void	drop_layouts(size_t first, size_t last);
+
+			/// Возвращает оценочную высоту субтитра id.
+			int		estimate_height(size_t id) const;
+
+			/// Возвращает разметку субтитра id, размечая его, если
+			/// необходимо. Заменяет оценочную высоту субтитра точной.
+			Glib::RefPtr<Pango::Layout>	get_layout(size_t id);
+
+			/// Idle-обработчик, анализирующий очередную порцию субтитров.
+			bool	on_analyze_cb(void);
+
+			/// Обработчик сигнала на изменение позиции прокрутки.
+			void	on_adjustment_value_changed_cb(void);
+
+			/// Обработчик нажатия кнопки мыши - выделяет субтитр под
+			/// указателем и, для правой кнопки, показывает контекстное меню.
+			bool	on_button_press_event_cb(GdkEventButton* event);
+
+			/// Обработчик сигнала на перерисовку.
+			bool	on_expose_event_cb(GdkEventExpose* event);
+
+			/// Обработчик сигнала на прокрутку колесом мыши.
+			bool	on_scroll_event_cb(GdkEventScroll* event);
+
+			/// Обработчик сигнала на изменение размеров.
+			void	on_size_allocate_cb(Gtk::Allocation& allocation);
+
+			/// Обработчик сигнала на изменение стиля.
+			void	on_style_changed_cb(const Glib::RefPtr<Gtk::Style>& previous_style);
+
+			/// Пересчитывает метрики шрифта и оценочные высоты всех
+			/// субтитров.
+			void	reset_layout(void);
+
+			/// Выделяет субтитр id (std::string::npos - снимает выделение).
+			void	select(size_t id);
+
+			/// Приводит параметры adjustment в соответствие с высотой списка
+			/// и видимой области.
+			void	update_adjustment(void);
+	};
+
+#endif
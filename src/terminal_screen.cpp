@@ -0,0 +1,453 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+#include <algorithm>
+
+#include <glibmm/convert.h>
+
+#include "terminal_screen.hpp"
+
+
+
+namespace
+{
+	/// Размер терминала, если его не удалось определить.
+	const int	DEFAULT_ROWS = 24;
+	const int	DEFAULT_COLS = 80;
+
+	/// Переключает терминал на альтернативный экран и скрывает курсор.
+	const char	INIT_SEQUENCE[] = "\x1b[?1049h\x1b[?25l";
+
+	/// Возвращает терминал в исходное состояние.
+	const char	RESTORE_SEQUENCE[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+
+	/// Файловый дескриптор терминала существующего объекта Terminal_screen
+	/// или -1.
+	int			ACTIVE_FD = -1;
+
+
+	/// Заменяет в text недопустимые для UTF-8 байты на '?'.
+	std::string	make_valid_utf8(const std::string& text);
+
+	/// Добавляет в lines строку line, отбрасывая пробелы в ее конце.
+	void		push_wrapped_line(std::string line, std::vector<std::string>* lines);
+
+
+
+	std::string make_valid_utf8(const std::string& text)
+	{
+		std::string valid;
+		const char* data = text.data();
+		const char* end = data + text.size();
+		const char* invalid;
+
+		while(!g_utf8_validate(data, end - data, &invalid))
+		{
+			valid.append(data, invalid);
+			valid += '?';
+			data = invalid + 1;
+		}
+
+		valid.append(data, end);
+
+		return valid;
+	}
+
+
+
+	void push_wrapped_line(std::string line, std::vector<std::string>* lines)
+	{
+		line.erase(line.find_last_not_of(' ') + 1);
+		lines->push_back(line);
+	}
+}
+
+
+
+// Cell -->
+	Terminal_screen::Cell::Cell(void)
+	:
+		attrs(ATTR_NORMAL),
+		width(1)
+	{
+	}
+
+
+
+	bool Terminal_screen::Cell::operator!=(const Cell& cell) const
+	{
+		return this->attrs != cell.attrs || this->width != cell.width || this->data != cell.data;
+	}
+// Cell <--
+
+
+
+// Terminal_screen -->
+	Terminal_screen::Terminal_screen(int fd)
+	:
+		fd(fd),
+		rows(0),
+		cols(0),
+		full_redraw(true),
+		utf8(Glib::get_charset())
+	{
+		this->write(INIT_SEQUENCE);
+		ACTIVE_FD = fd;
+
+		this->update_size();
+	}
+
+
+
+	Terminal_screen::~Terminal_screen(void)
+	{
+		this->write(RESTORE_SEQUENCE);
+		ACTIVE_FD = -1;
+	}
+
+
+
+	void Terminal_screen::clear(void)
+	{
+		this->back.assign(this->back.size(), Cell());
+	}
+
+
+
+	void Terminal_screen::flush(void)
+	{
+		std::string output;
+		int cur_row = -1;
+		int cur_col = -1;
+		int cur_attrs = -1;
+
+		if(this->full_redraw)
+		{
+			output += "\x1b[0m\x1b[H\x1b[2J";
+			cur_row = cur_col = 0;
+			cur_attrs = ATTR_NORMAL;
+
+			this->front.assign(this->back.size(), Cell());
+			this->full_redraw = false;
+		}
+
+		for(int row = 0; row < this->rows; row++)
+		{
+			for(int col = 0; col < this->cols; col++)
+			{
+				size_t id = row * this->cols + col;
+				const Cell& cell = this->back[id];
+
+				if(!(cell != this->front[id]))
+					continue;
+
+				this->front[id] = cell;
+
+				// Позиция занята предыдущим широким символом, который уже
+				// выведен.
+				if(!cell.width)
+					continue;
+
+				// Перемещаем курсор, только если он находится не там, где
+				// нужно.
+				if(row != cur_row || col != cur_col)
+				{
+					char buf[32];
+					snprintf(buf, sizeof buf, "\x1b[%d;%dH", row + 1, col + 1);
+					output += buf;
+				}
+
+				if(cell.attrs != cur_attrs)
+				{
+					output += "\x1b[0";
+					if(cell.attrs & ATTR_BOLD)
+						output += ";1";
+					if(cell.attrs & ATTR_DIM)
+						output += ";2";
+					if(cell.attrs & ATTR_REVERSE)
+						output += ";7";
+					output += 'm';
+
+					cur_attrs = cell.attrs;
+				}
+
+				if(cell.data.empty())
+					output += ' ';
+				else
+					output += cell.data;
+
+				cur_row = row;
+				cur_col = col + cell.width;
+			}
+		}
+
+		if(output.empty())
+			return;
+
+		this->write(this->utf8 ? output : U2L(output));
+	}
+
+
+
+	int Terminal_screen::get_char_width(gunichar c)
+	{
+		if(g_unichar_iszerowidth(c))
+			return 0;
+		else if(g_unichar_iswide(c))
+			return 2;
+		else
+			return 1;
+	}
+
+
+
+	int Terminal_screen::get_cols(void) const
+	{
+		return this->cols;
+	}
+
+
+
+	int Terminal_screen::get_rows(void) const
+	{
+		return this->rows;
+	}
+
+
+
+	int Terminal_screen::put(int row, int col, int width, const std::string& text, int attrs)
+	{
+		if(row < 0 || row >= this->rows || col < 0)
+			return 0;
+
+		std::string valid_text = make_valid_utf8(text);
+		int end = std::min(this->cols, col + width);
+		int pos = col;
+		Cell* prev_cell = NULL;
+
+		for(const char* it = valid_text.c_str(); *it; it = g_utf8_next_char(it))
+		{
+			const char* next = g_utf8_next_char(it);
+			gunichar c = g_utf8_get_char(it);
+			int char_width = this->get_char_width(c);
+
+			// Комбинируемые символы дописываем к предыдущему
+			if(!char_width)
+			{
+				if(prev_cell)
+					prev_cell->data.append(it, next);
+				continue;
+			}
+
+			if(pos + char_width > end)
+				break;
+
+			Cell& cell = this->back[row * this->cols + pos];
+
+			if(c < 0x20 || c == 0x7f)
+				cell.data.clear();
+			else
+				cell.data.assign(it, next);
+
+			cell.attrs = attrs;
+			cell.width = char_width;
+
+			if(char_width == 2)
+			{
+				Cell& next_cell = this->back[row * this->cols + pos + 1];
+				next_cell.data.clear();
+				next_cell.attrs = attrs;
+				next_cell.width = 0;
+			}
+
+			prev_cell = &cell;
+			pos += char_width;
+		}
+
+		return pos - col;
+	}
+
+
+
+	bool Terminal_screen::update_size(void)
+	{
+		struct winsize size;
+		int rows = DEFAULT_ROWS;
+		int cols = DEFAULT_COLS;
+
+		if(!ioctl(this->fd, TIOCGWINSZ, &size) && size.ws_row && size.ws_col)
+		{
+			rows = size.ws_row;
+			cols = size.ws_col;
+		}
+
+		if(rows == this->rows && cols == this->cols)
+			return false;
+
+		this->rows = rows;
+		this->cols = cols;
+		this->back.assign(rows * cols, Cell());
+		this->full_redraw = true;
+
+		return true;
+	}
+
+
+
+	void Terminal_screen::wrap(const std::string& text, int width, std::vector<std::string>* lines)
+	{
+		std::string valid_text = make_valid_utf8(text);
+		size_t paragraph_start = 0;
+
+		while(true)
+		{
+			size_t paragraph_end = valid_text.find('\n', paragraph_start);
+			std::string paragraph = valid_text.substr(paragraph_start,
+				paragraph_end == std::string::npos ? std::string::npos : paragraph_end - paragraph_start);
+
+			// Разбиваем абзац на строки -->
+			{
+				const char* data = paragraph.c_str();
+				size_t line_start = 0;
+				size_t space_pos = std::string::npos;
+				int line_width = 0;
+				int width_after_space = 0;
+				bool continuation = false;
+
+				for(const char* it = data; *it; it = g_utf8_next_char(it))
+				{
+					gunichar c = g_utf8_get_char(it);
+					int char_width = get_char_width(c);
+					size_t pos = it - data;
+
+					if(c == ' ')
+					{
+						// Продолжение строки начинается не с пробела
+						if(continuation && pos == line_start)
+						{
+							line_start = pos + 1;
+							continue;
+						}
+
+						// Пробел, не помещающийся в строку, - место переноса,
+						// в саму строку он не попадает.
+						if(line_width + char_width > width)
+						{
+							push_wrapped_line(paragraph.substr(line_start, pos - line_start), lines);
+							line_start = pos + 1;
+							line_width = 0;
+							space_pos = std::string::npos;
+							continuation = true;
+							continue;
+						}
+
+						space_pos = pos;
+						width_after_space = 0;
+					}
+					else
+					{
+						if(line_width + char_width > width && pos != line_start)
+						{
+							// Переносим по последнему пробелу, а если его нет -
+							// посреди слова.
+							if(space_pos != std::string::npos)
+							{
+								push_wrapped_line(paragraph.substr(line_start, space_pos - line_start), lines);
+								line_start = space_pos + 1;
+								line_width = width_after_space;
+								space_pos = std::string::npos;
+							}
+							else
+							{
+								lines->push_back(paragraph.substr(line_start, pos - line_start));
+								line_start = pos;
+								line_width = 0;
+							}
+
+							continuation = true;
+						}
+
+						width_after_space += char_width;
+					}
+
+					line_width += char_width;
+				}
+
+				// Абзац, заканчивающийся местом переноса, не порождает пустую
+				// строку.
+				if(!continuation || line_start < paragraph.size())
+					push_wrapped_line(paragraph.substr(line_start), lines);
+			}
+			// Разбиваем абзац на строки <--
+
+			if(paragraph_end == std::string::npos)
+				break;
+
+			paragraph_start = paragraph_end + 1;
+		}
+	}
+
+
+
+	void Terminal_screen::write(const std::string& data)
+	{
+		const char* pos = data.data();
+		size_t size = data.size();
+
+		while(size)
+		{
+			ssize_t written = ::write(this->fd, pos, size);
+
+			if(written < 0)
+			{
+				if(errno == EINTR)
+					continue;
+
+				MLIB_D(_C("Can't write to the terminal: %1.", EE(errno)));
+				break;
+			}
+
+			pos += written;
+			size -= written;
+		}
+	}
+// Terminal_screen <--
+
+
+
+void restore_terminal_screen(void)
+{
+	if(ACTIVE_FD < 0)
+		return;
+
+	ssize_t rval = write(ACTIVE_FD, RESTORE_SEQUENCE, sizeof RESTORE_SEQUENCE - 1);
+	(void) rval;
+
+	ACTIVE_FD = -1;
+}
+
@@ -0,0 +1,147 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_TERMINAL_SCREEN
+	#define HEADER_TERMINAL_SCREEN
+
+	#include <glib.h>
+
+	#include <string>
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+
+
+	/// Экран терминала с двойной буферизацией.
+	///
+	/// Изображение формируется во внутреннем буфере, а flush() сравнивает
+	/// его с тем, что уже отображено в терминале, и выводит только
+	/// изменившиеся символы, минимальным количеством управляющих
+	/// последовательностей и одним вызовом write().
+	///
+	/// На время своего существования переключает терминал на
+	/// альтернативный экран и скрывает курсор.
+	class Terminal_screen: public boost::noncopyable
+	{
+		public:
+			/// Атрибуты символов.
+			enum Attribute {
+				ATTR_NORMAL		= 0,
+				ATTR_BOLD		= 1 << 0,
+				ATTR_DIM		= 1 << 1,
+				ATTR_REVERSE	= 1 << 2
+			};
+
+
+		private:
+			/// Одна позиция экрана.
+			struct Cell
+			{
+				Cell(void);
+
+				bool	operator!=(const Cell& cell) const;
+
+				/// Символ в кодировке UTF-8 (вместе с последующими
+				/// комбинируемыми символами). Пустая строка означает пробел.
+				std::string	data;
+
+				/// Атрибуты символа.
+				int			attrs;
+
+				/// Количество позиций, занимаемых символом: 1, 2 для широких
+				/// символов или 0 для позиции, занятой предыдущим широким
+				/// символом.
+				int			width;
+			};
+
+
+		public:
+			Terminal_screen(int fd);
+			~Terminal_screen(void);
+
+
+		private:
+			/// Файловый дескриптор терминала.
+			int					fd;
+
+			/// Количество строк.
+			int					rows;
+
+			/// Количество столбцов.
+			int					cols;
+
+			/// Изображение, отображенное в терминале.
+			std::vector<Cell>	front;
+
+			/// Формируемое изображение.
+			std::vector<Cell>	back;
+
+			/// Нужно ли перерисовать экран целиком (содержимое терминала
+			/// неизвестно).
+			bool				full_redraw;
+
+			/// Использует ли терминал кодировку UTF-8.
+			bool				utf8;
+
+
+		public:
+			/// Очищает формируемое изображение.
+			void		clear(void);
+
+			/// Выводит изображение в терминал.
+			void		flush(void);
+
+			/// Возвращает количество столбцов.
+			int			get_cols(void) const;
+
+			/// Возвращает количество строк.
+			int			get_rows(void) const;
+
+			/// Выводит строку text (в кодировке UTF-8, без переводов строк) в
+			/// позицию (row, col), занимая не более width позиций.
+			/// @return - количество занятых позиций.
+			int			put(int row, int col, int width, const std::string& text, int attrs = ATTR_NORMAL);
+
+			/// Запрашивает у терминала его текущий размер. Если размер
+			/// изменился, то изображение очищается и при следующем flush()
+			/// экран перерисовывается целиком.
+			/// @return - true, если размер изменился.
+			bool		update_size(void);
+
+			/// Разбивает text на строки шириной не более width позиций,
+			/// перенося строки по словам.
+			static void	wrap(const std::string& text, int width, std::vector<std::string>* lines);
+
+		private:
+			/// Возвращает количество позиций, занимаемых символом c.
+			static int	get_char_width(gunichar c);
+
+			/// Записывает data в терминал.
+			void		write(const std::string& data);
+	};
+
+
+	/// Если существует объект Terminal_screen, то возвращает терминал в
+	/// исходное состояние (для завершения программы без уничтожения
+	/// объектов).
+	void	restore_terminal_screen(void);
+
+#endif
@@ -0,0 +1,643 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+
+#include <glibmm/main.h>
+#include <glibmm/miscutils.h>
+
+#include <mlib/fs.hpp>
+
+#include "cue_scheduler.hpp"
+#include "latency_stats.hpp"
+#include "mplayer.hpp"
+#include "playlist.hpp"
+#include "startup_report.hpp"
+#include "state_publisher.hpp"
+#include "subtitles.hpp"
+#include "terminal_ui.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Минимальный интервал между перерисовками экрана.
+	const Time_us FRAME_INTERVAL = 1000000 / 60;
+
+	/// Ctrl+P - включение и выключение режима паузы после каждого субтитра.
+	const char KEY_PAUSE_AFTER_CUE = 0x10;
+
+	/// Ctrl+R - повтор текущего субтитра.
+	const char KEY_REPLAY_CUE = 0x12;
+
+	/// Доля высоты колонки, которую может занимать следующий субтитр.
+	const int NEXT_CUE_ROWS_DIVISOR = 3;
+
+
+	/// pipe, через который обработчик SIGWINCH передает уведомление об
+	/// изменении размера терминала в Main loop.
+	int RESIZE_PIPE[2] = { -1, -1 };
+
+
+
+	/// Форматирует offset в виде "ч:мм:сс.д".
+	std::string	format_offset(Time_ms offset);
+
+	/// Обработчик SIGWINCH.
+	void		sigwinch_handler(int signal_no);
+
+
+
+	std::string format_offset(Time_ms offset)
+	{
+		char buf[32];
+
+		if(offset < 0)
+			offset = 0;
+
+		snprintf(buf, sizeof buf, "%d:%02d:%02d.%d",
+			int(offset / 3600000), int(offset / 60000 % 60),
+			int(offset / 1000 % 60), int(offset / 100 % 10));
+
+		return buf;
+	}
+
+
+
+	void sigwinch_handler(int signal_no)
+	{
+		int saved_errno = errno;
+
+		// Ошибку игнорируем: если pipe переполнен, то уведомление уже и так
+		// ожидает обработки.
+		ssize_t rval = write(RESIZE_PIPE[1], "", 1);
+		(void) rval;
+
+		errno = saved_errno;
+	}
+}
+
+
+
+Terminal_ui::Terminal_ui(const boost::shared_ptr<Mplayer>& mplayer, const boost::shared_ptr<Playlist>& playlist) throw(m::Exception)
+:
+	mplayer(mplayer),
+	playlist(playlist),
+	playlist_pos(0),
+	playlist_pending(false),
+	main_loop(Glib::MainLoop::create()),
+	screen(STDOUT_FILENO),
+	last_frame_time(0)
+{
+	if(playlist)
+	{
+		this->mplayer->connect_file_changed_handler(
+			sigc::mem_fun(*this, &Terminal_ui::on_file_changed_cb));
+
+		playlist->connect_loaded_handler(
+			sigc::mem_fun(*this, &Terminal_ui::on_playlist_loaded_cb));
+
+		playlist->set_current(0);
+	}
+
+	this->mplayer->connect_quit_handler(
+		sigc::mem_fun(*this, &Terminal_ui::on_player_closed_cb));
+
+	if(const char* name = getenv(SHM_ENV_NAME))
+	{
+		try
+		{
+			this->state_publisher.reset(new State_publisher(name));
+		}
+		catch(m::Exception& e)
+		{
+			MLIB_SW(__("Unable to publish the playback state: %1.", EE(e)));
+		}
+	}
+
+	// Прослушиваем стандартный ввод -->
+	{
+		int fd;
+		long flags;
+
+		// Генерирует m::Exception
+		fd = m::unix_dup(STDIN_FILENO);
+		this->nonblock_stdin.set(fd);
+
+		if( ( flags = fcntl(fd, F_GETFL) ) == -1 )
+			M_THROW(__("Can't get flags for the stdin: %1.", EE(errno)));
+
+		if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+			M_THROW(__("Can't set flags for the stdin: %1.", EE(errno)));
+
+		this->stdin_connection = Glib::signal_io().connect(
+			sigc::mem_fun(*this, &Terminal_ui::on_stdin_data_cb), fd, Glib::IO_IN | Glib::IO_HUP);
+	}
+	// Прослушиваем стандартный ввод <--
+
+	// Отслеживаем изменение размера терминала -->
+		if(RESIZE_PIPE[0] < 0)
+		{
+			// Генерирует m::Exception
+			std::pair<int, int> pipe_fds = m::unix_pipe(O_CLOEXEC | O_NONBLOCK);
+
+			RESIZE_PIPE[0] = pipe_fds.first;
+			RESIZE_PIPE[1] = pipe_fds.second;
+
+			struct sigaction sig_action;
+
+			sig_action.sa_handler = &sigwinch_handler;
+			sigemptyset(&sig_action.sa_mask);
+			sig_action.sa_flags = SA_RESTART;
+
+			if(sigaction(SIGWINCH, &sig_action, NULL))
+				M_THROW(__("Can't set SIGWINCH handler: %1.", EE(errno)));
+		}
+
+		this->resize_connection = Glib::signal_io().connect(
+			sigc::mem_fun(*this, &Terminal_ui::on_resize_cb), RESIZE_PIPE[0], Glib::IO_IN);
+	// Отслеживаем изменение размера терминала <--
+
+	this->request_frame();
+}
+
+
+
+Terminal_ui::~Terminal_ui(void)
+{
+	this->stdin_connection.disconnect();
+	this->resize_connection.disconnect();
+	this->time_offset_changed_connection.disconnect();
+	this->frame_connection.disconnect();
+}
+
+
+
+void Terminal_ui::draw_status(void)
+{
+	int row = this->screen.get_rows() - 1;
+	int cols = this->screen.get_cols();
+	const Playback_state& state = this->frame_state;
+	std::string status = " " + format_offset(state.offset);
+
+	if(state.paused)
+		status += "  " + _("Paused");
+
+	if(this->cue_scheduler && this->cue_scheduler->get_pause_after_cue())
+		status += "  " + _("Pause after each subtitle");
+
+	{
+		std::string file_path = this->mplayer->get_playing_file();
+
+		if(!file_path.empty())
+			status += "  " + Glib::path_get_basename(file_path);
+	}
+
+	int width = this->screen.put(row, 0, cols, status, Terminal_screen::ATTR_REVERSE);
+	this->screen.put(row, width, cols - width, std::string(cols - width, ' '), Terminal_screen::ATTR_REVERSE);
+}
+
+
+
+void Terminal_ui::draw_track(size_t track_id, size_t current_id, int col, int width, int rows)
+{
+	const Subtitles::Storage& cues = this->subtitles[track_id].get();
+	std::vector<std::string> lines;
+	int row;
+
+	// До первого субтитра выводим предстоящие субтитры с начала колонки
+	if(current_id >= cues.size())
+	{
+		row = 0;
+
+		for(size_t id = 0; id < cues.size() && row < rows; id++)
+		{
+			lines.clear();
+			Terminal_screen::wrap(cues[id].text, width, &lines);
+
+			for(size_t i = 0; i < lines.size() && row < rows; i++, row++)
+				this->screen.put(row, col, width, lines[i], Terminal_screen::ATTR_DIM);
+		}
+
+		return;
+	}
+
+	// Текущий субтитр располагаем так, чтобы под ним поместилось начало
+	// следующего.
+	// -->
+	{
+		int next_rows = 0;
+
+		if(current_id + 1 < cues.size())
+		{
+			lines.clear();
+			Terminal_screen::wrap(cues[current_id + 1].text, width, &lines);
+			next_rows = std::min<int>(lines.size(), rows / NEXT_CUE_ROWS_DIVISOR);
+		}
+
+		lines.clear();
+		Terminal_screen::wrap(cues[current_id].text, width, &lines);
+
+		int current_row = std::max<int>(0, rows - next_rows - lines.size());
+		row = current_row;
+
+		for(size_t i = 0; i < lines.size() && row < rows; i++, row++)
+		{
+			this->screen.put(row, col, width, lines[i],
+				Terminal_screen::ATTR_BOLD | Terminal_screen::ATTR_REVERSE);
+		}
+
+		// Следующие субтитры - под текущим
+		for(size_t id = current_id + 1; id < cues.size() && row < rows; id++)
+		{
+			lines.clear();
+			Terminal_screen::wrap(cues[id].text, width, &lines);
+
+			for(size_t i = 0; i < lines.size() && row < rows; i++, row++)
+				this->screen.put(row, col, width, lines[i], Terminal_screen::ATTR_DIM);
+		}
+
+		row = current_row;
+	}
+	// <--
+
+	// Предыдущие субтитры - над текущим, снизу вверх
+	for(size_t id = current_id; id-- > 0 && row > 0; )
+	{
+		lines.clear();
+		Terminal_screen::wrap(cues[id].text, width, &lines);
+
+		for(size_t i = lines.size(); i-- > 0 && row > 0; )
+			this->screen.put(--row, col, width, lines[i]);
+	}
+}
+
+
+
+void Terminal_ui::on_file_changed_cb(void)
+{
+	std::string file_path = this->mplayer->get_playing_file();
+	size_t id = this->playlist->find(file_path, this->playlist_pos + 1);
+
+	if(id >= this->playlist->size())
+	{
+		MLIB_D(_C("MPlayer plays '%1' which is not in the playlist.", file_path));
+		return;
+	}
+
+	if(id == this->playlist_pos)
+		return;
+
+	std::vector<Subtitles> subtitles;
+
+	this->playlist_pos = id;
+	this->playlist->set_current(id);
+
+	// Если субтитры еще не загружены, то до окончания их загрузки
+	// дорожки предыдущего файла убираются.
+	this->playlist_pending = !this->playlist->get_subtitles(id, &subtitles);
+	this->set_subtitles(subtitles);
+}
+
+
+
+bool Terminal_ui::on_frame_cb(void)
+{
+	TRACE_SPAN("frame");
+
+	Time_us start_time = m::get_monotonic_time();
+	int rows = this->screen.get_rows() - 1;
+	int cols = this->screen.get_cols();
+
+	this->last_frame_time = start_time;
+	this->screen.clear();
+
+	// Выводим дорожки субтитров -->
+		if(this->timeline && rows > 0)
+		{
+			const size_t* started_before;
+			const size_t* started_by;
+			size_t tracks_num = this->subtitles.size();
+
+			// Колонки разделяются одним столбцом
+			int width = (cols - int(tracks_num) + 1) / int(tracks_num);
+
+			this->timeline->find(this->frame_state.offset, &started_before, &started_by);
+
+			for(size_t track_id = 0; track_id < tracks_num && width > 0; track_id++)
+			{
+				int col = int(track_id) * (width + 1);
+
+				// Текущим считается последний появившийся субтитр
+				size_t current_id = started_by[track_id] ? started_by[track_id] - 1 : size_t(-1);
+
+				this->draw_track(track_id, current_id, col, width, rows);
+
+				if(track_id)
+				{
+					for(int row = 0; row < rows; row++)
+						this->screen.put(row, col - 1, 1, "|", Terminal_screen::ATTR_DIM);
+				}
+			}
+		}
+	// Выводим дорожки субтитров <--
+
+	this->draw_status();
+	this->screen.flush();
+
+	Time_us done_time = m::get_monotonic_time();
+	record_latency(LATENCY_REDRAW, done_time - start_time);
+
+	if(this->timeline && this->frame_state.received)
+	{
+		startup_finished();
+		record_latency(LATENCY_TOTAL, done_time - this->frame_state.received);
+	}
+
+	return false;
+}
+
+
+
+void Terminal_ui::on_player_closed_cb(void)
+{
+	MLIB_D("Player closed.");
+	this->main_loop->quit();
+}
+
+
+
+void Terminal_ui::on_playlist_loaded_cb(void)
+{
+	std::vector<Subtitles> subtitles;
+
+	if(this->playlist_pending && this->playlist->get_subtitles(this->playlist_pos, &subtitles))
+	{
+		this->playlist_pending = false;
+		this->set_subtitles(subtitles);
+	}
+}
+
+
+
+bool Terminal_ui::on_resize_cb(Glib::IOCondition condition)
+{
+	char buf[16];
+
+	while(read(RESIZE_PIPE[0], buf, sizeof buf) > 0)
+		;
+
+	if(this->screen.update_size())
+	{
+		// Изменения видны сразу, а не в начале следующего кадра
+		this->frame_connection.disconnect();
+		this->on_frame_cb();
+	}
+
+	return true;
+}
+
+
+
+bool Terminal_ui::on_stdin_data_cb(Glib::IOCondition condition)
+{
+	char buf[64];
+	ssize_t readed_bytes;
+	bool eof;
+
+	try
+	{
+		readed_bytes = m::fs::unix_read(this->nonblock_stdin.get(), buf, sizeof buf, true);
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_W(__("Error while reading from stdin: %1.", EE(e)));
+	}
+
+	eof = !errno;
+
+	// Команды режима изучения языка обрабатываем сами, остальное
+	// передаем MPlayer'у.
+	// -->
+	{
+		ssize_t chunk_start = 0;
+
+		for(ssize_t i = 0; i <= readed_bytes; i++)
+		{
+			bool is_command = i < readed_bytes && (
+				buf[i] == KEY_PAUSE_AFTER_CUE || buf[i] == KEY_REPLAY_CUE );
+
+			if(i < readed_bytes && !is_command)
+				continue;
+
+			try
+			{
+				if(i > chunk_start)
+					this->mplayer->write_to_stdio(buf + chunk_start, i - chunk_start);
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_W(__("Unable to write data to the mplayer stdio: %1.", EE(e)));
+			}
+
+			chunk_start = i + 1;
+
+			if(!is_command || !this->cue_scheduler)
+				continue;
+
+			if(buf[i] == KEY_PAUSE_AFTER_CUE)
+			{
+				this->cue_scheduler->set_pause_after_cue(
+					!this->cue_scheduler->get_pause_after_cue());
+				this->request_frame();
+			}
+			else
+			{
+				try
+				{
+					this->cue_scheduler->replay_current_cue();
+				}
+				catch(m::Exception& e)
+				{
+					MLIB_SW(__("Unable to replay the current subtitle: %1.", EE(e)));
+				}
+			}
+		}
+	}
+	// <--
+
+	if(eof)
+		MLIB_D("Stdin has been closed.");
+
+	return !eof;
+}
+
+
+
+void Terminal_ui::on_time_offset_changed_cb(void)
+{
+	TRACE_SPAN("on_time_offset_changed");
+
+	Time_us handler_time = m::get_monotonic_time();
+
+	this->frame_state = this->mplayer->get_playback_state();
+	record_latency(LATENCY_HANDLER, handler_time - this->mplayer->get_notification_time());
+
+	if(this->cue_scheduler)
+		this->cue_scheduler->update();
+
+	if(this->state_publisher)
+		this->publish_state(this->frame_state);
+
+	this->request_frame();
+}
+
+
+
+void Terminal_ui::publish_state(const Playback_state& state)
+{
+	const size_t* started_before;
+	const size_t* started_by = NULL;
+
+	if(this->timeline)
+		this->timeline->find(state.offset, &started_before, &started_by);
+
+	this->state_publisher->publish(state, started_by, started_by ? this->subtitles.size() : 0);
+}
+
+
+
+void Terminal_ui::request_frame(void)
+{
+	if(this->frame_connection.connected())
+		return;
+
+	// Если с предыдущей перерисовки кадр еще не прошел, то откладываем
+	// перерисовку до его окончания, иначе - выполняем ее, как только
+	// будут обработаны все поступившие данные.
+	Time_us elapsed = m::get_monotonic_time() - this->last_frame_time;
+
+	if(elapsed >= FRAME_INTERVAL)
+	{
+		this->frame_connection = Glib::signal_idle().connect(
+			sigc::mem_fun(*this, &Terminal_ui::on_frame_cb));
+	}
+	else
+	{
+		this->frame_connection = Glib::signal_timeout().connect(
+			sigc::mem_fun(*this, &Terminal_ui::on_frame_cb),
+			(FRAME_INTERVAL - elapsed + 999) / 1000);
+	}
+}
+
+
+
+void Terminal_ui::run(void)
+{
+	this->main_loop->run();
+}
+
+
+
+void Terminal_ui::set_subtitles(std::vector<Subtitles>& subtitles)
+{
+	// Режим паузы после каждого субтитра сохраняется при смене файла
+	bool pause_after_cue = this->cue_scheduler && this->cue_scheduler->get_pause_after_cue();
+	bool had_scheduler = this->cue_scheduler.get() != NULL;
+
+	this->cue_scheduler.reset();
+
+	// Временная шкала ссылается на эти субтитры
+	this->timeline.reset();
+	this->subtitles.clear();
+	this->subtitles.swap(subtitles);
+
+	if(!this->subtitles.empty())
+	{
+		this->timeline.reset(new Timeline(this->subtitles));
+
+		// Повтор субтитров выполняется командами MPlayer'у
+		if(this->mplayer->can_send_commands())
+		{
+			try
+			{
+				this->cue_scheduler.reset(new Cue_scheduler(*this->mplayer, this->subtitles.front()));
+
+				if(had_scheduler)
+					this->cue_scheduler->set_pause_after_cue(pause_after_cue);
+			}
+			catch(m::Exception& e)
+			{
+				MLIB_SW(EE(e));
+			}
+		}
+	}
+
+	// До появления дорожек изменения позиции не отслеживаются: последняя
+	// позиция хранится в Mplayer'е и применяется ниже.
+	if(!this->time_offset_changed_connection.connected())
+	{
+		this->time_offset_changed_connection =
+			this->mplayer->connect_time_offset_changed_handler(
+				sigc::mem_fun(*this, &Terminal_ui::on_time_offset_changed_cb)
+			);
+	}
+
+	this->frame_state = this->mplayer->get_playback_state();
+
+	if(this->state_publisher)
+	{
+		this->state_publisher->tracks_changed();
+		this->publish_state(this->frame_state);
+	}
+
+	this->request_frame();
+}
+
+
+
+bool is_terminal_ui_requested(void)
+{
+	const char* value = getenv(UI_ENV_NAME);
+
+	if(value && *value)
+	{
+		if(!strcmp(value, "terminal"))
+			return true;
+		else if(!strcmp(value, "gtk"))
+			return false;
+		else
+			MLIB_SW(__("Invalid %1 value: '%2'.", UI_ENV_NAME, value));
+	}
+
+	return !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY");
+}
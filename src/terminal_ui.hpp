@@ -0,0 +1,184 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_TERMINAL_UI
+	#define HEADER_TERMINAL_UI
+
+	#include <string>
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/scoped_ptr.hpp>
+	#include <boost/shared_ptr.hpp>
+
+	#include <glibmm/main.h>
+
+	#include <sigc++/connection.h>
+	#include <sigc++/trackable.h>
+
+	#include "mplayer.hpp"
+	#include "subtitles.hpp"
+	#include "terminal_screen.hpp"
+
+	class Cue_scheduler;
+	class Playlist;
+	class State_publisher;
+	class Timeline;
+
+
+	/// Переменная окружения, задающая интерфейс программы: "gtk" или
+	/// "terminal". По умолчанию терминальный интерфейс используется, если
+	/// нет графического дисплея.
+	#define UI_ENV_NAME "SUBMPLAYER_UI"
+
+
+	/// Терминальный интерфейс: отображает текущий и соседние субтитры
+	/// каждой дорожки прямо в терминале, без GTK.
+	///
+	/// Дорожки располагаются в колонках рядом друг с другом. Текущий
+	/// субтитр выделяется и выводится так, чтобы за ним был виден
+	/// следующий, а оставшееся место над ним занимают предыдущие субтитры.
+	/// В последней строке экрана выводится состояние воспроизведения.
+	///
+	/// Нажатия клавиш передаются MPlayer'у, кроме команд режима изучения
+	/// языка: Ctrl+P и Ctrl+R (как и в окне).
+	class Terminal_ui: public sigc::trackable, public boost::noncopyable
+	{
+		public:
+			/// @param mplayer - уже запущенный MPlayer с отключенным выводом
+			/// в терминал (см. Mplayer::disable_terminal_output()).
+			/// @param playlist - список проигрываемых файлов (если MPlayer
+			/// проигрывает несколько файлов).
+			Terminal_ui(
+				const boost::shared_ptr<Mplayer>& mplayer,
+				const boost::shared_ptr<Playlist>& playlist = boost::shared_ptr<Playlist>()
+			) throw(m::Exception);
+			~Terminal_ui(void);
+
+
+		private:
+			/// MPlayer, субтитры к которому отображаются.
+			boost::shared_ptr<Mplayer>			mplayer;
+
+			/// Список проигрываемых файлов.
+			boost::shared_ptr<Playlist>			playlist;
+
+			/// Позиция в playlist'е текущих субтитров.
+			size_t								playlist_pos;
+
+			/// Ожидается ли окончание загрузки субтитров файла playlist_pos.
+			bool								playlist_pending;
+
+			/// Main loop терминального интерфейса.
+			Glib::RefPtr<Glib::MainLoop>		main_loop;
+
+			/// Экран терминала.
+			Terminal_screen						screen;
+
+			/// Отображаемые дорожки субтитров.
+			std::vector<Subtitles>				subtitles;
+
+			/// Общая временная шкала дорожек.
+			boost::scoped_ptr<Timeline>			timeline;
+
+			/// Реализует режим изучения языка для первой дорожки.
+			boost::scoped_ptr<Cue_scheduler>	cue_scheduler;
+
+			/// Публикация состояния воспроизведения в разделяемой памяти
+			/// (если включена).
+			boost::scoped_ptr<State_publisher>	state_publisher;
+
+			/// Неблокирующая копия стандартного ввода.
+			m::File_holder						nonblock_stdin;
+
+			/// Обработчики событий.
+			sigc::connection					stdin_connection;
+			sigc::connection					resize_connection;
+			sigc::connection					time_offset_changed_connection;
+
+			/// Обработчик, перерисовывающий экран в ближайшем кадре.
+			sigc::connection					frame_connection;
+
+			/// Время (по монотонным часам) последней перерисовки экрана.
+			Time_us								last_frame_time;
+
+			/// Состояние воспроизведения, отображаемое в ближайшем кадре.
+			Playback_state						frame_state;
+
+
+		public:
+			/// Запускает Main loop. Возвращает управление после завершения
+			/// MPlayer'а.
+			void	run(void);
+
+			/// Заменяет отображаемые дорожки субтитров. До первого вызова
+			/// отображается только строка состояния.
+			///
+			/// Субтитры не копируются: содержимое subtitles забирается
+			/// интерфейсом, а сам вектор остается пустым.
+			void	set_subtitles(std::vector<Subtitles>& subtitles);
+
+		private:
+			/// Выводит субтитры дорожки track_id, начиная с субтитра
+			/// current_id, в колонку (col, width) между строками 0 и rows.
+			void	draw_track(size_t track_id, size_t current_id, int col, int width, int rows);
+
+			/// Выводит строку состояния.
+			void	draw_status(void);
+
+			/// Обработчик сигнала на начало воспроизведения MPlayer'ом
+			/// очередного файла.
+			void	on_file_changed_cb(void);
+
+			/// Перерисовывает экран. Выполняется не чаще одного раза за кадр.
+			bool	on_frame_cb(void);
+
+			/// Обработчик сигнала на закрытие плеера.
+			void	on_player_closed_cb(void);
+
+			/// Обработчик сигнала на окончание загрузки субтитров очередного
+			/// файла playlist'а.
+			void	on_playlist_loaded_cb(void);
+
+			/// Обработчик изменения размера терминала.
+			bool	on_resize_cb(Glib::IOCondition condition);
+
+			/// Обработчик сигнала на поступление данных в stdin.
+			bool	on_stdin_data_cb(Glib::IOCondition condition);
+
+			/// Обработчик сигнала на изменение текущей позиции в проигрываемом
+			/// файле.
+			void	on_time_offset_changed_cb(void);
+
+			/// Публикует состояние воспроизведения state в разделяемой
+			/// памяти.
+			void	publish_state(const Playback_state& state);
+
+			/// Запрашивает перерисовку экрана в ближайшем кадре.
+			void	request_frame(void);
+	};
+
+
+	/// Возвращает true, если должен использоваться терминальный
+	/// интерфейс (см. UI_ENV_NAME).
+	bool	is_terminal_ui_requested(void);
+
+#endif
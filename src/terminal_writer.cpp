@@ -0,0 +1,370 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+#include <boost/bind.hpp>
+
+#include <mlib/fs.hpp>
+
+#include "terminal_writer.hpp"
+
+
+
+namespace
+{
+	/// Максимальный объем данных, ожидающих записи. Все, что не помещается в
+	/// этот объем, отбрасывается.
+	const size_t MAX_QUEUED_SIZE = 64 * 1024;
+
+	/// Максимальный объем данных, передаваемый за один вызов tee().
+	const size_t MAX_TEE_SIZE = 64 * 1024;
+}
+
+
+
+Terminal_writer::Terminal_writer(int fd, bool threaded)
+:
+	fd(fd),
+	tee_supported(false),
+	writing(false),
+	stop(false),
+	dropped_bytes(0),
+	superseded_lines(0)
+{
+	bool regular_file = false;
+
+	try
+	{
+		m::fs::Stat stat = m::fs::unix_fstat(fd);
+		this->tee_supported = stat.is_fifo();
+		regular_file = stat.is_reg();
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_D(_C("Unable to stat output file descriptor: %1.", EE(e)));
+	}
+
+	// При записи из Main loop'а запись в терминал не должна блокироваться.
+	// O_NONBLOCK устанавливается не на сам fd, а на заново открытую его
+	// копию: иначе он подействовал бы и на разделяющий с ним открытый файл
+	// стандартный вывод ошибок (в том числе MPlayer'а). Запись в обычный
+	// файл не блокируется и так, а открывать его заново нельзя - у копии
+	// будет своя позиция записи.
+	if(!threaded && !regular_file)
+	{
+		char path[64];
+		snprintf(path, sizeof path, "/proc/self/fd/%d", fd);
+
+		try
+		{
+			this->nonblock_fd.set(m::fs::unix_open(path, O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC));
+			this->fd = this->nonblock_fd.get();
+		}
+		catch(m::Exception& e)
+		{
+			MLIB_D(_C("Unable to reopen output file descriptor in nonblocking mode, falling back to a writer thread: %1.", EE(e)));
+			threaded = true;
+		}
+	}
+
+	MLIB_D(_C("Terminal writer: zero-copy passthrough is %1.",
+		this->tee_supported ? "enabled" : "disabled"));
+
+	if(threaded)
+	{
+		this->thread.reset(new boost::thread(
+			boost::bind(&Terminal_writer::writer_thread, this)));
+	}
+}
+
+
+
+Terminal_writer::~Terminal_writer(void)
+{
+	if(this->thread)
+	{
+		{
+			boost::mutex::scoped_lock lock(this->mutex);
+			this->stop = true;
+		}
+
+		this->data_cond.notify_one();
+		this->thread->join();
+	}
+	else
+	{
+		this->writable_connection.disconnect();
+
+		// Дописываем оставшиеся данные, блокируясь на записи
+		std::string data;
+		this->take_data(&data);
+		this->unwritten += data;
+
+		if(!this->unwritten.empty())
+		{
+			if(this->nonblock_fd.get() != -1)
+			{
+				int flags = fcntl(this->fd, F_GETFL);
+
+				if(flags != -1)
+					fcntl(this->fd, F_SETFL, flags & ~O_NONBLOCK);
+			}
+
+			this->write_data(this->unwritten);
+		}
+	}
+
+	if(this->dropped_bytes || this->superseded_lines)
+	{
+		MLIB_D(_C("Terminal writer: %1 bytes dropped, %2 status lines superseded.",
+			this->dropped_bytes, this->superseded_lines));
+	}
+}
+
+
+
+void Terminal_writer::flush(void)
+{
+	if(this->thread)
+		return;
+
+	try
+	{
+		while(true)
+		{
+			// Новые данные берем из очереди только после того, как записаны
+			// предыдущие, - до этого строки состояния в очереди продолжают
+			// заменять друг друга.
+			if(this->unwritten.empty())
+			{
+				this->take_data(&this->unwritten);
+
+				if(this->unwritten.empty())
+					break;
+			}
+
+			size_t written = m::fs::unix_write(this->fd, this->unwritten.data(), this->unwritten.size(), true);
+			this->unwritten.erase(0, written);
+
+			if(!written)
+				break;
+		}
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_W(__("Can't write data to stdout: %1.", EE(e)));
+	}
+
+	// Терминал не принял все данные - дописываем их, когда он будет готов
+	if(!this->unwritten.empty() && !this->writable_connection.connected())
+	{
+		this->writable_connection = Glib::signal_io().connect(
+			sigc::mem_fun(*this, &Terminal_writer::on_writable_cb),
+			this->fd, Glib::IO_OUT | Glib::IO_ERR | Glib::IO_HUP
+		);
+	}
+}
+
+
+
+bool Terminal_writer::on_writable_cb(Glib::IOCondition condition)
+{
+	this->flush();
+	return !this->unwritten.empty();
+}
+
+
+
+void Terminal_writer::push_line(const std::string& line, bool status)
+{
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	if(status)
+	{
+		if(!this->status_line.empty())
+			this->superseded_lines++;
+
+		this->status_line = line;
+	}
+	else
+	{
+		// Строка состояния должна быть выведена до следующей за ней
+		// обычной строки.
+		if(!this->status_line.empty())
+		{
+			this->lines += this->status_line;
+			this->status_line.clear();
+		}
+
+		if(this->lines.size() + line.size() > MAX_QUEUED_SIZE)
+			this->dropped_bytes += line.size();
+		else
+			this->lines += line;
+	}
+
+	lock.unlock();
+	this->data_cond.notify_one();
+}
+
+
+
+size_t Terminal_writer::tee(int read_fd)
+{
+	ssize_t size;
+
+	if(!this->tee_supported)
+		return 0;
+
+	// Если в очереди есть данные, то новые данные должны быть выведены
+	// после них.
+	{
+		boost::mutex::scoped_lock lock(this->mutex);
+
+		if(
+			this->writing || !this->lines.empty() || !this->status_line.empty() ||
+			!this->partial_line.empty() || !this->unwritten.empty()
+		)
+			return 0;
+	}
+
+	do
+		size = ::tee(read_fd, this->fd, MAX_TEE_SIZE, SPLICE_F_NONBLOCK);
+	while(size < 0 && errno == EINTR);
+
+	if(size < 0)
+	{
+		if(errno != EAGAIN)
+		{
+			MLIB_D(_C("Disabling zero-copy passthrough: %1.", EE(errno)));
+			this->tee_supported = false;
+		}
+
+		return 0;
+	}
+
+	return size;
+}
+
+
+
+void Terminal_writer::write(const char* data, size_t size)
+{
+	const char* end = data + size;
+
+	for(const char* pos = data; pos != end; pos++)
+	{
+		switch(*pos)
+		{
+			case '\r':
+			case '\n':
+				this->partial_line.append(data, pos + 1);
+				this->push_line(this->partial_line, *pos == '\r');
+				this->partial_line.clear();
+				data = pos + 1;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	if(data != end)
+	{
+		if(this->partial_line.size() + (end - data) > MAX_QUEUED_SIZE)
+		{
+			// Строка без разделителей - выводим ее как есть
+			this->push_line(this->partial_line, false);
+			this->partial_line.clear();
+		}
+
+		this->partial_line.append(data, end);
+	}
+}
+
+
+
+void Terminal_writer::take_data(std::string* data)
+{
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	data->swap(this->lines);
+	this->lines.clear();
+
+	*data += this->status_line;
+	this->status_line.clear();
+}
+
+
+
+void Terminal_writer::write_data(const std::string& data)
+{
+	try
+	{
+		size_t written = 0;
+
+		while(written < data.size())
+			written += m::fs::unix_write(this->fd, data.data() + written, data.size() - written);
+	}
+	catch(m::Exception& e)
+	{
+		MLIB_W(__("Can't write data to stdout: %1.", EE(e)));
+	}
+}
+
+
+
+void Terminal_writer::writer_thread(void)
+{
+	std::string data;
+
+	while(true)
+	{
+		// Получаем данные, ожидающие записи -->
+		{
+			boost::mutex::scoped_lock lock(this->mutex);
+
+			this->writing = false;
+
+			while(this->lines.empty() && this->status_line.empty())
+			{
+				if(this->stop)
+					return;
+
+				this->data_cond.wait(lock);
+			}
+
+			this->writing = true;
+		}
+
+		this->take_data(&data);
+		// Получаем данные, ожидающие записи <--
+
+		this->write_data(data);
+		data.clear();
+	}
+}
+
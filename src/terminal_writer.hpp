@@ -0,0 +1,154 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_TERMINAL_WRITER
+	#define HEADER_TERMINAL_WRITER
+
+	#include <string>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/scoped_ptr.hpp>
+	#include <boost/thread.hpp>
+	#include <boost/thread/condition.hpp>
+
+	#include <glibmm/main.h>
+
+	#include <sigc++/connection.h>
+
+
+	/// Асинхронно передает вывод MPlayer'а в файловый дескриптор (как
+	/// правило - в наш стандартный вывод).
+	///
+	/// Запись ведется отдельным потоком, поэтому медленный терминал не
+	/// блокирует поток, читающий вывод MPlayer'а. Объем данных, ожидающих
+	/// записи, ограничен. Строки состояния, которые MPlayer завершает символом
+	/// '\r', не накапливаются: если терминал не успевает их отображать, то
+	/// записывается только самая последняя из них.
+	///
+	/// Если вывод MPlayer'а читается прямо в Main loop'е, то отдельный поток
+	/// не создается: накопленные данные записываются вызовом flush() без
+	/// блокирования, а то, что терминал не принял сразу, дописывается из
+	/// Main loop'а, когда он будет к этому готов.
+	class Terminal_writer: public boost::noncopyable
+	{
+		public:
+			/// @param threaded - вести ли запись отдельным потоком.
+			Terminal_writer(int fd, bool threaded);
+			~Terminal_writer(void);
+
+
+		private:
+			/// Файловый дескриптор, в который осуществляется запись.
+			int							fd;
+
+			/// Является ли fd pipe'ом, в который можно передавать данные с
+			/// помощью tee().
+			bool						tee_supported;
+
+			/// Данные последней незавершенной строки.
+			std::string					partial_line;
+
+			/// Открытая заново копия fd в неблокирующем режиме (если запись
+			/// ведется из Main loop'а).
+			m::File_holder				nonblock_fd;
+
+			/// Данные, извлеченные из очереди, но еще не принятые fd (если
+			/// запись ведется из Main loop'а).
+			std::string					unwritten;
+
+			/// Ожидание готовности fd к записи.
+			sigc::connection			writable_connection;
+
+
+			/// Блокирует доступ к:
+			///   lines
+			///   status_line
+			///   writing
+			///   stop
+			boost::mutex				mutex;
+
+			/// Сигнализирует потоку записи о появлении новых данных.
+			boost::condition			data_cond;
+
+			/// Завершенные строки, ожидающие записи.
+			std::string					lines;
+
+			/// Последняя строка состояния, ожидающая записи.
+			std::string					status_line;
+
+			/// Осуществляет ли поток записи запись в данный момент.
+			bool						writing;
+
+			/// Должен ли поток записи завершить свою работу.
+			bool						stop;
+
+
+			/// Количество отброшенных из-за переполнения байт.
+			size_t						dropped_bytes;
+
+			/// Количество строк состояния, замененных более новыми.
+			size_t						superseded_lines;
+
+			/// Поток, осуществляющий запись (если запись ведется отдельным
+			/// потоком).
+			boost::scoped_ptr<
+				boost::thread>			thread;
+
+
+		public:
+			/// Записывает без блокирования столько данных, ожидающих записи,
+			/// сколько примет fd. Остаток дописывается из Main loop'а. Если
+			/// запись ведется отдельным потоком, то ничего не делает.
+			void	flush(void);
+
+			/// Пытается передать в fd данные, находящиеся в данный момент в
+			/// pipe'е read_fd, не извлекая их из него и не копируя их в память
+			/// процесса.
+			///
+			/// @return - количество переданных байт. Эти байты будут первыми
+			/// байтами, которые будут прочитаны из read_fd, и их не нужно
+			/// передавать в write().
+			size_t	tee(int read_fd);
+
+			/// Ставит данные в очередь на запись. Никогда не блокируется на
+			/// записи.
+			void	write(const char* data, size_t size);
+
+		private:
+			/// Обработчик сигнала о готовности fd к записи.
+			bool	on_writable_cb(Glib::IOCondition condition);
+
+			/// Добавляет строку в очередь на запись.
+			void	push_line(const std::string& line, bool status);
+
+			/// Извлекает из очереди все данные, ожидающие записи.
+			void	take_data(std::string* data);
+
+			/// Записывает данные в fd, блокируясь на записи столько, сколько
+			/// потребуется терминалу.
+			void	write_data(const std::string& data);
+
+			/// Поток, осуществляющий запись.
+			void	writer_thread(void);
+	};
+
+#endif
+
@@ -0,0 +1,76 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include "time_index.hpp"
+
+
+
+Time_index::Time_index(const std::vector<Time_ms>& times)
+:
+	times(times),
+	tree(times.size() + 1),
+	ranks(times.size() + 1, times.size())
+{
+	this->build(1, 0);
+}
+
+
+
+size_t Time_index::build(size_t node, size_t id)
+{
+	if(node < this->tree.size())
+	{
+		id = this->build(2 * node, id);
+
+		this->tree[node] = this->times[id];
+		this->ranks[node] = id;
+		id++;
+
+		id = this->build(2 * node + 1, id);
+	}
+
+	return id;
+}
+
+
+
+size_t Time_index::count_less(Time_ms time) const
+{
+	const Time_ms* tree = &this->tree[0];
+	size_t size = this->times.size();
+	size_t node = 1;
+
+	// Спускаемся до листа, уходя вправо, если элемент меньше time. Элементы
+	// на четыре уровня ниже запрашиваются заранее - они занимают одну строку
+	// кэша.
+	while(node <= size)
+	{
+		__builtin_prefetch(tree + 16 * node);
+		node = 2 * node + (tree[node] < time);
+	}
+
+	// Отбрасываем последние повороты вправо - оставшийся узел и есть первый
+	// элемент, не меньший time (0, если такого нет).
+	node >>= __builtin_ffsl(~node);
+
+	return this->ranks[node];
+}
+
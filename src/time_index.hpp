@@ -0,0 +1,101 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_TIME_INDEX
+	#define HEADER_TIME_INDEX
+
+	#include <vector>
+
+
+	/// Индекс времени появления субтитров.
+	///
+	/// Время хранится в непрерывном массиве в порядке Eytzinger'а
+	/// (неявное двоичное дерево: потомки элемента k - элементы 2k и 2k + 1),
+	/// поэтому первые уровни дерева, которые проходит любой поиск, лежат в
+	/// нескольких соседних строках кэша, а сам поиск не содержит
+	/// непредсказуемых ветвлений. Время поиска не зависит от того, насколько
+	/// далеко от предыдущей позиции находится искомая.
+	///
+	/// Рядом хранится и обычный упорядоченный массив - для быстрой проверки
+	/// соседних с текущей позиций.
+	class Time_index
+	{
+		public:
+			/// times должны быть упорядочены по возрастанию.
+			Time_index(const std::vector<Time_ms>& times);
+
+
+		private:
+			/// Время в порядке возрастания.
+			std::vector<Time_ms>	times;
+
+			/// Время в порядке Eytzinger'а (элемент 0 не используется).
+			std::vector<Time_ms>	tree;
+
+			/// Номер в times каждого элемента tree.
+			std::vector<size_t>		ranks;
+
+
+		public:
+			/// Возвращает количество элементов, меньших time.
+			size_t		count_less(Time_ms time) const;
+
+			/// Возвращает количество элементов, меньших или равных time.
+			inline
+			size_t		count_less_equal(Time_ms time) const;
+
+			/// Возвращает элемент id в порядке возрастания.
+			inline
+			Time_ms		get(size_t id) const;
+
+			/// Возвращает количество элементов.
+			inline
+			size_t		size(void) const;
+
+		private:
+			/// Заполняет поддерево с корнем node элементами times, начиная с
+			/// элемента id.
+			/// @return - номер первого неиспользованного элемента times.
+			size_t		build(size_t node, size_t id);
+	};
+
+
+	size_t Time_index::count_less_equal(Time_ms time) const
+	{
+		// Время целочисленно
+		return this->count_less(time + 1);
+	}
+
+
+
+	Time_ms Time_index::get(size_t id) const
+	{
+		return this->times[id];
+	}
+
+
+
+	size_t Time_index::size(void) const
+	{
+		return this->times.size();
+	}
+
+#endif
@@ -0,0 +1,106 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <algorithm>
+
+#include "subtitles.hpp"
+#include "time_index.hpp"
+#include "timeline.hpp"
+
+
+
+Timeline::Timeline(const std::vector<Subtitles>& tracks)
+:
+	tracks_num(tracks.size()),
+	hint(0)
+{
+	std::vector<Time_ms> times;
+
+	// Собираем моменты появления субтитров всех дорожек -->
+		M_FOR_CONST_IT(tracks, track)
+			M_FOR_CONST_IT(track->get(), it)
+				times.push_back(it->time);
+
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+	// Собираем моменты появления субтитров всех дорожек <--
+
+	// Считаем субтитры, появившиеся к каждому моменту -->
+	{
+		this->started.resize((times.size() + 1) * this->tracks_num);
+
+		for(size_t track_id = 0; track_id < this->tracks_num; track_id++)
+		{
+			const Subtitles::Storage& subtitles = tracks[track_id].get();
+			size_t id = 0;
+
+			for(size_t time_id = 0; time_id < times.size(); time_id++)
+			{
+				while(id < subtitles.size() && subtitles[id].time <= times[time_id])
+					id++;
+
+				this->started[(time_id + 1) * this->tracks_num + track_id] = id;
+			}
+		}
+	}
+	// Считаем субтитры, появившиеся к каждому моменту <--
+
+	this->index.reset(new Time_index(times));
+}
+
+
+
+Timeline::~Timeline(void)
+{
+}
+
+
+
+void Timeline::find(Time_ms time, const size_t** before, const size_t** by)
+{
+	const Time_index& index = *this->index;
+	size_t size = index.size();
+	size_t less = this->hint;
+
+	// Чаще всего время остается между теми же моментами или переходит
+	// через следующий момент, поэтому сначала проверяем их.
+	// -->
+		if( less && index.get(less - 1) >= time )
+			less = index.count_less(time);
+		else if( less != size && index.get(less) < time )
+		{
+			if(less + 1 == size || index.get(less + 1) >= time)
+				less++;
+			else
+				less = index.count_less(time);
+		}
+	// <--
+
+	this->hint = less;
+
+	*before = &this->started[less * this->tracks_num];
+
+	if(less != size && index.get(less) == time)
+		less++;
+
+	*by = &this->started[less * this->tracks_num];
+}
+
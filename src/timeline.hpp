@@ -0,0 +1,76 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_TIMELINE
+	#define HEADER_TIMELINE
+
+	#include <vector>
+
+	#include <boost/noncopyable.hpp>
+	#include <boost/scoped_ptr.hpp>
+
+	class Subtitles;
+	class Time_index;
+
+
+	/// Общая временная шкала всех дорожек субтитров.
+	///
+	/// Хранит упорядоченный массив моментов появления субтитров всех дорожек
+	/// и для каждого из них - количество субтитров каждой дорожки,
+	/// появившихся к этому моменту. Поэтому одного поиска по шкале
+	/// достаточно, чтобы определить положение всех дорожек, и все они
+	/// всегда обновляются согласованно.
+	class Timeline: public boost::noncopyable
+	{
+		public:
+			Timeline(const std::vector<Subtitles>& tracks);
+			~Timeline(void);
+
+
+		private:
+			/// Количество дорожек.
+			size_t						tracks_num;
+
+			/// Моменты появления субтитров.
+			boost::scoped_ptr<
+				Time_index>				index;
+
+			/// Количество субтитров каждой дорожки, появившихся до каждого
+			/// момента: строка i (по tracks_num элементов) соответствует
+			/// моменту, предшествующему моменту i в index.
+			std::vector<size_t>			started;
+
+			/// Результат предыдущего поиска: количество моментов, меньших
+			/// искомого времени.
+			size_t						hint;
+
+
+		public:
+			/// Определяет положение всех дорожек в момент time.
+			/// @param before - количество субтитров каждой дорожки,
+			/// появившихся раньше time.
+			/// @param by - количество субтитров каждой дорожки, появившихся
+			/// не позже time.
+			/// Указатели действительны до уничтожения объекта.
+			void	find(Time_ms time, const size_t** before, const size_t** by);
+	};
+
+#endif
@@ -0,0 +1,203 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+#include <fstream>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "trace.hpp"
+
+
+
+namespace
+{
+	/// Максимальное количество событий в трассе. Все последующие события
+	/// отбрасываются, чтобы длительная запись не съела всю память.
+	const size_t MAX_TRACE_EVENTS = 1000000;
+
+
+	/// Событие трассы.
+	struct Trace_event
+	{
+		/// Имя события (строковый литерал).
+		const char*	name;
+
+		/// Тип события в терминах формата Chrome trace event: 'X' -
+		/// интервал, 'i' - мгновенное событие.
+		char		phase;
+
+		/// Поток, в котором произошло событие.
+		pid_t		tid;
+
+		/// Время (по монотонным часам) начала события.
+		Time_us		begin;
+
+		/// Продолжительность события.
+		Time_us		duration;
+	};
+
+
+	/// Блокирует доступ к:
+	///   TRACE_EVENTS
+	///   DROPPED_TRACE_EVENTS
+	///   TRACE_SAVED
+	boost::mutex				TRACE_MUTEX;
+
+	/// Записанные события.
+	std::vector<Trace_event>	TRACE_EVENTS;
+
+	/// Количество отброшенных событий.
+	size_t						DROPPED_TRACE_EVENTS = 0;
+
+	/// Была ли трасса уже сохранена.
+	bool						TRACE_SAVED = false;
+
+	/// Время (по монотонным часам) начала записи трассы.
+	Time_us						TRACE_START_TIME = 0;
+
+
+
+	/// Добавляет событие в трассу.
+	void	add_trace_event(const char* name, char phase, Time_us begin, Time_us duration);
+
+	/// Возвращает идентификатор текущего потока.
+	pid_t	get_thread_id(void);
+
+
+
+	void add_trace_event(const char* name, char phase, Time_us begin, Time_us duration)
+	{
+		Trace_event event;
+
+		event.name = name;
+		event.phase = phase;
+		event.tid = get_thread_id();
+		event.begin = begin;
+		event.duration = duration;
+
+		boost::mutex::scoped_lock lock(TRACE_MUTEX);
+
+		if(TRACE_SAVED)
+			return;
+
+		if(TRACE_EVENTS.size() < MAX_TRACE_EVENTS)
+			TRACE_EVENTS.push_back(event);
+		else
+			DROPPED_TRACE_EVENTS++;
+	}
+
+
+
+	pid_t get_thread_id(void)
+	{
+		return syscall(SYS_gettid);
+	}
+}
+
+
+
+bool TRACE_ENABLED = false;
+
+
+
+void init_trace(void)
+{
+	const char* path = getenv(TRACE_ENV_NAME);
+
+	if(!path || !*path)
+		return;
+
+	TRACE_START_TIME = m::get_monotonic_time();
+	TRACE_EVENTS.reserve(MAX_TRACE_EVENTS / 100);
+	TRACE_ENABLED = true;
+}
+
+
+
+void save_trace(void)
+{
+	if(!TRACE_ENABLED)
+		return;
+
+	boost::mutex::scoped_lock lock(TRACE_MUTEX);
+
+	if(TRACE_SAVED)
+		return;
+
+	TRACE_SAVED = true;
+
+	std::string path = getenv(TRACE_ENV_NAME);
+	std::ofstream file(path.c_str());
+	pid_t pid = getpid();
+
+	file << "{\"traceEvents\": [";
+
+	// Имена событий - строковые литералы из исходного кода, поэтому их не
+	// требуется экранировать.
+	for(size_t i = 0; i < TRACE_EVENTS.size(); i++)
+	{
+		const Trace_event& event = TRACE_EVENTS[i];
+
+		file
+			<< (i ? ",\n" : "\n")
+			<< "{\"name\": \"" << event.name << "\", \"ph\": \"" << event.phase << "\""
+			<< ", \"pid\": " << pid << ", \"tid\": " << event.tid
+			<< ", \"ts\": " << event.begin - TRACE_START_TIME;
+
+		if(event.phase == 'X')
+			file << ", \"dur\": " << event.duration;
+		else
+			file << ", \"s\": \"t\"";
+
+		file << "}";
+	}
+
+	file
+		<< "\n], \"displayTimeUnit\": \"ms\""
+		<< ", \"otherData\": {\"dropped_events\": " << DROPPED_TRACE_EVENTS << "}}"
+		<< std::endl;
+
+	if(!file.good())
+		MLIB_SW(__("Unable to save trace to '%1'.", L2U(path)));
+
+	TRACE_EVENTS.clear();
+}
+
+
+
+void trace_instant(const char* name)
+{
+	add_trace_event(name, 'i', m::get_monotonic_time(), 0);
+}
+
+
+
+void trace_span(const char* name, Time_us begin, Time_us end)
+{
+	add_trace_event(name, 'X', begin, end - begin);
+}
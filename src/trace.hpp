@@ -0,0 +1,108 @@
+/**************************************************************************
+*                                                                         *
+*   submplayer - Simple MPlayer wrapper for subtitles watching            *
+*   http://sourceforge.net/projects/submplayer                            *
+*                                                                         *
+*   Copyright (C) 2009, Konishchev Dmitry                                 *
+*   http://konishchevdmitry.blogspot.com/                                 *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 3 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+**************************************************************************/
+
+
+#ifndef HEADER_TRACE
+	#define HEADER_TRACE
+
+	#include <boost/noncopyable.hpp>
+
+
+	/// Переменная окружения, задающая путь к файлу, в который при
+	/// завершении программы сохраняется трасса выполнения в формате Chrome
+	/// trace event (открывается в chrome://tracing и Perfetto).
+	#define TRACE_ENV_NAME "SUBMPLAYER_TRACE"
+
+
+	/// Записывает интервал выполнения текущего блока кода в трассу под именем
+	/// name, которое должно быть строковым литералом (это проверяется на этапе
+	/// компиляции). Если запись трассы не включена, то стоит одной проверки
+	/// глобального флага.
+	#define TRACE_SPAN(name) TRACE_SPAN_AT_LINE(name, __LINE__)
+
+	/// Записывает в трассу мгновенное событие name (строковый литерал).
+	#define TRACE_INSTANT(name) \
+		do { if(TRACE_ENABLED) trace_instant("" name ""); } while(0)
+
+	#define TRACE_SPAN_AT_LINE(name, line) TRACE_SPAN_AT_LINE_IMPL(name, line)
+	#define TRACE_SPAN_AT_LINE_IMPL(name, line) \
+		Trace_span trace_span_ ## line("" name "")
+
+
+	/// Включена ли запись трассы. Задается init_trace() до запуска
+	/// каких-либо потоков и далее не изменяется.
+	extern bool TRACE_ENABLED;
+
+
+	/// Интервал выполнения блока кода, записываемый в трассу при выходе из
+	/// блока.
+	class Trace_span: public boost::noncopyable
+	{
+		public:
+			inline
+			Trace_span(const char* name);
+
+			inline
+			~Trace_span(void);
+
+
+		private:
+			/// Имя интервала (строковый литерал).
+			const char*	name;
+
+			/// Время (по монотонным часам) начала интервала.
+			Time_us		begin;
+	};
+
+
+	/// Включает запись трассы, если задана переменная окружения
+	/// TRACE_ENV_NAME.
+	void	init_trace(void);
+
+	/// Сохраняет записанную трассу в файл, заданный переменной окружения
+	/// TRACE_ENV_NAME. Повторные вызовы ничего не делают.
+	void	save_trace(void);
+
+	/// Записывает в трассу интервал name, выполнявшийся текущим потоком с
+	/// begin по end (по монотонным часам). name должно указывать на строку,
+	/// существующую все время работы программы.
+	void	trace_span(const char* name, Time_us begin, Time_us end);
+
+	/// Записывает в трассу мгновенное событие name.
+	void	trace_instant(const char* name);
+
+
+
+	Trace_span::Trace_span(const char* name)
+	:
+		name(name),
+		begin(TRACE_ENABLED ? m::get_monotonic_time() : 0)
+	{
+	}
+
+
+
+	Trace_span::~Trace_span(void)
+	{
+		if(TRACE_ENABLED)
+			trace_span(this->name, this->begin, m::get_monotonic_time());
+	}
+
+#endif